@@ -0,0 +1,245 @@
+import asyncio
+import io
+import random
+import time
+import wave
+from dataclasses import dataclass, field
+from typing import Awaitable, Callable, Dict, List, Optional, Sequence, TypeVar
+
+import torch
+
+from generator import Generator, Segment
+
+# Short listener responses, by when they fit. Breathing and other non-verbal
+# sounds can't be prompted reliably from text; add recorded ones with
+# BackchannelPool.add().
+BACKCHANNEL_PHRASES: Dict[str, List[str]] = {
+    "acknowledge": ["Mm-hmm.", "Okay.", "Right.", "I hear you."],
+    "empathize": ["Mm.", "I see.", "That sounds hard."],
+    "thinking": ["Hmm.", "Let me think about that.", "Mm, okay."],
+}
+
+T = TypeVar("T")
+
+
+@dataclass
+class VoicePreset:
+    name: str
+    speaker: int
+    # Prompt segments that set the voice, as passed to Generator.generate
+    context: List[Segment] = field(default_factory=list)
+
+
+@dataclass
+class Backchannel:
+    preset: str
+    category: str
+    text: str
+    # (num_samples,), float32 at the pool's sample rate
+    audio: torch.Tensor
+    # 16-bit mono WAV, ready to send
+    wav: bytes
+    duration_s: float
+
+
+def encode_wav(audio: torch.Tensor, sample_rate: int) -> bytes:
+    pcm = (audio.clamp(-1, 1) * 32767).round().to(torch.int16).cpu().numpy().tobytes()
+    buffer = io.BytesIO()
+    with wave.open(buffer, "wb") as out:
+        out.setnchannels(1)
+        out.setsampwidth(2)
+        out.setframerate(sample_rate)
+        out.writeframes(pcm)
+    return buffer.getvalue()
+
+
+def trim_silence(audio: torch.Tensor, sample_rate: int, threshold: float = 0.01, pad_ms: float = 30,
+                 fade_ms: float = 10) -> torch.Tensor:
+    """Cut leading/trailing silence and fade the edges so clips start and stop cleanly."""
+    loud = torch.nonzero(audio.abs() > threshold).flatten()
+    if loud.numel() == 0:
+        return audio[:0]
+    pad = int(sample_rate * pad_ms / 1000)
+    audio = audio[max(0, int(loud[0]) - pad):int(loud[-1]) + pad].clone()
+    fade = min(int(sample_rate * fade_ms / 1000), audio.numel() // 2)
+    if fade:
+        ramp = torch.linspace(0, 1, fade, dtype=audio.dtype, device=audio.device)
+        audio[:fade] *= ramp
+        audio[-fade:] *= ramp.flip(0)
+    return audio
+
+
+class BackchannelPool:
+    """
+    Backchannel clips synthesized once per voice preset and kept in memory,
+    so playing one costs no synthesis on the response's critical path.
+    """
+
+    def __init__(
+        self,
+        generator: Generator,
+        presets: Sequence[VoicePreset],
+        phrases: Dict[str, List[str]] = BACKCHANNEL_PHRASES,
+        max_duration_s: float = 1.6,
+    ):
+        self._generator = generator
+        self.presets = {preset.name: preset for preset in presets}
+        self.phrases = phrases
+        self.max_duration_s = max_duration_s
+        self.sample_rate = generator.sample_rate
+        # preset -> category -> clips
+        self._clips: Dict[str, Dict[str, List[Backchannel]]] = {name: {} for name in self.presets}
+        self._last_used: Dict[int, float] = {}
+
+    def warm(self, attempts: int = 2) -> float:
+        """
+        Synthesize every phrase for every preset. Call at startup.
+
+        Returns:
+            Seconds spent synthesizing
+        """
+        start = time.perf_counter()
+        for preset in self.presets.values():
+            for category, texts in self.phrases.items():
+                for text in texts:
+                    for _ in range(attempts):
+                        audio = self._generator.generate(
+                            text=text,
+                            speaker=preset.speaker,
+                            context=preset.context,
+                            max_audio_length_ms=self.max_duration_s * 1000 + 1000,
+                        )
+                        audio = trim_silence(audio.float().cpu(), self.sample_rate)
+                        # Sampling occasionally rambles past a short phrase; try again
+                        if 0 < audio.numel() <= self.max_duration_s * self.sample_rate:
+                            self.add(preset.name, category, text, audio)
+                            break
+        return time.perf_counter() - start
+
+    def add(self, preset: str, category: str, text: str, audio: torch.Tensor) -> Backchannel:
+        """Add a clip (e.g. a recorded breath) at the pool's sample rate."""
+        audio = audio.float().cpu()
+        clip = Backchannel(
+            preset=preset,
+            category=category,
+            text=text,
+            audio=audio,
+            wav=encode_wav(audio, self.sample_rate),
+            duration_s=audio.numel() / self.sample_rate,
+        )
+        self._clips.setdefault(preset, {}).setdefault(category, []).append(clip)
+        return clip
+
+    def pick(self, preset: str, category: Optional[str] = None) -> Optional[Backchannel]:
+        """
+        A clip for the preset, least recently played first so repeats are rare.
+
+        Falls back to any category when the requested one has no clips.
+        """
+        categories = self._clips.get(preset, {})
+        clips = categories.get(category) if category else None
+        if not clips:
+            clips = [clip for group in categories.values() for clip in group]
+        if not clips:
+            return None
+        oldest = min(self._last_used.get(id(clip), 0.0) for clip in clips)
+        clip = random.choice([clip for clip in clips if self._last_used.get(id(clip), 0.0) == oldest])
+        self._last_used[id(clip)] = time.monotonic()
+        return clip
+
+    def __len__(self) -> int:
+        return sum(len(clips) for categories in self._clips.values() for clips in categories.values())
+
+    def memory_bytes(self) -> int:
+        return sum(
+            clip.audio.numel() * clip.audio.element_size() + len(clip.wav)
+            for categories in self._clips.values()
+            for clips in categories.values()
+            for clip in clips
+        )
+
+
+@dataclass
+class BackchannelPolicy:
+    # Reply audio is expected this long after the user's turn ends
+    deadline_s: float = 1.0
+    # Start the backchannel this long before the deadline
+    lead_s: float = 0.2
+    # At most one backchannel per this many seconds, so they stay natural
+    min_gap_s: float = 8.0
+    category: str = "acknowledge"
+
+
+class LatencyMasker:
+    """
+    Plays a pooled backchannel when a reply is about to miss its deadline.
+
+    The reply (LLM plus Generator.generate, which blocks, so run it in an
+    executor) is awaited as-is; if it is not ready by deadline - lead, one
+    clip is sent, and the reply is held until the clip has finished playing
+    so the two never overlap.
+    """
+
+    def __init__(
+        self,
+        pool: BackchannelPool,
+        preset: str,
+        send: Callable[[Backchannel], Awaitable[None]],
+        policy: Optional[BackchannelPolicy] = None,
+    ):
+        self.pool = pool
+        self.preset = preset
+        self.send = send
+        self.policy = policy or BackchannelPolicy()
+        self._last_played = float("-inf")
+        self.stats = {"turns": 0, "masked": 0, "silence_s": 0.0, "silence_unmasked_s": 0.0}
+
+    async def run(self, reply: Awaitable[T], turn_ended_at: Optional[float] = None,
+                  category: Optional[str] = None) -> T:
+        """
+        Await the reply, masking a late one.
+
+        Args:
+            reply: Awaitable producing the reply audio (or anything else)
+            turn_ended_at: time.monotonic() when the user stopped talking (defaults to now)
+            category: Backchannel category (defaults to the policy's)
+
+        Returns:
+            The reply, once any backchannel has finished playing
+        """
+        policy = self.policy
+        turn_ended_at = time.monotonic() if turn_ended_at is None else turn_ended_at
+        task = asyncio.ensure_future(reply)
+        self.stats["turns"] += 1
+
+        wait = turn_ended_at + policy.deadline_s - policy.lead_s - time.monotonic()
+        done, _ = await asyncio.wait({task}, timeout=max(0.0, wait))
+        played_until = None
+        if not done and time.monotonic() - self._last_played >= policy.min_gap_s:
+            clip = self.pool.pick(self.preset, category or policy.category)
+            if clip is not None:
+                now = time.monotonic()
+                self._last_played = now
+                played_until = now + clip.duration_s
+                self.stats["masked"] += 1
+                self.stats["silence_s"] += now - turn_ended_at
+                await self.send(clip)
+
+        result = await task
+        now = time.monotonic()
+        if played_until is None:
+            self.stats["silence_s"] += now - turn_ended_at
+        self.stats["silence_unmasked_s"] += now - turn_ended_at
+        if played_until is not None and played_until > now:
+            await asyncio.sleep(played_until - now)
+        return result
+
+    def metrics(self) -> Dict:
+        turns = self.stats["turns"]
+        return {
+            "turns": turns,
+            "masked": self.stats["masked"],
+            # Mean silence the user heard after their turn, with and without masking
+            "silence_s": round(self.stats["silence_s"] / turns, 3) if turns else None,
+            "silence_unmasked_s": round(self.stats["silence_unmasked_s"] / turns, 3) if turns else None,
+        }
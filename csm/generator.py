@@ -1,5 +1,6 @@
+import math
 from dataclasses import dataclass
-from typing import List, Tuple
+from typing import List, Optional, Tuple
 
 import torch
 import torchaudio
@@ -17,6 +18,8 @@ class Segment:
     text: str
     # (num_samples,), sample_rate = 24_000
     audio: torch.Tensor
+    # (num_codebooks, num_frames) Mimi codes of `audio`, if already encoded
+    audio_tokens: Optional[torch.Tensor] = None
 
 
 def load_llama3_tokenizer(use_local: bool = False, local_path: str = None):
@@ -65,13 +68,11 @@ class Generator:
         )
 
         device = next(model.parameters()).device
-        if local_mimi_path:
-            mimi = loaders.get_mimi(local_mimi_path, device=device)
-        else:
-            mimi_weight = hf_hub_download(loaders.DEFAULT_REPO, loaders.MIMI_NAME)
-            mimi = loaders.get_mimi(mimi_weight, device=device)
+        self._mimi_weight = local_mimi_path or hf_hub_download(loaders.DEFAULT_REPO, loaders.MIMI_NAME)
+        mimi = loaders.get_mimi(self._mimi_weight, device=device)
         mimi.set_num_codebooks(32)
         self._audio_tokenizer = mimi
+        self._streaming_encoder = None
 
         self._watermarker = load_watermarker(device=device)
 
@@ -93,15 +94,19 @@ class Generator:
 
         return torch.cat(frame_tokens, dim=0), torch.cat(frame_masks, dim=0)
 
-    def _tokenize_audio(self, audio: torch.Tensor) -> Tuple[torch.Tensor, torch.Tensor]:
+    def _tokenize_audio(
+        self, audio: torch.Tensor, audio_tokens: Optional[torch.Tensor] = None
+    ) -> Tuple[torch.Tensor, torch.Tensor]:
         assert audio.ndim == 1, "Audio must be single channel"
 
         frame_tokens = []
         frame_masks = []
 
         # (K, T)
-        audio = audio.to(self.device)
-        audio_tokens = self._audio_tokenizer.encode(audio.unsqueeze(0).unsqueeze(0))[0]
+        if audio_tokens is None:
+            audio = audio.to(self.device)
+            audio_tokens = self._audio_tokenizer.encode(audio.unsqueeze(0).unsqueeze(0))[0]
+        audio_tokens = audio_tokens.to(self.device)
         # add EOS frame
         eos_frame = torch.zeros(audio_tokens.size(0), 1).to(self.device)
         audio_tokens = torch.cat([audio_tokens, eos_frame], dim=1)
@@ -122,10 +127,24 @@ class Generator:
             (seq_len, 33), (seq_len, 33)
         """
         text_tokens, text_masks = self._tokenize_text_segment(segment.text, segment.speaker)
-        audio_tokens, audio_masks = self._tokenize_audio(segment.audio)
+        audio_tokens, audio_masks = self._tokenize_audio(segment.audio, segment.audio_tokens)
 
         return torch.cat([text_tokens, audio_tokens], dim=0), torch.cat([text_masks, audio_masks], dim=0)
 
+    def streaming_encoder(self) -> "StreamingAudioEncoder":
+        """
+        Incremental encoder for the user's audio, one stream at a time like
+        the single-batch caches.
+
+        It runs on a second Mimi instance: streaming mode keeps state in the
+        model, so it can't share the one `generate` decodes with.
+        """
+        if self._streaming_encoder is None:
+            mimi = loaders.get_mimi(self._mimi_weight, device=self.device)
+            mimi.set_num_codebooks(32)
+            self._streaming_encoder = StreamingAudioEncoder(mimi, self.device)
+        return self._streaming_encoder
+
     @torch.inference_mode()
     def generate(
         self,
@@ -189,6 +208,163 @@ class Generator:
         return audio
 
 
+class _StreamingResampler:
+    """Chunked resampling that matches resampling the whole signal at once."""
+
+    def __init__(self, orig_freq: int, new_freq: int, context: int = 64):
+        step = orig_freq // math.gcd(orig_freq, new_freq)
+        self.orig_freq = orig_freq
+        self.new_freq = new_freq
+        self.step = step
+        # Input samples of filter context on each side, a whole number of phase steps
+        self.context = -(-context // step) * step
+        self._buffer = torch.zeros(self.context)
+        self._received = 0
+        self._emitted = 0
+
+    def push(self, audio: torch.Tensor) -> torch.Tensor:
+        self._received += audio.numel()
+        return self._resample(audio)
+
+    def _resample(self, audio: torch.Tensor) -> torch.Tensor:
+        x = torch.cat([self._buffer.to(audio), audio])
+        # Emit output for inputs [context, end) where every output sample sees full context
+        end = (x.numel() - self.context) // self.step * self.step
+        if end <= self.context:
+            self._buffer = x
+            return audio[:0]
+        y = torchaudio.functional.resample(x, self.orig_freq, self.new_freq)
+        ratio = self.new_freq / self.orig_freq
+        out = y[round(self.context * ratio):round(end * ratio)]
+        self._buffer = x[end - self.context:]
+        self._emitted += out.numel()
+        return out
+
+    def flush(self) -> torch.Tensor:
+        # Pad with silence so the held-back samples get their right-hand context
+        out = self._resample(torch.zeros(self.context + self.step).to(self._buffer))
+        total = math.ceil(self._received * self.new_freq / self.orig_freq)
+        out = out[:max(0, out.numel() - (self._emitted - total))]
+        self._buffer = torch.zeros(self.context)
+        self._received = self._emitted = 0
+        return out
+
+
+class StreamingAudioEncoder:
+    """
+    Mimi-encodes a speaker's audio while they talk, so the turn's Segment
+    (with audio_tokens) is ready as soon as it ends instead of being encoded
+    at the start of the next generation.
+
+    Codes match encoding the whole clip at once: Mimi's encoder is causal,
+    and the final partial frame is zero-padded as `encode` does.
+    """
+
+    def __init__(self, mimi, device: torch.device):
+        self._mimi = mimi
+        self._mimi.streaming_forever(1)
+        self.device = device
+        self.sample_rate = mimi.sample_rate
+        self.frame_size = mimi.frame_size
+        self._resampler = None
+        self._pending = torch.zeros(0)
+        self._audio: List[torch.Tensor] = []
+        self._codes: List[torch.Tensor] = []
+        self.encoded_frames = 0
+
+    @torch.inference_mode()
+    def push(self, audio: torch.Tensor, sample_rate: Optional[int] = None):
+        """
+        Add a chunk of mono audio; whole Mimi frames (80 ms) are encoded now.
+
+        Args:
+            audio: (num_samples,) float audio
+            sample_rate: Rate of `audio` (defaults to Mimi's 24 kHz)
+        """
+        audio = audio.float().cpu()
+        if sample_rate is not None and sample_rate != self.sample_rate:
+            if self._resampler is None or self._resampler.orig_freq != sample_rate:
+                self._resampler = _StreamingResampler(sample_rate, self.sample_rate)
+            audio = self._resampler.push(audio)
+        self._append(audio)
+
+    def _append(self, audio: torch.Tensor):
+        self._audio.append(audio)
+        pending = torch.cat([self._pending, audio])
+        whole = pending.numel() // self.frame_size * self.frame_size
+        if whole:
+            self._encode(pending[:whole])
+        self._pending = pending[whole:]
+
+    def _encode(self, audio: torch.Tensor):
+        # (1, K, T)
+        codes = self._mimi.encode(audio.to(self.device).unsqueeze(0).unsqueeze(0))
+        self._codes.append(codes[0])
+        self.encoded_frames += codes.shape[-1]
+
+    @torch.inference_mode()
+    def finish(self, text: str, speaker: int) -> Segment:
+        """Encode what is left and return the turn as a Segment; the encoder is then reset."""
+        if self._resampler is not None:
+            self._append(self._resampler.flush())
+        if self._pending.numel():
+            padding = torch.zeros(self.frame_size - self._pending.numel())
+            self._encode(torch.cat([self._pending, padding]))
+
+        audio = torch.cat(self._audio) if self._audio else torch.zeros(0)
+        if self._codes:
+            audio_tokens = torch.cat(self._codes, dim=1)
+        else:
+            audio_tokens = torch.zeros(32, 0, dtype=torch.long, device=self.device)
+        self.reset()
+        return Segment(speaker=speaker, text=text, audio=audio, audio_tokens=audio_tokens)
+
+    def reset(self):
+        self._mimi.reset_streaming()
+        self._resampler = None
+        self._pending = torch.zeros(0)
+        self._audio = []
+        self._codes = []
+        self.encoded_frames = 0
+
+
+@torch.inference_mode()
+def check_streaming_encoder(mimi, audio: torch.Tensor, sample_rate: int, chunk_ms: int = 250,
+                            device: torch.device = torch.device("cpu")) -> dict:
+    """
+    Encode one clip in chunks with StreamingAudioEncoder and whole with
+    `mimi.encode`, as _tokenize_audio does, and compare the codes.
+
+    `mimi` must be a fresh instance (the encoder puts it in streaming mode).
+    A sample rate other than Mimi's also exercises _StreamingResampler and
+    its flush; the reference resamples the whole clip with torchaudio.
+    """
+    audio = audio.float().cpu()
+    whole = audio
+    if sample_rate != mimi.sample_rate:
+        whole = torchaudio.functional.resample(audio, orig_freq=sample_rate, new_freq=mimi.sample_rate)
+    reference = mimi.encode(whole.to(device).unsqueeze(0).unsqueeze(0))[0]
+
+    encoder = StreamingAudioEncoder(mimi, device)
+    chunk = max(1, sample_rate * chunk_ms // 1000)
+    for start in range(0, audio.numel(), chunk):
+        encoder.push(audio[start:start + chunk], sample_rate)
+    segment = encoder.finish("", 0)
+
+    streamed = segment.audio_tokens
+    frames = min(streamed.shape[1], reference.shape[1])
+    mismatched = (streamed[:, :frames] != reference[:, :frames]).any(dim=0)
+    return {
+        "reference_frames": reference.shape[1],
+        "streamed_frames": streamed.shape[1],
+        "mismatched_frames": int(mismatched.sum()),
+        "first_mismatch": int(mismatched.nonzero()[0]) if mismatched.any() else None,
+        "audio_samples": (whole.numel(), segment.audio.numel()),
+        "max_audio_error": float((segment.audio[:whole.numel()] - whole[:segment.audio.numel()]).abs().max())
+        if min(whole.numel(), segment.audio.numel()) else 0.0,
+    }
+
+
 def load_csm_1b(device: str = "cuda", use_local_tokenizer: bool = False, local_tokenizer_path: str = None) -> Generator:
     model = Model.from_pretrained("sesame/csm-1b")
     model.to(device=device, dtype=torch.bfloat16)
@@ -198,4 +374,28 @@ def load_csm_1b(device: str = "cuda", use_local_tokenizer: bool = False, local_t
         use_local_tokenizer=use_local_tokenizer,
         local_tokenizer_path=local_tokenizer_path
     )
-    return generator
\ No newline at end of file
+    return generator
+
+
+if __name__ == "__main__":
+    # Streaming vs whole-clip Mimi codes; needs torch and the Mimi weights:
+    #   python generator.py [clip.wav] [chunk_ms]
+    import sys
+
+    path = sys.argv[1] if len(sys.argv) > 1 else "full_conversation.wav"
+    chunk_ms = int(sys.argv[2]) if len(sys.argv) > 2 else 250
+    clip, clip_rate = torchaudio.load(path)
+    clip = clip.mean(dim=0)[:clip_rate * 20]
+    mimi_weight = hf_hub_download(loaders.DEFAULT_REPO, loaders.MIMI_NAME)
+
+    failed = False
+    for rate in (24_000, 16_000, 44_100):
+        mimi = loaders.get_mimi(mimi_weight, device="cpu")
+        mimi.set_num_codebooks(32)
+        clip_at_rate = torchaudio.functional.resample(clip, clip_rate, rate)
+        # Odd length so the final Mimi frame is partial and gets zero-padded
+        clip_at_rate = clip_at_rate[:clip_at_rate.numel() // 1920 * 1920 - 777]
+        result = check_streaming_encoder(mimi, clip_at_rate, rate, chunk_ms)
+        print(f"{rate} Hz: {result}")
+        failed |= result["mismatched_frames"] > 0 or result["streamed_frames"] != result["reference_frames"]
+    sys.exit(1 if failed else 0)
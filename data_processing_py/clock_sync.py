@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+"""
+Clock Synchronization
+
+Estimates the offset and drift between this backend's clock (time.time(),
+the reference) and each peer clock it exchanges timestamps with:
+
+- Browsers, via NTP-style ping/pong over the mux control channel. Each
+  exchange gives t0 (client send), t1 (server receive), t2 (server send)
+  and t3 (client receive); backend - browser = ((t1 - t0) + (t2 - t3)) / 2
+  with round-trip delay (t3 - t0) - (t2 - t1). The browser echoes each completed
+  exchange in its next ping so both ends hold the same estimate.
+- The headset, via Cortex sample times. That stream is one-way, so the
+  estimate is the minimum observed (arrival - sample time): the clock
+  offset plus the pipeline's minimum latency, which is the lag a sample
+  can not beat anyway.
+
+Samples are kept in a sliding window. In each group of consecutive samples
+only the one with the lowest delay is trusted (queueing only ever adds
+delay), and a line fitted through those gives offset and drift, so
+estimates stay accurate between exchanges and over long sessions.
+
+Usage:
+    from clock_sync import clock_sync
+    clock_sync.observe_one_way('cortex', sample_time)
+    backend_time = clock_sync.to_local('cortex', sample_time)
+"""
+
+import time
+import threading
+from collections import deque
+from typing import Dict, Optional
+
+
+class ClockEstimator:
+    """Offset (local - remote) and drift of one peer clock."""
+
+    def __init__(self, window: int = 128, group: int = 8, one_way: bool = False):
+        """
+        Initialize estimator.
+
+        Args:
+            window: Number of recent samples kept
+            group: Consecutive samples per minimum-delay filter group
+            one_way: Samples are one-way (uncertainty is then the spread of
+                the group minima around the fit rather than half the delay)
+        """
+        self.group = group
+        self.one_way = one_way
+        # (local_time, offset, delay)
+        self.samples = deque(maxlen=window)
+        self._lock = threading.Lock()
+        self._fit = None  # (reference local time, offset there, drift, uncertainty)
+
+    def add_exchange(self, t0: float, t1: float, t2: float, t3: float, initiator: bool = True):
+        """
+        Add one two-way exchange.
+
+        Args:
+            t0, t3: Initiator's send and receive times
+            t1, t2: Responder's receive and send times
+            initiator: Whether this clock is the initiator's (else the responder's)
+        """
+        delay = (t3 - t0) - (t2 - t1)
+        offset = ((t0 - t1) + (t3 - t2)) / 2
+        local_time = (t0 + t3) / 2
+        if not initiator:
+            offset, local_time = -offset, (t1 + t2) / 2
+        self._add(local_time, offset, max(delay, 0.0))
+
+    def add_one_way(self, remote_time: float, local_time: float):
+        """Add a one-way sample (remote timestamp observed arriving at local_time)."""
+        transit = local_time - remote_time
+        # Delay is unknown; the smallest apparent offset is the least delayed
+        self._add(local_time, transit, transit)
+
+    def _add(self, local_time: float, offset: float, delay: float):
+        with self._lock:
+            self.samples.append((local_time, offset, delay))
+            self._fit = None
+
+    def _estimate(self):
+        with self._lock:
+            if self._fit is not None:
+                return self._fit
+            samples = list(self.samples)
+            if not samples:
+                return None
+
+            # Groups aligned to the newest sample; a partial (less filtered)
+            # oldest group is only used while there is nothing better
+            ends = range(len(samples), 0, -self.group)
+            best = [min(samples[max(0, end - self.group):end], key=lambda s: s[2]) for end in ends][::-1]
+            if len(best) > 2 and len(samples) % self.group:
+                best = best[1:]
+            ref = best[-1][0]
+            if len(best) < 4:
+                offset, drift = best[-1][1], 0.0
+            else:
+                n = len(best)
+                mean_x = sum(s[0] - ref for s in best) / n
+                mean_y = sum(s[1] for s in best) / n
+                sxx = sum((s[0] - ref - mean_x) ** 2 for s in best)
+                sxy = sum((s[0] - ref - mean_x) * (s[1] - mean_y) for s in best)
+                drift = sxy / sxx if sxx else 0.0
+                offset = mean_y - drift * mean_x
+
+            if self.one_way:
+                uncertainty = max(abs(s[1] - offset - drift * (s[0] - ref)) for s in best)
+            else:
+                uncertainty = min(s[2] for s in best) / 2
+            self._fit = (ref, offset, drift, uncertainty)
+            return self._fit
+
+    def offset_at(self, local_time: float) -> float:
+        """Estimated local - remote at a local time (0 without samples)."""
+        fit = self._estimate()
+        if fit is None:
+            return 0.0
+        ref, offset, drift, _ = fit
+        return offset + drift * (local_time - ref)
+
+    def to_local(self, remote_time: float) -> float:
+        # Offset changes by ppm, so evaluating it at remote_time is exact enough
+        return remote_time + self.offset_at(remote_time)
+
+    def to_remote(self, local_time: float) -> float:
+        return local_time - self.offset_at(local_time)
+
+    def state(self) -> Dict:
+        fit = self._estimate()
+        if fit is None:
+            return {'samples': 0}
+        ref, offset, drift, uncertainty = fit
+        return {
+            'samples': len(self.samples),
+            'offset_ms': round(self.offset_at(time.time()) * 1000, 3),
+            'drift_ppm': round(drift * 1e6, 2),
+            'uncertainty_ms': round(uncertainty * 1000, 3)
+        }
+
+
+class ClockSyncService:
+    """Clock estimators for every peer, keyed by name (e.g. 'cortex', 'browser:<id>')."""
+
+    def __init__(self):
+        self.peers: Dict[str, ClockEstimator] = {}
+        self._lock = threading.Lock()
+
+    def peer(self, name: str, one_way: bool = False) -> ClockEstimator:
+        estimator = self.peers.get(name)
+        if estimator is None:
+            # One-way minima are noisier, so they need a longer window to fit drift
+            estimator = ClockEstimator(512, 32, one_way=True) if one_way else ClockEstimator()
+            with self._lock:
+                estimator = self.peers.setdefault(name, estimator)
+        return estimator
+
+    def observe_exchange(self, name: str, t0: float, t1: float, t2: float, t3: float,
+                         initiator: bool = True):
+        self.peer(name).add_exchange(t0, t1, t2, t3, initiator)
+
+    def observe_one_way(self, name: str, remote_time: float, local_time: Optional[float] = None):
+        self.peer(name, one_way=True).add_one_way(remote_time, time.time() if local_time is None else local_time)
+
+    def to_local(self, name: str, remote_time: float) -> float:
+        """A peer timestamp on the backend clock (unchanged for unknown peers)."""
+        estimator = self.peers.get(name)
+        return estimator.to_local(remote_time) if estimator else remote_time
+
+    def to_remote(self, name: str, local_time: float) -> float:
+        estimator = self.peers.get(name)
+        return estimator.to_remote(local_time) if estimator else local_time
+
+    def forget(self, name: str):
+        with self._lock:
+            self.peers.pop(name, None)
+
+    def snapshot(self) -> Dict[str, Dict]:
+        return {name: estimator.state() for name, estimator in list(self.peers.items())}
+
+
+# Process-wide service shared by the streamer, gateway and servers
+clock_sync = ClockSyncService()
+
+
+if __name__ == "__main__":
+    import random
+
+    service = ClockSyncService()
+    start = time.time()
+
+    # Browser clock 40 ms behind with 50 ppm drift; 1 s pings over jittery
+    # 5-60 ms paths. Here the backend initiates: local t0/t3, browser t1/t2.
+    def browser_offset(t):
+        return 0.040 + 50e-6 * (t - start)
+
+    errors = []
+    for i in range(600):
+        t0 = start + i
+        up, down = random.uniform(0.005, 0.06), random.uniform(0.005, 0.06)
+        t1 = t0 + up - browser_offset(t0 + up)
+        t2 = t1 + 0.0005
+        t3 = t0 + up + 0.0005 + down
+        service.observe_exchange('browser', t0, t1, t2, t3)
+        if i >= 30:
+            errors.append(abs(service.peers['browser'].offset_at(t3) - browser_offset(t3)) * 1000)
+    state = service.peers['browser'].state()
+    print(f"Two-way: drift {state['drift_ppm']} ppm (true 50), offset error "
+          f"mean {sum(errors) / len(errors):.2f} ms, max {max(errors):.2f} ms")
+
+    # Headset 250 ms behind, samples at 2 Hz arriving after 20-200 ms
+    errors = []
+    for i in range(2400):
+        arrival = start + i * 0.5 + random.uniform(0.02, 0.2)
+        service.observe_one_way('cortex', start + i * 0.5 - 0.25, arrival)
+        if i >= 64:
+            errors.append(abs(service.peers['cortex'].offset_at(arrival) - 0.27) * 1000)
+    state = service.peers['cortex'].state()
+    print(f"One-way: drift {state['drift_ppm']} ppm (true 0), error vs offset + minimum latency "
+          f"mean {sum(errors) / len(errors):.2f} ms, max {max(errors):.2f} ms")
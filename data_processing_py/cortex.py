@@ -94,6 +94,7 @@ class Cortex(Dispatcher):
         self.debit = 10
         self.license = ''
         self.isHeadsetConnected = False
+        self.url = "wss://localhost:6868"
 
         if client_id == '':
             raise ValueError('Empty your_app_client_id. Please fill in your_app_client_id before running the example.')
@@ -113,11 +114,13 @@ class Cortex(Dispatcher):
                 self.debit = value
             elif  key == 'headset_id':
                 self.headset_id = value
+            elif key == 'url':
+                # e.g. point at netem_proxy.py for impairment tests
+                self.url = value
 
     def open(self):
-        url = "wss://localhost:6868"
         # websocket.enableTrace(True)
-        self.ws = websocket.WebSocketApp(url, 
+        self.ws = websocket.WebSocketApp(self.url, 
                                         on_message=self.on_message,
                                         on_open = self.on_open,
                                         on_error=self.on_error,
@@ -1,8 +1,10 @@
 import pandas as pd
 import json
 import time
+import math
+import threading
 import numpy as np
-from typing import Dict, List, Optional
+from typing import Callable, Dict, List, Optional, Tuple
 from emotion_analyzer import EmotionAnalyzer, EmotionStreamProcessor
 
 class CSVReplayEngine:
@@ -13,6 +15,15 @@ class CSVReplayEngine:
     real-time emotion analysis with configurable replay speed.
     """
     
+    # Map CSV columns to normalized metrics
+    METRIC_COLUMNS = {
+        'engagement': 'PM.Engagement.Scaled',
+        'excitement': 'PM.Excitement.Scaled',
+        'stress': 'PM.Stress.Scaled',
+        'relaxation': 'PM.Relaxation.Scaled',
+        'interest': 'PM.Interest.Scaled'
+    }
+    
     def __init__(self, csv_file: str):
         """
         Initialize CSV replay engine.
@@ -27,6 +38,11 @@ class CSVReplayEngine:
         self.original_sampling_rate = None
         self.start_timestamp = None
         
+        # Time index over valid PM rows (built lazily by build_index)
+        self.offsets = None
+        self.timestamps = None
+        self.metrics = None
+        
     def load_csv(self) -> bool:
         """
         Load and parse the CSV file.
@@ -75,18 +91,9 @@ class CSVReplayEngine:
         """
         metrics = {}
         
-        # Map CSV columns to normalized metrics
-        metric_mapping = {
-            'engagement': 'PM.Engagement.Scaled',
-            'excitement': 'PM.Excitement.Scaled',
-            'stress': 'PM.Stress.Scaled',
-            'relaxation': 'PM.Relaxation.Scaled',
-            'interest': 'PM.Interest.Scaled'
-        }
-        
         # Check if all required columns exist and have valid data
         valid = True
-        for metric_name, csv_column in metric_mapping.items():
+        for metric_name, csv_column in self.METRIC_COLUMNS.items():
             if csv_column not in row or pd.isna(row[csv_column]):
                 valid = False
                 break
@@ -95,6 +102,62 @@ class CSVReplayEngine:
         
         return metrics if valid else None
     
+    def metrics_matrix(self) -> Tuple[np.ndarray, np.ndarray]:
+        """
+        Extract all valid PM rows at once.
+        
+        Returns:
+            (timestamps, metrics) where metrics has one column per entry of
+            METRIC_COLUMNS, clamped to [0, 1]
+        """
+        if self.df is None:
+            if not self.load_csv():
+                return np.empty(0), np.empty((0, len(self.METRIC_COLUMNS)))
+        
+        columns = list(self.METRIC_COLUMNS.values())
+        if not all(col in self.df.columns for col in columns):
+            return np.empty(0), np.empty((0, len(columns)))
+        
+        pm = self.df[['Timestamp'] + columns].dropna()
+        timestamps = pm['Timestamp'].to_numpy(dtype=float)
+        metrics = np.clip(pm[columns].to_numpy(dtype=float), 0, 1)
+        return timestamps, metrics
+    
+    def build_index(self) -> int:
+        """
+        Build the time index over valid PM rows.
+        
+        Offsets are seconds from the first valid row, sorted, so any position
+        in the session is found with a binary search.
+        
+        Returns:
+            Number of indexed rows
+        """
+        if self.offsets is None:
+            timestamps, metrics = self.metrics_matrix()
+            order = np.argsort(timestamps, kind='stable')
+            self.timestamps = timestamps[order]
+            self.metrics = metrics[order]
+            self.offsets = self.timestamps - self.timestamps[0] if len(timestamps) else timestamps
+        return len(self.offsets)
+    
+    @property
+    def duration(self) -> float:
+        self.build_index()
+        return float(self.offsets[-1]) if len(self.offsets) else 0.0
+    
+    def seek(self, offset: float) -> int:
+        """Index of the first row at or after the offset (seconds from start), O(log n)."""
+        self.build_index()
+        return int(np.searchsorted(self.offsets, offset, side='left'))
+    
+    def event_at(self, index: int) -> Dict:
+        """Analyze the indexed row and return its emotion event."""
+        metrics = dict(zip(self.METRIC_COLUMNS.keys(), self.metrics[index].tolist()))
+        event = self.analyzer.analyze_emotion(metrics, float(self.timestamps[index]))
+        event['replay_offset'] = round(float(self.offsets[index]), 3)
+        return event
+    
     def replay(self, replay_speed: float = 1.0, start_time: float = 0.0,
                end_time: Optional[float] = None, output_file: Optional[str] = None) -> List[Dict]:
         """
@@ -113,50 +176,28 @@ class CSVReplayEngine:
             if not self.load_csv():
                 return []
         
-        events = []
-        
-        # Filter by time range
-        df_filtered = self.df.copy()
-        
-        if 'Timestamp' in df_filtered.columns:
-            timestamps = df_filtered['Timestamp'].astype(float)
-            
-            if start_time > 0:
-                df_filtered = df_filtered[timestamps >= start_time]
-            if end_time:
-                df_filtered = df_filtered[timestamps <= end_time]
+        self.build_index()
+        first = self.seek(start_time)
+        last = len(self.offsets) if end_time is None else int(np.searchsorted(self.offsets, end_time, side='right'))
         
-        if len(df_filtered) == 0:
+        if last <= first:
             print("No data in specified time range")
             return []
         
-        print(f"Replaying {len(df_filtered)} data points...")
-        
-        # Filter for valid PM data only
-        valid_rows = []
-        for idx, row in df_filtered.iterrows():
-            metrics = self.extract_metrics(row)
-            if metrics is not None:
-                valid_rows.append((idx, row, metrics))
-        
-        print(f"Replaying {len(valid_rows)} valid data points...")
+        print(f"Replaying {last - first} valid data points...")
         
         events = []
-        for i, (idx, row, metrics) in enumerate(valid_rows):
-            timestamp = float(row['Timestamp'])
-            
+        for i in range(first, last):
             # Analyze emotion
-            emotion_event = self.analyzer.analyze_emotion(metrics, timestamp)
+            emotion_event = self.event_at(i)
             events.append(emotion_event)
             
             # Print streaming JSON
             print(json.dumps(emotion_event))
             
             # Control replay speed between valid rows only
-            if i < len(valid_rows) - 1:
-                current_time = timestamp
-                next_time = float(valid_rows[i + 1][1]['Timestamp'])
-                delay = (next_time - current_time) / replay_speed
+            if i < last - 1:
+                delay = (self.offsets[i + 1] - self.offsets[i]) / replay_speed
                 
                 # Cap minimum delay to avoid too fast replay
                 delay = max(0.1, min(delay, 2.0))
@@ -268,6 +309,274 @@ class CSVReplayEngine:
         return smoothed_events
 
 
+class ReplayController:
+    """
+    Interactive playback over an indexed session.
+    
+    Plays on a background thread and can be paused, resumed, sought and
+    re-speeded at any time; controls wake the playback thread immediately
+    instead of waiting out the current inter-sample delay.
+    
+    Usage:
+        controller = ReplayController(engine, output_callback=send)
+        controller.start()
+        controller.seek(1800.0)
+        controller.set_speed(4.0)
+    """
+    
+    def __init__(self, engine: CSVReplayEngine, output_callback: Callable[[Dict], None],
+                 speed: float = 1.0, state_callback: Optional[Callable[[Dict], None]] = None):
+        """
+        Initialize replay controller.
+        
+        Args:
+            engine: Replay engine to play from (its index is built on start)
+            output_callback: Receives every emotion event
+            speed: Initial speed multiplier
+            state_callback: Receives playback state after every control change
+        """
+        self.engine = engine
+        self.output_callback = output_callback
+        self.state_callback = state_callback
+        self.speed = speed
+        self.paused = True
+        self.running = False
+        
+        self._cond = threading.Condition()
+        self._cursor = 0
+        # Serializes analyzer use and emission; `_generation` changes on every
+        # analyzer reset so rows picked before a seek are dropped, not emitted
+        self._emit_lock = threading.Lock()
+        self._generation = 0
+        # Playback clock: offset `_anchor_offset` was current at wall time `_anchor_wall`
+        self._anchor_offset = 0.0
+        self._anchor_wall = time.monotonic()
+        self._thread = None
+    
+    def start(self, offset: float = 0.0, paused: bool = False):
+        """Start the playback thread at the given offset."""
+        self.engine.build_index()
+        self.running = True
+        self.seek(offset)
+        self.paused = paused
+        self._rebase(offset)
+        self._thread = threading.Thread(target=self._run, name="ReplayPlayback", daemon=True)
+        self._thread.start()
+        self._notify_state()
+    
+    def stop(self):
+        with self._cond:
+            self.running = False
+            self._cond.notify_all()
+        if self._thread:
+            self._thread.join(timeout=2.0)
+    
+    def position(self) -> float:
+        """Current playback offset in seconds."""
+        with self._cond:
+            return self._position()
+    
+    def _position(self) -> float:
+        if self.paused:
+            return self._anchor_offset
+        return min(self.engine.duration, self._anchor_offset + (time.monotonic() - self._anchor_wall) * self.speed)
+    
+    def _rebase(self, offset: float):
+        self._anchor_offset = offset
+        self._anchor_wall = time.monotonic()
+    
+    def pause(self):
+        with self._cond:
+            self._rebase(self._position())
+            self.paused = True
+            self._cond.notify_all()
+        self._notify_state()
+    
+    def resume(self):
+        with self._emit_lock, self._cond:
+            if self._cursor >= len(self.engine.offsets):
+                self._cursor = 0
+                self._rebase(0.0)
+                self.engine.analyzer.reset()
+                self._generation += 1
+            else:
+                self._rebase(self._anchor_offset)
+            self.paused = False
+            self._cond.notify_all()
+        self._notify_state()
+    
+    def set_speed(self, speed: float):
+        with self._cond:
+            self._rebase(self._position())
+            self.speed = max(0.05, float(speed))
+            self._cond.notify_all()
+        self._notify_state()
+    
+    def seek(self, offset: float):
+        """
+        Jump to an offset (seconds from start).
+        
+        The row at the new position is emitted right away, also while paused,
+        so a scrubbing UI always shows the state under the cursor.
+        """
+        offset = min(max(0.0, float(offset)), self.engine.duration)
+        with self._emit_lock:
+            with self._cond:
+                index = self.engine.seek(offset)
+                # History from before the jump no longer describes the stream
+                self.engine.analyzer.reset()
+                self._generation += 1
+                self._rebase(offset)
+                preview = index if index < len(self.engine.offsets) else None
+                self._cursor = index + 1 if preview is not None else index
+                self._cond.notify_all()
+            
+            if preview is not None:
+                self.output_callback(self.engine.event_at(preview))
+        self._notify_state()
+    
+    def state(self) -> Dict:
+        with self._cond:
+            return {
+                'type': 'replay_state',
+                'position': round(self._position(), 3),
+                'duration': round(self.engine.duration, 3),
+                'paused': self.paused,
+                'speed': self.speed,
+                'ended': self._cursor >= len(self.engine.offsets)
+            }
+    
+    def _notify_state(self):
+        if self.state_callback:
+            self.state_callback(self.state())
+    
+    def _run(self):
+        offsets = self.engine.offsets
+        while True:
+            with self._cond:
+                if not self.running:
+                    return
+                if self.paused or self._cursor >= len(offsets):
+                    self._cond.wait()
+                    continue
+                
+                index = self._cursor
+                due = self._anchor_wall + (offsets[index] - self._anchor_offset) / self.speed
+                remaining = due - time.monotonic()
+                if remaining > 0:
+                    # Woken early by any control change, then re-evaluated
+                    self._cond.wait(remaining)
+                    continue
+                self._cursor = index + 1
+                generation = self._generation
+                ended = self._cursor >= len(offsets)
+                if ended:
+                    self._rebase(float(offsets[-1]))
+                    self.paused = True
+            
+            with self._emit_lock:
+                if generation != self._generation:
+                    continue  # a seek landed in between; this row is stale
+                self.output_callback(self.engine.event_at(index))
+            if ended:
+                self._notify_state()
+
+
+class ReplayWebSocketServer:
+    """
+    WebSocket server streaming a replayed session with remote playback controls.
+    
+    Clients receive emotion events (same format as the live server) and
+    replay_state messages, and may send:
+        {"action": "pause"} / {"action": "resume"}
+        {"action": "seek", "offset": 1800.0}
+        {"action": "speed", "speed": 4.0}
+    """
+    
+    def __init__(self, csv_file: str, port: int = 8766, speed: float = 1.0):
+        self.engine = CSVReplayEngine(csv_file)
+        self.port = port
+        self.speed = speed
+        self.clients = set()
+        self.controller = None
+        self.loop = None
+    
+    def _broadcast_threadsafe(self, message: Dict):
+        if self.clients and self.loop is not None:
+            self.loop.call_soon_threadsafe(self._broadcast, json.dumps(message))
+    
+    def _broadcast(self, text: str):
+        import asyncio
+        for client in list(self.clients):
+            asyncio.ensure_future(self._send(client, text))
+    
+    async def _send(self, client, text: str):
+        try:
+            await client.send(text)
+        except Exception:
+            self.clients.discard(client)
+    
+    async def handle_client(self, websocket):
+        self.clients.add(websocket)
+        await websocket.send(json.dumps(self.controller.state()))
+        try:
+            async for raw in websocket:
+                try:
+                    message = json.loads(raw)
+                except ValueError:
+                    continue
+                if not isinstance(message, dict):
+                    continue
+                action = message.get('action')
+                if action == 'pause':
+                    self.controller.pause()
+                elif action == 'resume':
+                    self.controller.resume()
+                elif action in ('seek', 'speed'):
+                    key, default = ('offset', 0) if action == 'seek' else ('speed', 1)
+                    try:
+                        value = float(message.get(key, default))
+                        if not math.isfinite(value):
+                            raise ValueError(value)
+                    except (TypeError, ValueError):
+                        await websocket.send(json.dumps({'type': 'error',
+                                                         'message': f"Invalid {key}: {message.get(key)!r}"}))
+                        continue
+                    if action == 'seek':
+                        self.controller.seek(value)
+                    else:
+                        self.controller.set_speed(value)
+        finally:
+            self.clients.discard(websocket)
+    
+    def start_server(self):
+        """Run the replay server until interrupted."""
+        import asyncio
+        import websockets
+        
+        if not self.engine.load_csv() or self.engine.build_index() == 0:
+            print("No replayable PM data")
+            return
+        
+        self.controller = ReplayController(self.engine, self._broadcast_threadsafe, speed=self.speed,
+                                           state_callback=self._broadcast_threadsafe)
+        
+        async def main():
+            self.loop = asyncio.get_running_loop()
+            self.controller.start(paused=True)
+            async with websockets.serve(self.handle_client, "localhost", self.port):
+                print(f"Replay server on ws://localhost:{self.port} "
+                      f"({self.engine.duration / 60:.1f} min session, paused)")
+                await asyncio.Future()
+        
+        try:
+            asyncio.run(main())
+        except KeyboardInterrupt:
+            print("\nShutting down replay server...")
+        finally:
+            self.controller.stop()
+
+
 # Utility functions
 def list_available_csvs(directory: str = "recorded_samples") -> List[str]:
     """List available CSV files in directory."""
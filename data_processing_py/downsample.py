@@ -0,0 +1,331 @@
+#!/usr/bin/env python3
+"""
+Visual Downsampling for Long-Session Charts
+
+Serves chart-ready series sized to the requesting chart's pixel width rather
+than to the session length, so an eight-hour session costs the same to ship
+and render as a five-minute one. Series are read from the EmotionRollupStore
+tiers (never from raw events), so query cost is bounded as well.
+
+Two shapes are available per metric:
+
+    lttb    Largest-Triangle-Three-Buckets over rollup means: `width` points
+            that keep peaks and troughs visible, for line charts
+    minmax  One bucket per pixel column with min, max and mean, for band
+            charts that must never hide a spike
+
+Endpoints (DownsampleServer):
+    GET /series?metric=stress,engagement&session=s1&width=800
+    GET /series?metric=stress&start=...&end=...&width=800&method=minmax
+    GET /emotions?session=s1&width=800        dominant emotion per column
+    GET /range?session=s1                     time span covered by the store
+"""
+
+import json
+import math
+import time
+import threading
+import numpy as np
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Dict, List, Optional
+from urllib.parse import urlparse, parse_qs
+
+from emotion_rollup import EmotionRollupStore, METRICS, EMOTIONS
+
+MAX_WIDTH = 10000
+
+
+def lttb(x: np.ndarray, y: np.ndarray, n_out: int) -> np.ndarray:
+    """
+    Largest-Triangle-Three-Buckets point selection.
+
+    Keeps the first and last points and, from each of n_out - 2 equal-count
+    buckets in between, the point forming the largest triangle with the
+    previously kept point and the mean of the next bucket.
+
+    Args:
+        x: Sorted x values
+        y: y values
+        n_out: Number of points to keep
+
+    Returns:
+        Indices of the kept points, ascending
+    """
+    n = len(x)
+    if n_out >= n or n_out < 3:
+        return np.arange(n)
+
+    edges = np.linspace(1, n - 1, n_out - 1).astype(np.int64)
+    # Bucket means from prefix sums, with the last point as the final "next bucket"
+    cx = np.concatenate(([0.0], np.cumsum(x)))
+    cy = np.concatenate(([0.0], np.cumsum(y)))
+    counts = np.diff(edges)
+    mean_x = np.append((cx[edges[1:]] - cx[edges[:-1]]) / counts, x[-1])
+    mean_y = np.append((cy[edges[1:]] - cy[edges[:-1]]) / counts, y[-1])
+
+    selected = np.empty(n_out, dtype=np.int64)
+    selected[0], selected[-1] = 0, n - 1
+    a = 0
+    for i in range(n_out - 2):
+        lo, hi = edges[i], edges[i + 1]
+        nx, ny = mean_x[i + 1], mean_y[i + 1]
+        area = np.abs((x[a] - nx) * (y[lo:hi] - y[a]) - (x[a] - x[lo:hi]) * (ny - y[a]))
+        a = lo + int(np.argmax(area))
+        selected[i + 1] = a
+    return selected
+
+
+class SeriesDownsampler:
+    """
+    Pixel-width series from an EmotionRollupStore.
+
+    Usage:
+        downsampler = SeriesDownsampler(store)
+        chart = downsampler.series(['stress'], session_id="s1", width=800)
+    """
+
+    def __init__(self, store: EmotionRollupStore, oversample: int = 4):
+        """
+        Initialize downsampler.
+
+        Args:
+            store: Rollup store to read from
+            oversample: LTTB input points per output point; higher keeps
+                more detail at a proportional query cost
+        """
+        self.store = store
+        self.oversample = oversample
+
+    def resolve_range(self, start: Optional[float], end: Optional[float],
+                      session_id: Optional[str]) -> Optional[tuple]:
+        """Fill in a missing start/end from the stored time span."""
+        if start is not None and end is not None:
+            return start, end
+        span = self.store.time_range(session_id)
+        if span is None:
+            return None
+        return (span[0] if start is None else start, span[1] if end is None else end)
+
+    def lttb(self, metric: str, start: float, end: float, width: int,
+             session_id: Optional[str] = None) -> Dict:
+        """
+        About `width` points for a line chart of one metric.
+
+        Input is the rollup mean series at roughly oversample * width
+        buckets, so the query reads a bounded number of rows for any range.
+        """
+        # Read the coarsest tier that still gives at least 2 * width points,
+        # re-bucketed towards oversample * width when it gives many more
+        tier = self.store.pick_tier((end - start) / (2 * width))
+        resolution = max(tier, (end - start) / (self.oversample * width))
+        rows = self.store.series(metric, start, end, resolution, session_id, flush=False)
+        x = rows['bucket'] + rows['step'] / 2.0
+        keep = lttb(x, rows['mean'], width)
+        return {
+            't': np.round(x[keep], 1).tolist(),
+            'v': np.round(rows['mean'][keep], 4).tolist(),
+            'tier': rows['tier'],
+            'input_points': len(x)
+        }
+
+    def minmax(self, metric: str, start: float, end: float, width: int,
+               session_id: Optional[str] = None) -> Dict:
+        """At most `width` buckets of min, max and mean for a band chart."""
+        # Round up to a whole number of tier buckets so there are at most `width`
+        resolution = max(1.0, (end - start) / width)
+        tier = self.store.pick_tier(resolution)
+        rows = self.store.series(metric, start, end, math.ceil(resolution / tier) * tier, session_id, flush=False)
+        return {
+            't': rows['bucket'].tolist(),
+            'step': rows['step'],
+            'min': np.round(rows['min'], 4).tolist(),
+            'max': np.round(rows['max'], 4).tolist(),
+            'mean': np.round(rows['mean'], 4).tolist(),
+            'tier': rows['tier'],
+            'input_points': len(rows['bucket'])
+        }
+
+    def series(self, metrics: List[str], start: Optional[float] = None, end: Optional[float] = None,
+               width: int = 800, method: str = 'lttb', session_id: Optional[str] = None) -> Dict:
+        """
+        Downsampled series for several metrics over one range.
+
+        Args:
+            metrics: Names from METRICS (or 'crisis')
+            start: Range start (None = start of stored data)
+            end: Range end (None = end of stored data)
+            width: Chart width in pixels
+            method: 'lttb' or 'minmax'
+            session_id: Restrict to one session
+
+        Returns:
+            Dict with the resolved range and one entry per metric
+        """
+        if method not in ('lttb', 'minmax'):
+            raise ValueError(f"Unknown method: {method}")
+        width = int(min(max(width, 3), MAX_WIDTH))
+
+        self.store.flush()
+        span = self.resolve_range(start, end, session_id)
+        if span is None:
+            return {'start': start, 'end': end, 'width': width, 'method': method, 'series': {}}
+        start, end = span
+
+        downsample = self.lttb if method == 'lttb' else self.minmax
+        return {
+            'start': start,
+            'end': end,
+            'width': width,
+            'method': method,
+            'series': {m: downsample(m, start, end, width, session_id) for m in metrics}
+        }
+
+    def emotions(self, start: Optional[float] = None, end: Optional[float] = None,
+                 width: int = 800, session_id: Optional[str] = None) -> Dict:
+        """Dominant emotion per pixel column, for the emotion timeline strip."""
+        width = int(min(max(width, 1), MAX_WIDTH))
+        self.store.flush()
+        span = self.resolve_range(start, end, session_id)
+        if span is None:
+            return {'start': start, 'end': end, 'emotions': list(EMOTIONS), 't': [], 'emotion_id': []}
+        start, end = span
+
+        resolution = max(1.0, (end - start) / width)
+        tier = self.store.pick_tier(resolution)
+        rows = self.store.query(start, end, math.ceil(resolution / tier) * tier, session_id, flush=False)
+        ids = {name: i for i, name in enumerate(EMOTIONS)}
+        return {
+            'start': start,
+            'end': end,
+            'emotions': list(EMOTIONS),
+            'step': rows[0]['resolution'] if rows else None,
+            't': [r['bucket'] for r in rows],
+            'emotion_id': [ids.get(r['dominant_emotion'], -1) for r in rows]
+        }
+
+
+class DownsampleServer:
+    """
+    Local HTTP endpoint serving downsampled chart series.
+
+    Endpoints:
+        GET /series?metric=stress,engagement&session=s1&start=&end=&width=800&method=lttb
+        GET /emotions?session=s1&start=&end=&width=800
+        GET /range?session=s1
+    """
+
+    def __init__(self, store: EmotionRollupStore, port: int = 8797, host: str = "127.0.0.1"):
+        self.port = port
+        self.host = host
+        self.downsampler = SeriesDownsampler(store)
+        self.httpd = None
+        self.thread = None
+
+    def start(self):
+        """Start serving in a daemon thread."""
+        downsampler = self.downsampler
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                url = urlparse(self.path)
+                params = parse_qs(url.query)
+
+                def param(name, default=None, cast=str):
+                    value = params.get(name, [''])[0]
+                    return cast(value) if value else default
+
+                try:
+                    session_id = param('session')
+                    start = param('start', cast=float)
+                    end = param('end', cast=float)
+                    width = param('width', 800, int)
+
+                    if url.path == '/series':
+                        metrics = param('metric', 'stress').split(',')
+                        method = param('method', 'lttb')
+                        body = downsampler.series(metrics, start, end, width, method, session_id)
+                    elif url.path == '/emotions':
+                        body = downsampler.emotions(start, end, width, session_id)
+                    elif url.path == '/range':
+                        span = downsampler.store.time_range(session_id)
+                        body = {'start': span[0], 'end': span[1]} if span else {}
+                    else:
+                        self._send(404, 'text/plain', 'not found\n')
+                        return
+                except ValueError as e:
+                    self._send(400, 'text/plain', f"{e}\n")
+                    return
+
+                self._send(200, 'application/json', json.dumps(body, separators=(',', ':')))
+
+            def _send(self, status, content_type, body):
+                data = body.encode('utf-8')
+                self.send_response(status)
+                self.send_header('Content-Type', content_type)
+                self.send_header('Content-Length', str(len(data)))
+                # Charts are fetched from the frontend's own origin
+                self.send_header('Access-Control-Allow-Origin', '*')
+                self.end_headers()
+                self.wfile.write(data)
+
+            def log_message(self, format, *args):
+                pass  # Keep the pipeline's stdout clean
+
+        self.httpd = ThreadingHTTPServer((self.host, self.port), Handler)
+        self.httpd.daemon_threads = True
+        self.thread = threading.Thread(
+            target=self.httpd.serve_forever,
+            name="DownsampleServer",
+            daemon=True
+        )
+        self.thread.start()
+        print(f"Downsample endpoint on http://{self.host}:{self.port}/series")
+
+    def stop(self):
+        if self.httpd:
+            self.httpd.shutdown()
+            self.httpd.server_close()
+            self.httpd = None
+
+
+if __name__ == "__main__":
+    import urllib.request
+    from emotion_analyzer import EmotionAnalyzer
+
+    rng = np.random.default_rng(0)
+    analyzer = EmotionAnalyzer()
+    store = EmotionRollupStore(":memory:", store_raw=False)
+
+    # 2 Hz sessions of increasing length; metrics follow a bounded random walk
+    base = 1_753_430_000
+    sessions = {'5min': 300, '1h': 3600, '8h': 8 * 3600}
+    for session_id, seconds in sessions.items():
+        analyzer.reset()
+        steps = rng.normal(0, 0.02, (seconds * 2, len(METRICS)))
+        walk = np.clip(0.5 + np.cumsum(steps, axis=0), 0, 1)
+        for i, values in enumerate(walk):
+            event = analyzer.analyze_emotion(dict(zip(METRICS, values)), base + i * 0.5)
+            store.write(event, session_id=session_id)
+    store.flush()
+
+    downsampler = SeriesDownsampler(store)
+    print(f"{'session':>8} {'events':>7} {'method':>7} {'points':>7} {'tier':>5} {'rows read':>9} "
+          f"{'bytes':>7} {'ms':>6}")
+    for session_id, seconds in sessions.items():
+        for method in ('lttb', 'minmax'):
+            t0 = time.perf_counter()
+            result = downsampler.series(['stress'], width=800, method=method, session_id=session_id)
+            elapsed = (time.perf_counter() - t0) * 1000
+            stress = result['series']['stress']
+            size = len(json.dumps(result, separators=(',', ':')))
+            print(f"{session_id:>8} {seconds * 2:>7} {method:>7} {len(stress['t']):>7} {stress['tier']:>5} "
+                  f"{stress['input_points']:>9} {size:>7} {elapsed:>6.1f}")
+
+    server = DownsampleServer(store)
+    server.start()
+    url = f"http://127.0.0.1:{server.port}/series?metric=stress,engagement&session=8h&width=800"
+    t0 = time.perf_counter()
+    with urllib.request.urlopen(url) as response:
+        body = response.read()
+    print(f"GET /series (8h, 2 metrics): {len(body)} bytes in {(time.perf_counter() - t0) * 1000:.1f}ms")
+    server.stop()
@@ -0,0 +1,428 @@
+#!/usr/bin/env python3
+"""
+Lossless EEG Codec
+
+Compact, exactly reversible encoding of raw EEG frames (timestamp, counter,
+interpolated flag and one value per channel) for recordings and transport.
+As decimal text (CSV, JSON) a five-channel frame takes ~97 bytes; this
+codec needs about 7, close to the entropy of the sensor noise itself.
+
+How it works:
+- Fixed point: EMOTIV headsets report values on a grid of 1/7.8 uV (the
+  ADC step), so each value is stored as an integer count. Timestamps become
+  integer microseconds. Every block is checked to decode bit-exactly (e.g.
+  CSV exports print float32 values rounded half-up to 6 decimals);
+  a block that doesn't is stored as raw float64 instead.
+- Prediction: for each column and block, the best of order-0/1/2
+  polynomial predictors (as in FLAC); each EEG channel can further subtract
+  the first channel's residual when that helps (common-mode signal).
+- Entropy coding: zigzag residuals Rice-coded with a per-column parameter,
+  unary quotients and fixed-width remainders packed as two bit planes so
+  both directions are whole-array NumPy operations.
+
+Blocks are small (32 frames = 250 ms at 128 Hz) and length-prefixed, so a
+stream can be written, sent and decoded incrementally. Every
+keyframe_interval-th block carries its first row verbatim and can be
+decoded without the ones before it.
+
+Stream layout:
+    header   b'EEGC', version u8, channels u8, lsb f64, decimals i8,
+             names (u16 length + comma-separated UTF-8)
+    block*   varint length, flags u8 (1 raw, 2 keyframe), frames u8, payload
+
+Usage:
+    encoder = EEGEncoder(['AF3', 'T7', 'Pz', 'T8', 'AF4'])
+    sink.write(encoder.header())
+    for block in encoder.push(timestamp, counter, interpolated, values):
+        sink.write(block)
+    sink.write(encoder.flush())
+
+    decoder = EEGDecoder()
+    for timestamps, counters, interpolated, values in decoder.feed(data):
+        ...
+"""
+
+import struct
+import time
+import numpy as np
+from typing import Iterator, List, Optional, Sequence, Tuple
+
+MAGIC = b'EEGC'
+VERSION = 1
+# EMOTIV raw EEG resolution in microvolts per count
+EMOTIV_LSB = 1 / 7.8
+
+FLAG_RAW = 0x01
+FLAG_KEYFRAME = 0x02
+# Rice parameter value marking a column whose residuals are all equal
+K_CONSTANT = 31
+MAX_K = 30
+
+Frames = Tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray]
+
+
+def _write_varint(out: bytearray, value: int):
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+
+
+def _read_varint(data, pos: int) -> Tuple[int, int]:
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, pos
+        shift += 7
+
+
+def _zigzag(values: np.ndarray) -> np.ndarray:
+    return ((values << 1) ^ (values >> 63)).astype(np.uint64)
+
+
+def _unzigzag(values: np.ndarray) -> np.ndarray:
+    values = values.astype(np.uint64)
+    return ((values >> np.uint64(1)).astype(np.int64)) ^ -((values & np.uint64(1)).astype(np.int64))
+
+
+def _to_values(counts: np.ndarray, lsb: float, decimals: Optional[int]) -> np.ndarray:
+    """Integer counts -> the float64 values the device (or CSV) reports."""
+    values = (counts * lsb).astype(np.float32).astype(np.float64)
+    if decimals is not None:
+        scale = 10.0 ** decimals
+        # Recorder prints round half away from zero
+        values = np.sign(values) * np.floor(np.abs(values) * scale + 0.5) / scale
+    return values
+
+
+class EEGEncoder:
+    """Streaming encoder for one headset."""
+
+    def __init__(self, channels: Sequence[str], lsb: float = EMOTIV_LSB, decimals: Optional[int] = 6,
+                 block_size: int = 32, keyframe_interval: int = 64):
+        """
+        Initialize encoder.
+
+        Args:
+            channels: EEG channel names, in value order
+            lsb: Value of one ADC count (uV)
+            decimals: Decimal places the source rounds values to (None for
+                float32 values as the headset sends them)
+            block_size: Frames per block (max 255)
+            keyframe_interval: Blocks between independently decodable blocks
+        """
+        self.channels = list(channels)
+        self.lsb = lsb
+        self.decimals = decimals
+        self.block_size = min(int(block_size), 255)
+        self.keyframe_interval = keyframe_interval
+
+        self._rows: List[Tuple[float, float, float, Sequence[float]]] = []
+        self._history = None  # last two integer rows
+        self._blocks = 0
+        self.raw_blocks = 0
+
+    def header(self) -> bytes:
+        names = ','.join(self.channels).encode('utf-8')
+        return (MAGIC + struct.pack('<BBdb', VERSION, len(self.channels), self.lsb,
+                                    -1 if self.decimals is None else self.decimals)
+                + struct.pack('<H', len(names)) + names)
+
+    def push(self, timestamp: float, counter: float, interpolated: float, values: Sequence[float]) -> List[bytes]:
+        """Add one frame; returns the blocks it completed (zero or one)."""
+        self._rows.append((timestamp, counter, interpolated, values))
+        if len(self._rows) < self.block_size:
+            return []
+        rows, self._rows = self._rows, []
+        timestamps, counters, interp, values = (np.array(column, dtype=np.float64) for column in zip(*rows))
+        return [self._encode_block(timestamps, counters, interp, values)]
+
+    def push_many(self, timestamps, counters, interpolated, values) -> List[bytes]:
+        """Add many frames at once (e.g. a whole recording)."""
+        timestamps = np.asarray(timestamps, dtype=np.float64)
+        counters = np.asarray(counters, dtype=np.float64)
+        interpolated = np.asarray(interpolated, dtype=np.float64)
+        values = np.asarray(values, dtype=np.float64).reshape(len(timestamps), len(self.channels))
+        blocks = []
+        start = 0
+        # Top up a partly filled block first
+        while self._rows and start < len(timestamps):
+            blocks += self.push(timestamps[start], counters[start], interpolated[start], values[start])
+            start += 1
+        for offset in range(start, len(timestamps) - self.block_size + 1, self.block_size):
+            end = offset + self.block_size
+            blocks.append(self._encode_block(timestamps[offset:end], counters[offset:end],
+                                             interpolated[offset:end], values[offset:end]))
+            start = end
+        for i in range(start, len(timestamps)):
+            self.push(timestamps[i], counters[i], interpolated[i], values[i])
+        return blocks
+
+    def flush(self) -> bytes:
+        """Encode any buffered frames as a final short block."""
+        if not self._rows:
+            return b''
+        rows, self._rows = self._rows, []
+        timestamps, counters, interp, values = (np.array(column, dtype=np.float64) for column in zip(*rows))
+        return self._encode_block(timestamps, counters, interp, values)
+
+    def _encode_block(self, timestamps, counters, interp, values) -> bytes:
+        n = len(timestamps)
+        micros = np.round(timestamps * 1e6)
+        counts = np.round(values / self.lsb)
+        exact = (np.array_equal(micros / 1e6, timestamps)
+                 and np.array_equal(np.round(counters), counters)
+                 and np.array_equal(np.round(interp), interp)
+                 and np.array_equal(_to_values(counts, self.lsb, self.decimals), values))
+
+        out = bytearray()
+        if not exact:
+            self.raw_blocks += 1
+            self._history = None
+            out += bytes((FLAG_RAW, n))
+            out += np.concatenate([timestamps, counters, interp, values.ravel()]).astype('<f8').tobytes()
+            return self._frame(out)
+
+        # Columns: timestamp (us), counter, interpolated, channels
+        x = np.column_stack([micros, counters, interp, counts]).astype(np.int64)
+        keyframe = self._history is None or self._blocks % self.keyframe_interval == 0
+        self._blocks += 1
+        out += bytes((FLAG_KEYFRAME if keyframe else 0, n))
+        if keyframe:
+            for value in _zigzag(x[0]).tolist():
+                _write_varint(out, value)
+            history = np.vstack([x[0], x[0]])
+        else:
+            history = self._history
+        self._history = np.vstack([history, x])[-2:]
+
+        # Residuals of the order-0/1/2 predictors, (3, n, columns)
+        ext = np.vstack([history, x])
+        residuals = np.stack([x, ext[2:] - ext[1:-1], ext[2:] - 2 * ext[1:-1] + ext[:-2]])
+        orders = np.argmin(np.abs(residuals).sum(axis=1), axis=0)
+        chosen = residuals[orders, :, np.arange(x.shape[1])].T
+
+        # Channels may subtract the first channel's residual (common-mode)
+        ref = chosen[:, 3:4]
+        delta = chosen[:, 4:] - ref
+        inter = np.zeros(x.shape[1], dtype=bool)
+        inter[4:] = np.abs(delta).sum(axis=0) < np.abs(chosen[:, 4:]).sum(axis=0)
+        chosen[:, inter] = delta[:, inter[4:]]
+
+        # Rice parameter per column: minimize total bits
+        u = _zigzag(chosen)
+        ks = np.arange(MAX_K + 1, dtype=np.uint64)
+        costs = (u[None, :, :] >> ks[:, None, None]).sum(axis=1) + (ks[:, None] + 1) * np.uint64(n)
+        k = np.argmin(costs, axis=0)
+        constant = (chosen == chosen[:1]).all(axis=0)
+        k[constant] = K_CONSTANT
+
+        out += (orders | (inter.astype(np.int64) << 2) | (k << 3)).astype(np.uint8).tobytes()
+        for column in np.flatnonzero(constant):
+            _write_varint(out, int(u[0, column]))
+
+        coded = np.flatnonzero(~constant)
+        if len(coded):
+            kc = k[coded].astype(np.uint64)
+            uc = u[:, coded].T  # column-major order
+            quotients = (uc >> kc[:, None]).ravel()
+            ones = np.cumsum(quotients.astype(np.int64) + 1) - 1
+            unary = np.zeros(int(ones[-1]) + 1, dtype=np.uint8)
+            unary[ones] = 1
+            unary = np.packbits(unary)
+            _write_varint(out, len(unary))
+            out += unary.tobytes()
+
+            width = int(kc.max())
+            if width:
+                shifts = np.arange(width - 1, -1, -1, dtype=np.uint64)
+                bits = ((uc[:, :, None] >> shifts) & np.uint64(1)).astype(np.uint8)
+                # Keep each column's low k bits only
+                keep = np.arange(width)[None, :] >= (width - kc.astype(np.int64))[:, None]
+                out += np.packbits(bits[np.broadcast_to(keep[:, None, :], bits.shape)]).tobytes()
+        return self._frame(out)
+
+    @staticmethod
+    def _frame(payload: bytearray) -> bytes:
+        prefix = bytearray()
+        _write_varint(prefix, len(payload))
+        return bytes(prefix + payload)
+
+
+class EEGDecoder:
+    """Streaming decoder; feed it bytes in any chunking."""
+
+    def __init__(self):
+        self.channels: Optional[List[str]] = None
+        self.lsb = EMOTIV_LSB
+        self.decimals: Optional[int] = None
+        self._buffer = bytearray()
+        self._history = None
+
+    def feed(self, data: bytes) -> Iterator[Frames]:
+        """
+        Add bytes; yields (timestamps, counters, interpolated, values) per complete block.
+        """
+        self._buffer += data
+        if self.channels is None:
+            if len(self._buffer) < 17:
+                return
+            if bytes(self._buffer[:4]) != MAGIC:
+                raise ValueError("Not an EEG codec stream")
+            version, count, self.lsb, decimals = struct.unpack_from('<BBdb', self._buffer, 4)
+            if version != VERSION:
+                raise ValueError(f"Unsupported EEG codec version {version}")
+            (length,) = struct.unpack_from('<H', self._buffer, 15)
+            if len(self._buffer) < 17 + length:
+                return
+            self.channels = bytes(self._buffer[17:17 + length]).decode('utf-8').split(',')[:count]
+            self.decimals = None if decimals < 0 else decimals
+            del self._buffer[:17 + length]
+
+        pos = 0
+        while pos < len(self._buffer):
+            try:
+                length, start = _read_varint(self._buffer, pos)
+            except IndexError:
+                break
+            if start + length > len(self._buffer):
+                break
+            yield self._decode_block(bytes(self._buffer[start:start + length]))
+            pos = start + length
+        del self._buffer[:pos]
+
+    def _decode_block(self, block) -> Frames:
+        flags, n = block[0], block[1]
+        channels = len(self.channels)
+        if flags & FLAG_RAW:
+            data = np.frombuffer(block, dtype='<f8', offset=2)
+            self._history = None
+            return data[:n], data[n:2 * n], data[2 * n:3 * n], data[3 * n:].reshape(n, channels)
+
+        columns = channels + 3
+        pos = 2
+        if flags & FLAG_KEYFRAME:
+            first = []
+            for _ in range(columns):
+                value, pos = _read_varint(block, pos)
+                first.append(value)
+            first = _unzigzag(np.array(first, dtype=np.uint64))
+            history = np.vstack([first, first])
+        elif self._history is None:
+            raise ValueError("Block depends on history the decoder does not have")
+        else:
+            history = self._history
+
+        params = np.frombuffer(block, dtype=np.uint8, count=columns, offset=pos).astype(np.int64)
+        pos += columns
+        orders, inter, k = params & 3, (params >> 2) & 1, params >> 3
+        constant = k == K_CONSTANT
+
+        u = np.zeros((n, columns), dtype=np.uint64)
+        for column in np.flatnonzero(constant):
+            value, pos = _read_varint(block, pos)
+            u[:, column] = value
+
+        coded = np.flatnonzero(~constant)
+        if len(coded):
+            length, pos = _read_varint(block, pos)
+            unary = np.unpackbits(np.frombuffer(block, dtype=np.uint8, count=length, offset=pos))
+            pos += length
+            ones = np.flatnonzero(unary)[:len(coded) * n]
+            quotients = np.diff(ones, prepend=-1) - 1
+
+            kc = k[coded]
+            width = int(kc.max())
+            remainders = np.zeros(len(coded) * n, dtype=np.uint64)
+            if width:
+                total = int(kc.sum()) * n
+                bits = np.unpackbits(np.frombuffer(block, dtype=np.uint8, offset=pos))[:total]
+                keep = np.arange(width)[None, :] >= (width - kc)[:, None]
+                full = np.zeros((len(coded), n, width), dtype=np.uint8)
+                full[np.broadcast_to(keep[:, None, :], full.shape)] = bits
+                weights = (np.uint64(1) << np.arange(width - 1, -1, -1, dtype=np.uint64))
+                remainders = (full.astype(np.uint64) * weights).sum(axis=2).ravel()
+            u[:, coded] = ((quotients.astype(np.uint64) << np.repeat(kc, n).astype(np.uint64))
+                           | remainders).reshape(len(coded), n).T
+
+        residuals = _unzigzag(u)
+        mask = inter.astype(bool)
+        residuals[:, mask] += residuals[:, 3:4]
+
+        # Undo prediction: order 1 is a running sum, order 2 a running sum of differences
+        x = residuals.copy()
+        order1 = orders == 1
+        order2 = orders == 2
+        x[:, order1] = history[1, order1] + np.cumsum(residuals[:, order1], axis=0)
+        slope = history[1, order2] - history[0, order2]
+        x[:, order2] = history[1, order2] + np.cumsum(slope + np.cumsum(residuals[:, order2], axis=0), axis=0)
+        self._history = np.vstack([history, x])[-2:]
+
+        return (x[:, 0] / 1e6, x[:, 1].astype(np.float64), x[:, 2].astype(np.float64),
+                _to_values(x[:, 3:], self.lsb, self.decimals))
+
+
+def load_csv(path: str, channels: Sequence[str] = ('AF3', 'T7', 'Pz', 'T8', 'AF4')) -> Frames:
+    """Read the EEG frames of an EMOTIV CSV export (rows without EEG are skipped)."""
+    with open(path) as f:
+        f.readline()  # Recording metadata
+        header = f.readline().strip().split(',')
+        columns = [header.index(name) for name in
+                   ['Timestamp', 'EEG.Counter', 'EEG.Interpolated'] + [f'EEG.{c}' for c in channels]]
+        rows = []
+        for line in f:
+            fields = line.split(',')
+            if fields[columns[3]]:
+                rows.append([fields[i] for i in columns])
+    data = np.array(rows, dtype=np.float64)
+    return data[:, 0], data[:, 1], data[:, 2], data[:, 3:]
+
+
+if __name__ == "__main__":
+    import os
+    import glob
+    import json
+
+    channels = ['AF3', 'T7', 'Pz', 'T8', 'AF4']
+    paths = glob.glob(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'recorded_samples', '*.csv'))
+    if not paths:
+        print("No recordings found in recorded_samples/")
+        raise SystemExit(1)
+
+    timestamps, counters, interp, values = load_csv(paths[0], channels)
+    n = len(timestamps)
+    text_bytes = sum(len(','.join(f'{v:.6f}' for v in row)) + 1 for row in
+                     np.column_stack([timestamps, counters, interp, values]))
+    json_bytes = len(json.dumps([[t, c, i] + list(v) for t, c, i, v in
+                                 zip(timestamps.tolist(), counters.tolist(), interp.tolist(), values.tolist())]))
+
+    encoder = EEGEncoder(channels)
+    start = time.perf_counter()
+    stream = encoder.header() + b''.join(encoder.push_many(timestamps, counters, interp, values)) + encoder.flush()
+    encode_time = time.perf_counter() - start
+
+    decoder = EEGDecoder()
+    start = time.perf_counter()
+    # Arbitrary chunking, as it would arrive over a socket
+    parts = [part for offset in range(0, len(stream), 1500) for part in decoder.feed(stream[offset:offset + 1500])]
+    decode_time = time.perf_counter() - start
+    decoded = [np.concatenate(column) for column in zip(*parts)]
+
+    lossless = all(np.array_equal(a, b) for a, b in zip(decoded, (timestamps, counters, interp, values)))
+    print(f"{n} frames ({n / 128 / 60:.1f} min at 128 Hz), lossless: {lossless}, raw blocks: {encoder.raw_blocks}")
+    print(f"  CSV text {text_bytes / 1e6:.2f} MB, JSON {json_bytes / 1e6:.2f} MB, "
+          f"codec {len(stream) / 1e6:.3f} MB ({len(stream) / n:.2f} B/frame, "
+          f"{text_bytes / len(stream):.1f}x smaller than text)")
+    print(f"  encode {n / encode_time / 1e3:.0f}k frames/s ({n / encode_time / 128:.0f} headsets real time), "
+          f"decode {n / decode_time / 1e3:.0f}k frames/s ({n / decode_time / 128:.0f} headsets)")
+
+    # Live path: frame by frame
+    encoder = EEGEncoder(channels)
+    start = time.perf_counter()
+    for i in range(4096):
+        encoder.push(timestamps[i], counters[i], interp[i], values[i])
+    per_frame = (time.perf_counter() - start) / 4096
+    print(f"  live push: {per_frame * 1e6:.1f} us/frame ({1 / per_frame / 128:.0f} headsets real time)")
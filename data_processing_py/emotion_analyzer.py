@@ -1,6 +1,8 @@
 import json
 import time
+import threading
 import numpy as np
+from types import MappingProxyType
 from typing import Dict, List, Optional, Tuple
 
 class EmotionAnalyzer:
@@ -13,36 +15,47 @@ class EmotionAnalyzer:
     
     # Comprehensive emotion vectors for AI therapy context
     # Format: [engagement, excitement, stress, relaxation, interest, attention]
-    EMOTION_VECTORS = {
+    EMOTION_VECTORS = MappingProxyType({
         # Positive states
-        'excited':      [0.85, 0.85, 0.25, 0.30, 0.75, 0.80],
-        'focused':      [0.90, 0.50, 0.20, 0.65, 0.70, 0.95],
-        'calm':         [0.40, 0.20, 0.15, 0.85, 0.45, 0.60],
-        'interested':   [0.80, 0.70, 0.20, 0.55, 0.95, 0.85],
-        'relaxed':      [0.35, 0.25, 0.10, 0.90, 0.40, 0.50],
-        'alert':        [0.85, 0.65, 0.30, 0.50, 0.80, 0.90],
+        'excited':      (0.85, 0.85, 0.25, 0.30, 0.75, 0.80),
+        'focused':      (0.90, 0.50, 0.20, 0.65, 0.70, 0.95),
+        'calm':         (0.40, 0.20, 0.15, 0.85, 0.45, 0.60),
+        'interested':   (0.80, 0.70, 0.20, 0.55, 0.95, 0.85),
+        'relaxed':      (0.35, 0.25, 0.10, 0.90, 0.40, 0.50),
+        'alert':        (0.85, 0.65, 0.30, 0.50, 0.80, 0.90),
         
         # Negative states for therapy
-        'stressed':     [0.70, 0.60, 0.90, 0.15, 0.30, 0.75],
-        'anxious':      [0.65, 0.75, 0.85, 0.20, 0.40, 0.70],
-        'depressed':    [0.20, 0.10, 0.75, 0.25, 0.15, 0.30],
-        'overwhelmed':  [0.55, 0.80, 0.95, 0.05, 0.25, 0.85],
-        'frustrated':   [0.75, 0.85, 0.80, 0.10, 0.60, 0.90],
-        'hopeless':     [0.15, 0.05, 0.85, 0.10, 0.05, 0.20],
-        'lonely':       [0.25, 0.15, 0.65, 0.35, 0.20, 0.40],
-        'guilty':       [0.45, 0.30, 0.90, 0.15, 0.35, 0.55],
-        'ashamed':      [0.35, 0.25, 0.80, 0.20, 0.25, 0.45],
-        'angry':        [0.80, 0.95, 0.90, 0.05, 0.70, 0.85],
-        'disgusted':    [0.60, 0.70, 0.85, 0.10, 0.50, 0.75],
-        'fearful':      [0.70, 0.90, 0.95, 0.05, 0.65, 0.95],
+        'stressed':     (0.70, 0.60, 0.90, 0.15, 0.30, 0.75),
+        'anxious':      (0.65, 0.75, 0.85, 0.20, 0.40, 0.70),
+        'depressed':    (0.20, 0.10, 0.75, 0.25, 0.15, 0.30),
+        'overwhelmed':  (0.55, 0.80, 0.95, 0.05, 0.25, 0.85),
+        'frustrated':   (0.75, 0.85, 0.80, 0.10, 0.60, 0.90),
+        'hopeless':     (0.15, 0.05, 0.85, 0.10, 0.05, 0.20),
+        'lonely':       (0.25, 0.15, 0.65, 0.35, 0.20, 0.40),
+        'guilty':       (0.45, 0.30, 0.90, 0.15, 0.35, 0.55),
+        'ashamed':      (0.35, 0.25, 0.80, 0.20, 0.25, 0.45),
+        'angry':        (0.80, 0.95, 0.90, 0.05, 0.70, 0.85),
+        'disgusted':    (0.60, 0.70, 0.85, 0.10, 0.50, 0.75),
+        'fearful':      (0.70, 0.90, 0.95, 0.05, 0.65, 0.95),
         
         # Neutral/baseline
-        'neutral':      [0.50, 0.50, 0.50, 0.50, 0.50, 0.50],
-        'bored':        [0.20, 0.15, 0.25, 0.60, 0.15, 0.25]
-    }
+        'neutral':      (0.50, 0.50, 0.50, 0.50, 0.50, 0.50),
+        'bored':        (0.20, 0.15, 0.25, 0.60, 0.15, 0.25)
+    })
     
     # Map vector indices to metric names for easier access
-    METRIC_NAMES = ['engagement', 'excitement', 'stress', 'relaxation', 'interest', 'attention']
+    METRIC_NAMES = ('engagement', 'excitement', 'stress', 'relaxation', 'interest', 'attention')
+    
+    # Prototype tables are shared by every analyzer instance (and thread), so
+    # they are immutable: a mapping proxy of tuples plus a read-only matrix
+    EMOTION_NAMES = tuple(EMOTION_VECTORS.keys())
+    _EMOTION_MATRIX = np.array(list(EMOTION_VECTORS.values()), dtype=np.float64)
+    _EMOTION_MATRIX.setflags(write=False)
+    
+    NEGATIVE_EMOTIONS = frozenset({
+        'stressed', 'anxious', 'depressed', 'overwhelmed', 'frustrated',
+        'hopeless', 'lonely', 'guilty', 'ashamed', 'angry', 'disgusted', 'fearful'
+    })
     
     # Emotion descriptions for better understanding
     EMOTION_DESCRIPTIONS = {
@@ -72,12 +85,14 @@ class EmotionAnalyzer:
         'neutral': 'Baseline state with balanced metrics'
     }
     
-    def __init__(self, thresholds: Optional[Dict] = None):
+    def __init__(self, thresholds: Optional[Dict] = None, baseline=None):
         """
         Initialize emotion analyzer with configurable thresholds.
         
         Args:
             thresholds: Custom thresholds for emotion detection
+            baseline: Optional UserBaseline; metrics are normalized against
+                the user's own resting levels instead of only clamped
         """
         self.thresholds = thresholds or {
             'engagement': 0.7,
@@ -90,13 +105,15 @@ class EmotionAnalyzer:
         self.emotion_history = []
         self.smoothing_window = 5
         self.min_change_threshold = 0.2
+        self.baseline = baseline
+        
+        # Guards per-instance history; use one analyzer per session so
+        # sessions never contend on it
+        self._lock = threading.Lock()
         
         # Therapy-specific thresholds
         self.crisis_threshold = 0.85  # High stress + low relaxation
-        self.negative_emotions = {
-            'stressed', 'anxious', 'depressed', 'overwhelmed', 'frustrated',
-            'hopeless', 'lonely', 'guilty', 'ashamed', 'angry', 'disgusted', 'fearful'
-        }
+        self.negative_emotions = self.NEGATIVE_EMOTIONS
         
     def analyze_emotion(self, metrics: Dict[str, float], timestamp: float) -> Dict:
         """
@@ -151,17 +168,21 @@ class EmotionAnalyzer:
         }
         
         # Update history
-        self.previous_emotion = dominant_emotion
-        self.emotion_history.append(emotion_event)
-        
-        # Keep only recent history
-        if len(self.emotion_history) > self.smoothing_window * 10:
-            self.emotion_history = self.emotion_history[-self.smoothing_window * 10:]
+        with self._lock:
+            self.previous_emotion = dominant_emotion
+            self.emotion_history.append(emotion_event)
+            
+            # Keep only recent history
+            if len(self.emotion_history) > self.smoothing_window * 10:
+                self.emotion_history = self.emotion_history[-self.smoothing_window * 10:]
             
         return emotion_event
     
     def _normalize_metrics(self, metrics: Dict[str, float]) -> Dict[str, float]:
-        """Normalize metrics to 0-1 range based on Emotiv scaling."""
+        """Normalize metrics to 0-1 range based on Emotiv scaling (and the user's baseline)."""
+        if self.baseline is not None:
+            normalize = self.baseline.normalize
+            return {key: normalize(key, float(value)) for key, value in metrics.items()}
         normalized = {}
         for key, value in metrics.items():
             # Emotiv scaled values are already 0-1
@@ -170,25 +191,17 @@ class EmotionAnalyzer:
     
     def _calculate_emotion_scores(self, metrics: Dict[str, float]) -> Dict[str, float]:
         """Calculate similarity scores for each emotion category."""
-        scores = {}
-        
-        for emotion, vector in self.EMOTION_VECTORS.items():
-            score = 0
-            count = 0
-            
-            # Map vector indices to metric names
-            for i, metric_name in enumerate(self.METRIC_NAMES):
-                if metric_name in metrics and i < len(vector):
-                    target = vector[i]
-                    # Calculate similarity (1 - absolute difference)
-                    similarity = 1 - abs(metrics[metric_name] - target)
-                    score += similarity
-                    count += 1
-            
-            # Average similarity score
-            scores[emotion] = score / count if count > 0 else 0
-            
-        return scores
+        # Only metrics that are present count towards the average
+        columns = [i for i, name in enumerate(self.METRIC_NAMES) if name in metrics]
+        if not columns:
+            return dict.fromkeys(self.EMOTION_NAMES, 0)
+        
+        # Similarity (1 - absolute difference) against every prototype at once,
+        # accumulated metric by metric so ties resolve as they always have
+        score = np.zeros(len(self.EMOTION_NAMES))
+        for i in columns:
+            score += 1 - np.abs(metrics[self.METRIC_NAMES[i]] - self._EMOTION_MATRIX[:, i])
+        return dict(zip(self.EMOTION_NAMES, (score / len(columns)).tolist()))
     
     def _get_dominant_emotion(self, scores: Dict[str, float]) -> str:
         """Get the dominant emotion based on highest score."""
@@ -211,13 +224,13 @@ class EmotionAnalyzer:
     
     def _calculate_severity(self, metrics: Dict[str, float], emotion: str) -> float:
         """Calculate emotion severity based on metric intensity."""
-        if emotion in ['depressed', 'hopeless', 'lonely']:
+        if emotion in ('depressed', 'hopeless', 'lonely'):
             # Low engagement + high stress
             return max(0, 1 - metrics.get('engagement', 0)) * 0.5 + metrics.get('stress', 0) * 0.5
-        elif emotion in ['anxious', 'fearful', 'overwhelmed']:
+        elif emotion in ('anxious', 'fearful', 'overwhelmed'):
             # High stress + high excitement
             return metrics.get('stress', 0) * 0.6 + metrics.get('excitement', 0) * 0.4
-        elif emotion in ['angry', 'frustrated']:
+        elif emotion in ('angry', 'frustrated'):
             # High stress + high excitement + low relaxation
             return (metrics.get('stress', 0) + metrics.get('excitement', 0) + (1 - metrics.get('relaxation', 0))) / 3
         else:
@@ -233,7 +246,10 @@ class EmotionAnalyzer:
         Returns:
             Dictionary with trend analysis including therapy indicators
         """
-        if len(self.emotion_history) < window_size:
+        with self._lock:
+            recent = self.emotion_history[-window_size:]
+        
+        if len(recent) < window_size:
             return {
                 'trend': 'insufficient_data', 
                 'stability': 0.0,
@@ -244,7 +260,6 @@ class EmotionAnalyzer:
                 }
             }
         
-        recent = self.emotion_history[-window_size:]
         emotions = [event['emotion'] for event in recent]
         
         # Calculate emotion stability
@@ -285,12 +300,15 @@ class EmotionAnalyzer:
     
     def export_emotion_stream(self) -> str:
         """Export emotion history as JSON string."""
-        return json.dumps(self.emotion_history, indent=2)
+        with self._lock:
+            history = list(self.emotion_history)
+        return json.dumps(history, indent=2)
     
     def reset(self):
         """Reset analyzer state."""
-        self.previous_emotion = None
-        self.emotion_history = []
+        with self._lock:
+            self.previous_emotion = None
+            self.emotion_history = []
 
 
 class EmotionStreamProcessor:
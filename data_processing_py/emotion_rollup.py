@@ -0,0 +1,377 @@
+#!/usr/bin/env python3
+"""
+Emotion Rollup Store
+
+Maintains time-bucketed aggregates of emotion events (1 s, 10 s, 1 min,
+10 min and 1 h tiers) incrementally as events are written, in SQLite.
+Long-range queries read the coarsest tier that satisfies the requested
+resolution instead of scanning raw events.
+
+Each bucket stores per-emotion counts, metric sum/min/max (mean = sum / n)
+and crisis maxima, all of which merge associatively. That lets partial
+buckets be flushed at any time and lets buckets be re-aggregated in SQL.
+"""
+
+import json
+import time
+import sqlite3
+import threading
+import numpy as np
+from typing import Dict, List, Optional
+
+from emotion_analyzer import EmotionAnalyzer
+
+TIERS = (1, 10, 60, 600, 3600)
+METRICS = tuple(EmotionAnalyzer.METRIC_NAMES)
+EMOTIONS = tuple(EmotionAnalyzer.EMOTION_VECTORS.keys())
+
+
+class _Bucket:
+    """Pending (not yet flushed) aggregate for one session/tier/bucket."""
+
+    __slots__ = ('n', 'counts', 'sums', 'mins', 'maxs', 'crisis_max', 'interventions')
+
+    def __init__(self):
+        self.n = 0
+        self.counts = [0] * len(EMOTIONS)
+        self.sums = [0.0] * len(METRICS)
+        self.mins = [float('inf')] * len(METRICS)
+        self.maxs = [float('-inf')] * len(METRICS)
+        self.crisis_max = 0.0
+        self.interventions = 0
+
+    def add(self, emotion_idx: int, values: List[float], crisis: float, intervention: bool):
+        self.n += 1
+        if emotion_idx >= 0:
+            self.counts[emotion_idx] += 1
+        for i, v in enumerate(values):
+            self.sums[i] += v
+            if v < self.mins[i]:
+                self.mins[i] = v
+            if v > self.maxs[i]:
+                self.maxs[i] = v
+        if crisis > self.crisis_max:
+            self.crisis_max = crisis
+        if intervention:
+            self.interventions += 1
+
+
+class EmotionRollupStore:
+    """
+    Incremental multi-resolution aggregates of emotion events.
+
+    Usage:
+        store = EmotionRollupStore("emotions.db")
+        store.write(event, session_id="s1")      # per event, O(1)
+        rows = store.query(start, end, resolution=600)
+    """
+
+    def __init__(self, path: str = ":memory:", store_raw: bool = True, commit_interval: float = 1.0):
+        """
+        Initialize rollup store.
+
+        Args:
+            path: SQLite database file (":memory:" for tests)
+            store_raw: Also keep raw events in an indexed table
+            commit_interval: Seconds between commits from write(); finished
+                buckets and raw events become visible to other connections
+                (and survive a crash) at this interval
+        """
+        self.store_raw = store_raw
+        self.commit_interval = commit_interval
+        self._last_commit = time.monotonic()
+        self.conn = sqlite3.connect(path, check_same_thread=False)
+        self.conn.execute("PRAGMA journal_mode=WAL")
+        self.conn.execute("PRAGMA synchronous=NORMAL")
+        self._lock = threading.Lock()
+        self._closed = False
+        self._emotion_index = {e: i for i, e in enumerate(EMOTIONS)}
+
+        # (tier, session_id) -> (bucket_start, _Bucket)
+        self._open: Dict[tuple, tuple] = {}
+        self._raw_pending = []
+
+        self._create_schema()
+
+    def _columns(self) -> List[str]:
+        cols = ['n'] + [f"c_{e}" for e in EMOTIONS]
+        for m in METRICS:
+            cols += [f"{m}_sum", f"{m}_min", f"{m}_max"]
+        return cols + ['crisis_max', 'interventions']
+
+    def _create_schema(self):
+        cols = ', '.join(f"{c} {'INTEGER' if c == 'n' or c.startswith('c_') or c == 'interventions' else 'REAL'}"
+                         for c in self._columns())
+        with self.conn:
+            for tier in TIERS:
+                self.conn.execute(
+                    f"CREATE TABLE IF NOT EXISTS rollup_{tier} ("
+                    f"session_id TEXT NOT NULL, bucket INTEGER NOT NULL, {cols}, "
+                    f"PRIMARY KEY (session_id, bucket))"
+                )
+                self.conn.execute(f"CREATE INDEX IF NOT EXISTS rollup_{tier}_bucket ON rollup_{tier} (bucket)")
+            self.conn.execute(
+                "CREATE TABLE IF NOT EXISTS raw_events ("
+                "session_id TEXT NOT NULL, timestamp REAL NOT NULL, event TEXT NOT NULL)"
+            )
+            self.conn.execute("CREATE INDEX IF NOT EXISTS raw_events_time ON raw_events (session_id, timestamp)")
+
+    def write(self, event: Dict, session_id: str = "default"):
+        """
+        Add one emotion event to every tier.
+
+        Args:
+            event: Event as produced by EmotionAnalyzer.analyze_emotion
+            session_id: Session the event belongs to
+        """
+        timestamp = float(event['timestamp'])
+        metrics = event.get('metrics', {})
+        values = [float(metrics.get(m, 0.0)) for m in METRICS]
+        indicators = event.get('therapy_indicators', {})
+        crisis = float(indicators.get('crisis_level', 0.0))
+        intervention = bool(indicators.get('needs_intervention', False))
+        emotion_idx = self._emotion_index.get(event.get('emotion'), -1)
+
+        with self._lock:
+            if self._closed:
+                return  # late event from a stream that outlived the store
+            for tier in TIERS:
+                bucket_start = int(timestamp // tier) * tier
+                key = (tier, session_id)
+                current = self._open.get(key)
+
+                if current is None or current[0] != bucket_start:
+                    # Bucket boundary crossed: persist the finished bucket
+                    if current is not None:
+                        self._flush_bucket(tier, session_id, *current)
+                    current = (bucket_start, _Bucket())
+                    self._open[key] = current
+
+                current[1].add(emotion_idx, values, crisis, intervention)
+
+            if self.store_raw:
+                self._raw_pending.append((session_id, timestamp, json.dumps(event)))
+                if len(self._raw_pending) >= 256:
+                    self._flush_raw()
+
+            now = time.monotonic()
+            if now - self._last_commit >= self.commit_interval:
+                self._flush_raw()
+                self.conn.commit()
+                self._last_commit = now
+
+    def flush(self):
+        """Persist all pending partial buckets (safe to call at any time)."""
+        with self._lock:
+            self._flush_all()
+
+    def close(self):
+        """Flush and close; later write() and flush() calls are ignored."""
+        with self._lock:
+            if self._closed:
+                return
+            self._flush_all()
+            self._closed = True
+            self.conn.close()
+
+    def _flush_all(self):
+        if self._closed:
+            return
+        for (tier, session_id), (bucket_start, bucket) in self._open.items():
+            self._flush_bucket(tier, session_id, bucket_start, bucket)
+        self._open.clear()
+        self._flush_raw()
+        self.conn.commit()
+        self._last_commit = time.monotonic()
+
+    def _flush_raw(self):
+        if self._raw_pending:
+            self.conn.executemany("INSERT INTO raw_events VALUES (?, ?, ?)", self._raw_pending)
+            self._raw_pending = []
+
+    def _flush_bucket(self, tier: int, session_id: str, bucket_start: int, bucket: _Bucket):
+        if bucket.n == 0:
+            return
+        row = [bucket.n] + bucket.counts
+        for i in range(len(METRICS)):
+            row += [bucket.sums[i], bucket.mins[i], bucket.maxs[i]]
+        row += [bucket.crisis_max, bucket.interventions]
+
+        # Merge with any earlier partial flush of the same bucket
+        cols = self._columns()
+        updates = []
+        for c in cols:
+            if c.endswith('_min'):
+                updates.append(f"{c} = MIN({c}, excluded.{c})")
+            elif c.endswith('_max'):
+                updates.append(f"{c} = MAX({c}, excluded.{c})")
+            else:
+                updates.append(f"{c} = {c} + excluded.{c}")
+
+        self.conn.execute(
+            f"INSERT INTO rollup_{tier} (session_id, bucket, {', '.join(cols)}) "
+            f"VALUES ({', '.join('?' * (len(cols) + 2))}) "
+            f"ON CONFLICT (session_id, bucket) DO UPDATE SET {', '.join(updates)}",
+            [session_id, bucket_start] + row
+        )
+
+    @staticmethod
+    def pick_tier(resolution: float) -> int:
+        """Coarsest tier whose bucket size does not exceed the resolution."""
+        eligible = [t for t in TIERS if t <= resolution]
+        return max(eligible) if eligible else TIERS[0]
+
+    def query(self, start: float, end: float, resolution: float = 60,
+              session_id: Optional[str] = None, flush: bool = True) -> List[Dict]:
+        """
+        Aggregates over [start, end) in buckets of the given resolution.
+
+        Args:
+            start: Range start (epoch seconds)
+            end: Range end (epoch seconds)
+            resolution: Desired bucket size in seconds
+            session_id: Restrict to one session (None = all sessions)
+            flush: Persist pending partial buckets first so results are current
+
+        Returns:
+            One dict per non-empty bucket, oldest first
+        """
+        if flush:
+            self.flush()
+
+        tier = self.pick_tier(resolution)
+        # Re-bucket in SQL when the resolution is coarser than the tier
+        step = max(tier, int(resolution // tier) * tier)
+
+        selects = ['SUM(n)'] + [f"SUM(c_{e})" for e in EMOTIONS]
+        for m in METRICS:
+            selects += [f"SUM({m}_sum)", f"MIN({m}_min)", f"MAX({m}_max)"]
+        selects += ['MAX(crisis_max)', 'SUM(interventions)']
+
+        sql = (f"SELECT (bucket / {step}) * {step} AS b, {', '.join(selects)} "
+               f"FROM rollup_{tier} WHERE bucket >= ? AND bucket < ?")
+        params = [int(start // tier) * tier, end]
+        if session_id is not None:
+            sql += " AND session_id = ?"
+            params.append(session_id)
+        sql += " GROUP BY b ORDER BY b"
+
+        with self._lock:
+            rows = self.conn.execute(sql, params).fetchall()
+
+        results = []
+        for row in rows:
+            n = row[1]
+            counts = {e: c for e, c in zip(EMOTIONS, row[2:2 + len(EMOTIONS)]) if c}
+            offset = 2 + len(EMOTIONS)
+            metrics = {}
+            for i, m in enumerate(METRICS):
+                total, lo, hi = row[offset + 3 * i: offset + 3 * i + 3]
+                metrics[m] = {'mean': round(total / n, 4), 'min': lo, 'max': hi}
+            results.append({
+                'bucket': row[0],
+                'resolution': step,
+                'tier': tier,
+                'n': n,
+                'emotion_counts': counts,
+                'dominant_emotion': max(counts, key=counts.get) if counts else None,
+                'metrics': metrics,
+                'crisis_max': row[-2],
+                'interventions': row[-1]
+            })
+        return results
+
+    def series(self, metric: str, start: float, end: float, resolution: float,
+               session_id: Optional[str] = None, flush: bool = True) -> Dict[str, np.ndarray]:
+        """
+        One metric over [start, end) as arrays, one entry per non-empty bucket.
+
+        Cheaper than query() when only a single line is needed (e.g. charts).
+
+        Args:
+            metric: Name from METRICS, or 'crisis' (crisis_max per bucket)
+            start: Range start (epoch seconds)
+            end: Range end (epoch seconds)
+            resolution: Desired bucket size in seconds
+            session_id: Restrict to one session (None = all sessions)
+            flush: Persist pending partial buckets first
+
+        Returns:
+            Dict of arrays: bucket, n, mean, min, max (plus 'step' and 'tier')
+        """
+        if metric == 'crisis':
+            columns = "MAX(crisis_max), MAX(crisis_max), MAX(crisis_max)"
+        elif metric in METRICS:
+            columns = f"SUM({metric}_sum), MIN({metric}_min), MAX({metric}_max)"
+        else:
+            raise ValueError(f"Unknown metric: {metric}")
+
+        if flush:
+            self.flush()
+
+        tier = self.pick_tier(resolution)
+        step = max(tier, int(resolution // tier) * tier)
+        sql = (f"SELECT (bucket / {step}) * {step} AS b, SUM(n), {columns} "
+               f"FROM rollup_{tier} WHERE bucket >= ? AND bucket < ?")
+        params = [int(start // tier) * tier, end]
+        if session_id is not None:
+            sql += " AND session_id = ?"
+            params.append(session_id)
+        sql += " GROUP BY b ORDER BY b"
+
+        with self._lock:
+            rows = np.array(self.conn.execute(sql, params).fetchall(), dtype=np.float64).reshape(-1, 5)
+
+        n = rows[:, 1]
+        mean = rows[:, 2] if metric == 'crisis' else rows[:, 2] / np.maximum(n, 1)
+        return {'bucket': rows[:, 0], 'n': n, 'mean': mean, 'min': rows[:, 3], 'max': rows[:, 4],
+                'step': step, 'tier': tier}
+
+    def time_range(self, session_id: Optional[str] = None) -> Optional[tuple]:
+        """(first, last + 1) second covered by stored buckets, or None if empty."""
+        self.flush()
+        sql = "SELECT MIN(bucket), MAX(bucket) FROM rollup_1"
+        params = []
+        if session_id is not None:
+            sql += " WHERE session_id = ?"
+            params.append(session_id)
+        with self._lock:
+            lo, hi = self.conn.execute(sql, params).fetchone()
+        return None if lo is None else (lo, hi + 1)
+
+    def raw_events(self, session_id: str, start: float, end: float) -> List[Dict]:
+        """Raw events for one session in [start, end), via the time index."""
+        self.flush()
+        with self._lock:
+            rows = self.conn.execute(
+                "SELECT event FROM raw_events WHERE session_id = ? AND timestamp >= ? AND timestamp < ? "
+                "ORDER BY timestamp", (session_id, start, end)
+            ).fetchall()
+        return [json.loads(r[0]) for r in rows]
+
+
+if __name__ == "__main__":
+    import random
+
+    analyzer = EmotionAnalyzer()
+    store = EmotionRollupStore(":memory:", store_raw=False)
+
+    # Two hours of 2 Hz events for three sessions
+    start = 1_753_430_000
+    write_start = time.perf_counter()
+    for session in ('s1', 's2', 's3'):
+        analyzer.reset()
+        for i in range(2 * 60 * 60 * 2):
+            metrics = {m: random.random() for m in METRICS}
+            event = analyzer.analyze_emotion(metrics, start + i * 0.5)
+            store.write(event, session_id=session)
+    store.flush()
+    print(f"Wrote 43,200 events in {time.perf_counter() - write_start:.2f}s")
+
+    for resolution in (1, 30, 600):
+        t0 = time.perf_counter()
+        rows = store.query(start, start + 7200, resolution=resolution)
+        print(f"resolution {resolution:>4}s -> tier {rows[0]['tier']:>2}s, "
+              f"{len(rows)} buckets in {(time.perf_counter() - t0) * 1000:.1f}ms")
+
+    print(json.dumps(rows[0], indent=2))
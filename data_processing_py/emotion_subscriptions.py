@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""
+Emotion Stream Subscriptions
+
+Lets WebSocket clients declare which fields of an emotion event they want
+and which events they want at all. Clients with identical declarations share
+one subscription "shape": the filter is evaluated and the payload projected
+and JSON-encoded once per shape, then sent to every client of that shape.
+
+A subscription is given either as a query string on connect
+
+    ws://localhost:8765/?fields=emotion_id,timestamp
+    ws://localhost:8765/?fields=emotion,previous_emotion,timestamp&transitions=1
+
+or as a message at any time
+
+    {"type": "subscribe",
+     "fields": ["emotion", "therapy_indicators.crisis_level"],
+     "where": [["therapy_indicators.crisis_level", ">=", 0.5]],
+     "transitions": false,
+     "min_interval": 1.0}
+
+No declaration means the full event, as before.
+"""
+
+import json
+import operator
+from typing import Dict, List, Optional, Tuple
+from urllib.parse import parse_qs, urlparse
+
+from emotion_analyzer import EmotionAnalyzer
+
+EMOTION_IDS = {name: i for i, name in enumerate(EmotionAnalyzer.EMOTION_NAMES)}
+
+OPERATORS = {
+    '==': operator.eq, '!=': operator.ne,
+    '>': operator.gt, '>=': operator.ge, '<': operator.lt, '<=': operator.le,
+    'in': lambda value, options: value in options,
+    'not in': lambda value, options: value not in options,
+}
+
+_MISSING = object()
+
+
+def _lookup(event: Dict, path: Tuple[str, ...]):
+    value = event
+    for key in path:
+        if not isinstance(value, dict) or key not in value:
+            return _MISSING
+        value = value[key]
+    return value
+
+
+class SubscriptionShape:
+    """One distinct (fields, filter) declaration shared by any number of clients."""
+
+    def __init__(self, fields: Optional[List[str]] = None, where: Optional[List] = None,
+                 transitions: bool = False, min_interval: float = 0.0):
+        """
+        Initialize shape.
+
+        Args:
+            fields: Dotted field paths to include (None = whole event). Derived
+                fields 'emotion_id' and 'previous_emotion' are also available.
+            where: Predicates [path, op, value], all of which must hold
+            transitions: Only deliver events whose emotion differs from the
+                previously delivered one
+            min_interval: Minimum seconds (event time) between delivered events
+        """
+        self.fields = [tuple(f.split('.')) for f in fields] if fields else None
+        self.where = [(tuple(path.split('.')), OPERATORS[op], value) for path, op, value in (where or [])]
+        self.transitions = transitions
+        self.min_interval = min_interval
+        self.clients = set()
+
+        self._previous_emotion = None
+        self._last_sent = float('-inf')
+
+    @staticmethod
+    def normalize(spec: Dict) -> Dict:
+        """Canonical form of a subscription spec; equal specs share a shape."""
+        fields = spec.get('fields')
+        if isinstance(fields, str):
+            fields = [f for f in fields.split(',') if f]
+        if fields is not None and not (isinstance(fields, list) and all(isinstance(f, str) for f in fields)):
+            raise ValueError(f"Invalid fields: {fields}")
+        where = spec.get('where') or []
+        if not isinstance(where, (list, tuple)):
+            raise ValueError(f"Invalid where: {where}")
+        for clause in where:
+            if not isinstance(clause, (list, tuple)) or len(clause) != 3 or not isinstance(clause[0], str) \
+                    or clause[1] not in OPERATORS:
+                raise ValueError(f"Invalid predicate: {clause}")
+        return {
+            'fields': sorted(set(fields)) if fields else None,
+            'where': sorted(([p, op, v] for p, op, v in where), key=json.dumps),
+            'transitions': bool(spec.get('transitions', False)),
+            'min_interval': float(spec.get('min_interval', 0.0)),
+        }
+
+    @staticmethod
+    def key(normalized: Dict) -> str:
+        return json.dumps(normalized, sort_keys=True)
+
+    def encode(self, event: Dict, full_payload: str) -> Optional[str]:
+        """
+        Payload for this shape, or None if the event is filtered out.
+
+        Args:
+            event: Emotion event
+            full_payload: json.dumps(event), shared by all full-event shapes
+        """
+        for path, op, value in self.where:
+            actual = _lookup(event, path)
+            if actual is _MISSING or not op(actual, value):
+                return None
+
+        emotion = event.get('emotion')
+        previous = self._previous_emotion
+        if self.transitions and emotion == previous:
+            return None
+
+        timestamp = event.get('timestamp', 0.0)
+        if self.min_interval and timestamp - self._last_sent < self.min_interval:
+            return None
+
+        self._previous_emotion = emotion
+        self._last_sent = timestamp
+
+        if self.fields is None:
+            return full_payload
+
+        derived = {'emotion_id': EMOTION_IDS.get(emotion), 'previous_emotion': previous}
+        projected = {}
+        for path in self.fields:
+            value = derived[path[0]] if len(path) == 1 and path[0] in derived else _lookup(event, path)
+            if value is _MISSING:
+                continue
+            target = projected
+            for key in path[:-1]:
+                target = target.setdefault(key, {})
+            target[path[-1]] = value
+        return json.dumps(projected)
+
+
+def spec_from_path(path: str) -> Optional[Dict]:
+    """Subscription spec from a connect URL's query string, or None."""
+    query = parse_qs(urlparse(path or '').query)
+    if not query:
+        return None
+    spec = {}
+    if 'fields' in query:
+        spec['fields'] = query['fields'][0]
+    if 'transitions' in query:
+        spec['transitions'] = query['transitions'][0] not in ('0', 'false', '')
+    if 'min_interval' in query:
+        spec['min_interval'] = float(query['min_interval'][0])
+    if 'where' in query:
+        spec['where'] = json.loads(query['where'][0])
+    return spec
+
+
+class SubscriptionRegistry:
+    """Maps clients to shared subscription shapes."""
+
+    def __init__(self):
+        self.shapes: Dict[str, SubscriptionShape] = {}
+        self.client_shape: Dict[object, str] = {}
+
+    def subscribe(self, client, spec: Optional[Dict] = None) -> str:
+        """Attach a client to the shape for `spec` (moving it if already subscribed)."""
+        normalized = SubscriptionShape.normalize(spec or {})
+        key = SubscriptionShape.key(normalized)
+
+        self.unsubscribe(client)
+        shape = self.shapes.get(key)
+        if shape is None:
+            shape = self.shapes[key] = SubscriptionShape(**normalized)
+        shape.clients.add(client)
+        self.client_shape[client] = key
+        return key
+
+    def unsubscribe(self, client):
+        key = self.client_shape.pop(client, None)
+        if key is None:
+            return
+        shape = self.shapes[key]
+        shape.clients.discard(client)
+        if not shape.clients:
+            del self.shapes[key]
+
+    def payloads(self, event: Dict) -> List[Tuple[str, list]]:
+        """
+        (payload, clients) for every shape that accepts the event.
+
+        Client lists are snapshots, so callers may await between sends while
+        clients subscribe or disconnect.
+        """
+        full_payload = json.dumps(event)
+        out = []
+        for shape in self.shapes.values():
+            payload = shape.encode(event, full_payload)
+            if payload is not None:
+                out.append((payload, list(shape.clients)))
+        return out
+
+    def __len__(self):
+        return len(self.client_shape)
+
+
+if __name__ == "__main__":
+    import time
+    import random
+
+    analyzer = EmotionAnalyzer()
+    registry = SubscriptionRegistry()
+
+    # 1000 clients over three shapes
+    for i in range(1000):
+        if i % 3 == 0:
+            registry.subscribe(f"timeline-{i}", {'fields': 'emotion_id,timestamp'})
+        elif i % 3 == 1:
+            registry.subscribe(f"llm-{i}", {'fields': ['emotion', 'previous_emotion', 'timestamp'],
+                                            'transitions': True})
+        else:
+            registry.subscribe(f"dashboard-{i}")
+
+    start = time.perf_counter()
+    sent = 0
+    for n in range(2000):
+        metrics = {m: random.random() for m in ('engagement', 'excitement', 'stress', 'relaxation', 'interest')}
+        event = analyzer.analyze_emotion(metrics, n * 0.5)
+        for payload, clients in registry.payloads(event):
+            sent += len(clients)
+    elapsed = time.perf_counter() - start
+    print(f"{len(registry)} clients in {len(registry.shapes)} shapes: 2000 events, {sent} deliveries, "
+          f"{elapsed * 1000 / 2000:.3f} ms/event")
+    for payload, clients in registry.payloads(analyzer.analyze_emotion({'stress': 0.9}, 1e6)):
+        print(f"  {len(clients)} clients <- {payload[:100]}")
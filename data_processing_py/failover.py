@@ -0,0 +1,525 @@
+#!/usr/bin/env python3
+"""
+Hot-Standby Failover for the Emotion Server
+
+A standby process mirrors the primary emotion server (live_emotion.py) so a
+crash costs about a second of events instead of the session:
+
+- The primary hands its listening socket to the standby (SCM_RIGHTS over a
+  Unix socket). While no process is accepting, the kernel keeps queueing
+  connection attempts on it; once promoted the standby accepts on the same
+  socket, so reconnecting clients are never refused.
+- State is replicated as JSON-line deltas as it changes: analyzer history
+  and current metrics, the user baseline, per-client subscriptions
+  (clients that connect with ?client=<id>) and conversation segments. A
+  standby that (re)connects first receives a snapshot.
+- The standby authorizes with Cortex and finds the headset while waiting;
+  only createSession is held back until promotion.
+- Failure is detected by EOF on the replication socket (the primary died)
+  or by missed heartbeats (it hung, in which case the standby kills it
+  before taking over). Either way one reconnect probe must also fail
+  first, so a primary that dropped us or stalled briefly is resynced
+  rather than replaced. A hung primary is detected after twice
+  --heartbeat-timeout (about 1 s at the 0.5 s default); a primary stalled
+  longer than that is taken for hung and killed, so raise the timeout
+  where long pauses are more likely than real hangs. The failover report (detection, takeover and the gap
+  between the primary's last event and the standby's first) is printed and
+  returned in {"type": "history"} replies. The promoted standby then
+  serves replication for the next standby.
+
+    python failover.py primary [--simulate]    # ws://localhost:8765
+    python failover.py standby [--simulate]
+    python failover.py demo                    # kills a simulated primary, reports the gap
+"""
+
+import os
+import json
+import time
+import queue
+import signal
+import socket
+import argparse
+import threading
+from collections import deque
+from typing import Dict, Optional
+
+REPLICATION_PATH = '/tmp/therapist-emotion-replication.sock'
+HEARTBEAT_INTERVAL = 0.1
+HEARTBEAT_TIMEOUT = 0.5
+SIMULATED_SECONDS = 24 * 3600
+# Deltas queued for a standby before it is dropped (it reconnects and resyncs)
+MAX_BACKLOG = 10000
+
+
+class SessionState:
+    """
+    The part of an emotion server's state a standby needs to continue the
+    session. The primary applies every delta to its own copy too, so a
+    snapshot for a new standby is always at hand.
+    """
+
+    def __init__(self, history: int = 50, segments: int = 200):
+        # Same bound as EmotionAnalyzer.emotion_history
+        self.emotions = deque(maxlen=history)
+        self.metrics: Dict[str, float] = {}
+        self.baseline: Optional[Dict] = None
+        self.clients: Dict[str, Dict] = {}
+        self.segments = deque(maxlen=segments)
+        self.seq = 0
+        # Wall time of the latest emotion event
+        self.last_event_at: Optional[float] = None
+
+    def apply(self, delta: Dict):
+        kind = delta['kind']
+        if kind == 'emotion':
+            self.emotions.append(delta['event'])
+            self.metrics = delta['metrics']
+            self.last_event_at = delta['t']
+        elif kind == 'baseline':
+            self.baseline = {'user_id': delta['user_id'], 'data': delta['data']}
+        elif kind == 'client':
+            self.clients[delta['client']] = delta['state']
+        elif kind == 'segment':
+            self.segments.append(delta['segment'])
+        self.seq = delta.get('seq', self.seq + 1)
+
+    def snapshot(self) -> Dict:
+        return {
+            'kind': 'snapshot',
+            'seq': self.seq,
+            'emotions': list(self.emotions),
+            'metrics': self.metrics,
+            'baseline': self.baseline,
+            'clients': self.clients,
+            'segments': list(self.segments),
+            'last_event_at': self.last_event_at,
+        }
+
+    def load(self, snapshot: Dict):
+        self.emotions.clear()
+        self.emotions.extend(snapshot['emotions'])
+        self.metrics = snapshot['metrics']
+        self.baseline = snapshot['baseline']
+        self.clients = dict(snapshot['clients'])
+        self.segments.clear()
+        self.segments.extend(snapshot['segments'])
+        self.seq = snapshot['seq']
+        self.last_event_at = snapshot['last_event_at']
+
+    def restore(self, server):
+        """Install the replicated state into an EmotionWebSocketServer and its streamer."""
+        import base64
+        from user_baseline import UserBaseline
+
+        streamer = server.streamer
+        analyzer = streamer.analyzer
+        with analyzer._lock:
+            analyzer.emotion_history = list(self.emotions)
+            analyzer.previous_emotion = self.emotions[-1]['emotion'] if self.emotions else None
+        streamer.current_metrics.update(self.metrics)
+        streamer.last_update_time = time.time()
+        # The replica is newer than anything the standby loaded at startup
+        if self.baseline is not None:
+            baseline = UserBaseline.from_bytes(self.baseline['user_id'], base64.b64decode(self.baseline['data']))
+            streamer.baseline = baseline
+            analyzer.baseline = baseline
+        server.client_state = {client: dict(state) for client, state in self.clients.items()}
+        server.segments.extend(self.segments)
+
+
+class _StandbyLink:
+    """Outgoing delta queue and writer thread for one connected standby."""
+
+    def __init__(self, conn: socket.socket, on_close):
+        self.conn = conn
+        self.queue = queue.Queue(maxsize=MAX_BACKLOG)
+        self.on_close = on_close
+        self.closed = False
+        threading.Thread(target=self._run, name="ReplicationWriter", daemon=True).start()
+
+    def put(self, line: bytes):
+        try:
+            self.queue.put_nowait(line)
+        except queue.Full:
+            print("Replication: standby fell behind, dropping it (it will resync)")
+            self.close()
+
+    def _run(self):
+        while not self.closed:
+            line = self.queue.get()
+            if line is None:
+                break
+            try:
+                self.conn.sendall(line)
+            except OSError:
+                break
+        self.close()
+
+    def close(self):
+        if self.closed:
+            return
+        self.closed = True
+        with self.queue.mutex:
+            self.queue.queue.clear()
+        self.queue.put_nowait(None)
+        try:
+            self.conn.close()
+        except OSError:
+            pass
+        self.on_close(self)
+
+
+class ReplicationPrimary:
+    """
+    Replicates session state to standbys and shares the listening socket
+    with them. replicate() only queues; it never blocks the caller.
+    """
+
+    def __init__(self, listen_socket: socket.socket, path: str = REPLICATION_PATH,
+                 state: Optional[SessionState] = None):
+        """
+        Initialize replication.
+
+        Args:
+            listen_socket: The server's listening socket, passed to standbys
+            path: Unix socket standbys connect to
+            state: State to continue from (a promoted standby's)
+        """
+        self.listen_socket = listen_socket
+        self.path = path
+        self.state = state or SessionState()
+        # Reentrant: dropping a lagging standby from put() removes it under the lock
+        self._lock = threading.RLock()
+        self._links = []
+
+        if os.path.exists(path):
+            os.unlink(path)  # left over from a dead primary
+        self._server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._server.bind(path)
+        self._server.listen(4)
+        threading.Thread(target=self._accept_loop, name="ReplicationAccept", daemon=True).start()
+        threading.Thread(target=self._heartbeat_loop, name="ReplicationHeartbeat", daemon=True).start()
+
+    def replicate(self, kind: str, **data):
+        """Apply a delta locally and queue it for every standby."""
+        with self._lock:
+            delta = {'kind': kind, 'seq': self.state.seq + 1, 't': time.time(), **data}
+            self.state.apply(delta)
+            line = (json.dumps(delta) + '\n').encode('utf-8')
+            for link in list(self._links):
+                link.put(line)
+
+    def _accept_loop(self):
+        while True:
+            try:
+                conn, _ = self._server.accept()
+            except OSError:
+                return
+            hello = json.dumps({'kind': 'hello', 'pid': os.getpid()}) + '\n'
+            try:
+                socket.send_fds(conn, [hello.encode('utf-8')], [self.listen_socket.fileno()])
+            except OSError:
+                conn.close()
+                continue
+            # Snapshot and registration under one lock, so no delta is missed or doubled
+            with self._lock:
+                link = _StandbyLink(conn, self._remove)
+                link.put((json.dumps(self.state.snapshot()) + '\n').encode('utf-8'))
+                self._links.append(link)
+            print(f"Replication: standby connected ({len(self._links)} total)")
+
+    def _remove(self, link: _StandbyLink):
+        with self._lock:
+            if link in self._links:
+                self._links.remove(link)
+
+    def _heartbeat_loop(self):
+        while True:
+            time.sleep(HEARTBEAT_INTERVAL)
+            with self._lock:
+                line = (json.dumps({'kind': 'heartbeat', 't': time.time(), 'seq': self.state.seq}) + '\n').encode('utf-8')
+                for link in list(self._links):
+                    link.put(line)
+
+    def close(self):
+        self._server.close()
+        with self._lock:
+            links = list(self._links)
+        for link in links:
+            link.close()
+
+
+class ReplicationStandby:
+    """Mirrors a primary's state until it fails."""
+
+    def __init__(self, path: str = REPLICATION_PATH, heartbeat_timeout: float = HEARTBEAT_TIMEOUT):
+        self.path = path
+        self.heartbeat_timeout = heartbeat_timeout
+        self.state = SessionState()
+        self.listen_socket: Optional[socket.socket] = None
+        self.primary_pid: Optional[int] = None
+
+    def _connect(self, timeout: float) -> Optional[socket.socket]:
+        """Connect and read the hello (with the listening socket), or None if no primary answers."""
+        conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        conn.settimeout(timeout)
+        try:
+            conn.connect(self.path)
+            message, fds, _, _ = socket.recv_fds(conn, 65536, 1)
+        except OSError:
+            conn.close()
+            return None
+        if not message or not fds:
+            conn.close()
+            return None
+        if self.listen_socket is None:
+            self.listen_socket = socket.socket(fileno=fds[0])
+        else:
+            os.close(fds[0])  # same listening socket as before
+        line, _, self._buffer = message.partition(b'\n')
+        self.primary_pid = json.loads(line)['pid']
+        return conn
+
+    def wait_for_failure(self) -> Dict:
+        """
+        Mirror the primary, reconnecting when it drops us while still alive.
+
+        Returns:
+            Failover report; the caller promotes this process
+        """
+        conn = None
+        while conn is None:
+            conn = self._connect(self.heartbeat_timeout)
+            if conn is None:
+                time.sleep(0.2)  # no primary yet
+        print(f"Standby: mirroring primary (pid {self.primary_pid})")
+
+        conn.settimeout(HEARTBEAT_INTERVAL / 2)
+        last_message = time.monotonic()
+        while True:
+            reason = None
+            try:
+                data = conn.recv(65536)
+                if not data:
+                    reason = 'eof'
+            except socket.timeout:
+                data = b''
+                if time.monotonic() - last_message > self.heartbeat_timeout:
+                    reason = 'heartbeat'
+            except OSError:
+                reason = 'eof'
+
+            if reason is not None:
+                conn.close()
+                # Confirm with one reconnect before taking over: a live primary that
+                # dropped us (e.g. we fell behind) or merely stalled past the timeout
+                # (GC, a long numpy call) answers it; a dead or hung one doesn't
+                conn = self._connect(self.heartbeat_timeout)
+                if conn is None:
+                    return self._report(reason, last_message, time.monotonic())
+                print("Standby: primary still alive, resyncing")
+                conn.settimeout(HEARTBEAT_INTERVAL / 2)
+                last_message = time.monotonic()
+                continue
+
+            if data:
+                last_message = time.monotonic()
+                self._buffer += data
+            while b'\n' in self._buffer:
+                line, _, self._buffer = self._buffer.partition(b'\n')
+                message = json.loads(line)
+                if message['kind'] == 'snapshot':
+                    self.state.load(message)
+                elif message['kind'] != 'heartbeat':
+                    self.state.apply(message)
+
+    def _report(self, reason: str, last_message: float, detected: float) -> Dict:
+        if reason == 'heartbeat' and self.primary_pid:
+            # Hung, not dead: make sure it can't come back and serve next to us
+            try:
+                os.kill(self.primary_pid, signal.SIGKILL)
+            except OSError:
+                pass
+        return {
+            'detected_by': reason,
+            'detect_ms': round((detected - last_message) * 1000),
+            'detected_at': time.time(),
+            'last_primary_event_at': self.state.last_event_at or time.time(),
+            'replicated_seq': self.state.seq,
+            'emotions': len(self.state.emotions),
+            'clients': len(self.state.clients),
+            'segments': len(self.state.segments),
+        }
+
+
+def _simulate(streamer, gate: Optional[threading.Event] = None):
+    """Feed a streamer one synthetic user's met stream in real time, for running without Cortex."""
+    from synthetic_sessions import SyntheticSessionGenerator
+
+    generator = SyntheticSessionGenerator(users=1, streams=('met',))
+    streamer.bind_source(generator.headsets[0])
+
+    def run():
+        if gate is not None:
+            gate.wait()
+        generator.run(SIMULATED_SECONDS, realtime=True)
+
+    threading.Thread(target=run, name="SyntheticHeadset", daemon=True).start()
+
+
+def _credentials():
+    import dotenv
+    app_client_id = dotenv.get_key(dotenv_path='.env', key_to_get='EMOTIV_APP_CLIENT_ID')
+    app_client_secret = dotenv.get_key(dotenv_path='.env', key_to_get='EMOTIV_APP_CLIENT_SECRET')
+    if not app_client_id or not app_client_secret:
+        raise SystemExit("Please set EMOTIV_APP_CLIENT_ID and EMOTIV_APP_CLIENT_SECRET in .env file")
+    return app_client_id, app_client_secret
+
+
+def _baseline_kwargs(args) -> Dict:
+    """Baseline store and user for LiveEmotionStreamer, if --user was given."""
+    if not args.user:
+        return {}
+    from user_baseline import BaselineStore
+    return {'baseline_store': BaselineStore(args.baselines), 'user_id': args.user}
+
+
+def run_primary(args):
+    """Serve as the primary: own listening socket, replicate everything."""
+    from live_emotion import EmotionWebSocketServer, LiveEmotionStreamer
+    from profiler import start_profiler_server
+
+    listen_socket = socket.create_server(('localhost', args.port))
+    replicator = ReplicationPrimary(listen_socket, args.path)
+    server = EmotionWebSocketServer(args.port, raw_eeg=args.raw_eeg, replicator=replicator)
+    if args.simulate:
+        server.attach_streamer(LiveEmotionStreamer('simulated', 'simulated', replicator=replicator,
+                                                   **_baseline_kwargs(args)))
+        _simulate(server.streamer)
+    else:
+        server.attach_streamer(LiveEmotionStreamer(*_credentials(), replicator=replicator, **_baseline_kwargs(args)))
+        server.start_streaming()
+        start_profiler_server()
+    print(f"Primary: replicating to standbys on {args.path}")
+    server.serve(listen_socket)
+
+
+def run_standby(args):
+    """Stay warm until the primary fails, then take over its socket and session."""
+    from live_emotion import EmotionWebSocketServer, LiveEmotionStreamer
+    from profiler import start_profiler_server
+
+    server = EmotionWebSocketServer(args.port, raw_eeg=args.raw_eeg)
+    gate = threading.Event()
+    if args.simulate:
+        server.attach_streamer(LiveEmotionStreamer('simulated', 'simulated', **_baseline_kwargs(args)))
+        _simulate(server.streamer, gate)
+    else:
+        server.attach_streamer(LiveEmotionStreamer(*_credentials(), **_baseline_kwargs(args)))
+        # Authorize and find the headset now; the session is created on promotion
+        server.start_streaming(session_gate=gate)
+
+    standby = ReplicationStandby(args.path, heartbeat_timeout=args.heartbeat_timeout)
+    report = standby.wait_for_failure()
+    standby.state.restore(server)
+
+    # The next standby replicates from us
+    replicator = ReplicationPrimary(standby.listen_socket, args.path, state=standby.state)
+    server.replicator = replicator
+    server.streamer.replicator = replicator
+    server.failover_report = report
+    gate.set()
+    report['takeover_ms'] = round((time.time() - report['detected_at']) * 1000)
+    print(f"Standby: primary failed ({report['detected_by']}), taking over ws://localhost:{args.port}")
+    if not args.simulate:
+        start_profiler_server()
+    server.serve(standby.listen_socket)
+
+
+def run_demo(args):
+    """Kill a simulated primary under a connected client and measure the gap it sees."""
+    import asyncio
+    import subprocess
+    import sys
+    import websockets
+
+    path = args.path + '.demo'
+    command = [sys.executable, os.path.abspath(__file__)]
+    common = ['--simulate', '--port', str(args.port), '--path', path, '--heartbeat-timeout', str(args.heartbeat_timeout)]
+    quiet = {'stdout': subprocess.DEVNULL, 'stderr': subprocess.DEVNULL}
+    primary = subprocess.Popen(command + ['primary'] + common, **quiet)
+    time.sleep(1.0)
+    standby = subprocess.Popen(command + ['standby'] + common, **quiet)
+    url = f"ws://localhost:{args.port}/?client=demo"
+
+    async def client():
+        arrivals = []
+        kill_at = None
+
+        async def receive(websocket, until):
+            while time.time() < until:
+                try:
+                    message = json.loads(await asyncio.wait_for(websocket.recv(), until - time.time()))
+                except asyncio.TimeoutError:
+                    return
+                if 'emotion' in message:
+                    arrivals.append(time.time())
+
+        async with websockets.connect(url) as websocket:
+            await websocket.send(json.dumps({'type': 'subscribe', 'fields': ['emotion', 'timestamp']}))
+            await websocket.send(json.dumps({'type': 'segment', 'role': 'user', 'text': "I couldn't sleep again."}))
+            await receive(websocket, time.time() + 4.0)
+            before = len(arrivals)
+            kill_at = time.time()
+            primary.send_signal(signal.SIGKILL)
+            try:
+                await receive(websocket, time.time() + 1.0)
+            except websockets.ConnectionClosed:
+                pass
+
+        # Reconnect the way the mux gateway does; the standby restores our subscription
+        reconnect_started = time.time()
+        async with websockets.connect(url) as websocket:
+            connected = time.time()
+            await receive(websocket, time.time() + 3.0)
+            await websocket.send(json.dumps({'type': 'history'}))
+            history = json.loads(await websocket.recv())
+            while history.get('type') != 'history':
+                history = json.loads(await websocket.recv())
+
+        after = [t for t in arrivals[before:] if t > kill_at]
+        return {
+            'events_before_kill': before,
+            'reconnect_ms': round((connected - reconnect_started) * 1000),
+            'client_gap_ms': round((after[0] - arrivals[before - 1]) * 1000) if after and before else None,
+            'history_restored': len(history['emotions']),
+            'segments_restored': len(history['segments']),
+            'failover': history['failover'],
+        }
+
+    print("=== Failover Demo (simulated headset) ===")
+    try:
+        result = asyncio.run(client())
+        print(json.dumps(result, indent=2))
+    finally:
+        for process in (primary, standby):
+            process.kill()
+            process.wait()
+        if os.path.exists(path):
+            os.unlink(path)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Hot-standby failover for the emotion server")
+    parser.add_argument("role", choices=["primary", "standby", "demo"])
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--path", default=REPLICATION_PATH, help="Unix socket for replication")
+    parser.add_argument("--raw-eeg", action="store_true")
+    parser.add_argument("--heartbeat-timeout", type=float, default=HEARTBEAT_TIMEOUT,
+                        help="Seconds without heartbeats before the standby probes the primary")
+    parser.add_argument("--simulate", action="store_true", help="Generate met data instead of using Cortex")
+    parser.add_argument("--user", help="Normalize against (and keep learning) this user's baseline")
+    parser.add_argument("--baselines", default="baselines", help="Baseline store directory")
+    args = parser.parse_args()
+
+    {'primary': run_primary, 'standby': run_standby, 'demo': run_demo}[args.role](args)
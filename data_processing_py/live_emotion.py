@@ -1,9 +1,53 @@
 import json
+import base64
+import struct
 import time
 import threading
+from collections import deque
 from typing import Dict, Optional, Callable
+from urllib.parse import parse_qs, urlparse
 from emotion_analyzer import EmotionAnalyzer, EmotionStreamProcessor
 from sub_data import Subcribe
+from profiler import start_profiler_server
+from emotion_subscriptions import SubscriptionRegistry, SubscriptionShape, spec_from_path
+from clock_sync import clock_sync
+from stream_manager import StreamManager
+
+# Raw EEG for the frontend viewer: the five sensor columns of a Cortex 'eeg'
+# sample (after COUNTER and INTERPOLATED), in microvolts at 128 Hz
+EEG_CHANNELS = ['AF3', 'T7', 'Pz', 'T8', 'AF4']
+EEG_SAMPLE_RATE = 128.0
+# Samples per binary block (125 ms): small enough for a smooth trace, large
+# enough that per-message overhead stays negligible
+EEG_BLOCK_FRAMES = 16
+EEG_BLOCK_VERSION = 1
+EEG_BLOCK_HEADER = struct.Struct('<BBHdf')
+
+# Emotion events between baseline copies sent to a standby (~10 s at 2 Hz)
+BASELINE_REPLICATE_EVERY = 20
+
+
+def pack_eeg_block(start_time: float, frames: list, sample_rate: float = EEG_SAMPLE_RATE) -> bytes:
+    """
+    Pack EEG frames into a binary block for WebSocket clients.
+    
+    Layout (little-endian): u8 version, u8 channels, u16 frames, f64 time of
+    the first frame (backend clock), f32 sample rate, then float32 values
+    frame by frame.
+    
+    Args:
+        start_time: Time of the first frame
+        frames: Equal-length lists of channel values
+        sample_rate: Frames per second
+        
+    Returns:
+        Encoded block
+    """
+    channels = len(frames[0]) if frames else 0
+    values = [value for frame in frames for value in frame]
+    return (EEG_BLOCK_HEADER.pack(EEG_BLOCK_VERSION, channels, len(frames), start_time, sample_rate)
+            + struct.pack(f'<{len(values)}f', *values))
+
 
 class LiveEmotionStreamer:
     """
@@ -13,21 +57,48 @@ class LiveEmotionStreamer:
     emotion analysis as JSON events.
     """
     
-    def __init__(self, app_client_id: str, app_client_secret: str):
+    def __init__(self, app_client_id: str, app_client_secret: str,
+                 rollup_store=None, session_id: Optional[str] = None, publisher=None,
+                 baseline_store=None, user_id: Optional[str] = None, replicator=None):
         """
         Initialize live emotion streaming.
         
         Args:
             app_client_id: Emotiv app client ID
             app_client_secret: Emotiv app client secret
+            rollup_store: Optional EmotionRollupStore to aggregate events into
+            session_id: Session key for stored events (defaults to start time)
+            publisher: Optional BrokerPublisher; raw met data and emotion events
+                are published per session for workers on other nodes
+            baseline_store: Optional BaselineStore; with user_id, metrics are
+                normalized against the user's persisted baseline, which keeps
+                learning during the session and is saved on stop
+            user_id: User whose baseline to load
+            replicator: Optional failover.ReplicationPrimary; emotion events,
+                current metrics and the baseline are replicated to a standby
         """
         self.app_client_id = app_client_id
         self.app_client_secret = app_client_secret
+        self.rollup_store = rollup_store
+        self.publisher = publisher
+        self.replicator = replicator
+        self._replicated_events = 0
+        self.session_id = session_id or time.strftime('%Y%m%dT%H%M%S')
         
-        self.analyzer = EmotionAnalyzer()
+        self.baseline_store = baseline_store
+        self.baseline = baseline_store.load(user_id) if baseline_store is not None and user_id else None
+        self.analyzer = EmotionAnalyzer(baseline=self.baseline)
         self.subscriber = None
+        # Cortex streams are subscribed only while something consumes them
+        self.stream_manager = StreamManager()
         self.is_streaming = False
         self.output_callback = None
+        self.eeg_callback = None
+        self._eeg_frames = []
+        self._eeg_start = 0.0
+        self._eeg_last = 0.0
+        # Latest band power as z-scores against the user's baseline
+        self.band_z = None
         
         # Performance metrics state
         self.current_metrics = {
@@ -45,12 +116,27 @@ class LiveEmotionStreamer:
         """Set callback for streaming output."""
         self.output_callback = callback
         
-    def start_streaming(self, streams: list = None) -> bool:
+    def set_eeg_callback(self, callback: Callable[[bytes], None]):
+        """Set callback for packed raw EEG blocks (while the 'eeg' stream is acquired)."""
+        self.eeg_callback = callback
+    
+    def acquire_stream(self, stream: str):
+        """Subscribe a Cortex stream for an extra consumer (e.g. 'eeg' for a viewer)."""
+        self.stream_manager.acquire(stream)
+    
+    def release_stream(self, stream: str):
+        """Drop a consumer; the stream is unsubscribed after a grace period."""
+        self.stream_manager.release(stream)
+        
+    def start_streaming(self, streams: list = None, session_gate: Optional[threading.Event] = None) -> bool:
         """
         Start real-time emotion streaming.
         
         Args:
-            streams: List of data streams to subscribe to
+            streams: Data streams to keep subscribed for the whole session;
+                others are subscribed while acquire_stream() holds them
+            session_gate: If given, connect and authorize now but create the
+                Cortex session only once the event is set (warm standby)
             
         Returns:
             True if successful
@@ -61,6 +147,13 @@ class LiveEmotionStreamer:
         try:
             # Initialize subscriber
             self.subscriber = Subcribe(self.app_client_id, self.app_client_secret)
+            self.stream_manager.attach(self.subscriber)
+            for stream in streams:
+                self.stream_manager.acquire(stream)
+            # Band power keeps the band half of the baseline learning and
+            # feeds band_z; it is only worth subscribing for a known user
+            if self.baseline is not None and 'pow' not in streams:
+                self.stream_manager.acquire('pow')
             
             # Override callback methods to process our data
             original_on_new_met_data = self.subscriber.on_new_met_data
@@ -71,18 +164,41 @@ class LiveEmotionStreamer:
             
             self.subscriber.on_new_met_data = custom_on_new_met_data
             
+            if self.baseline is not None:
+                original_on_new_pow_data = self.subscriber.on_new_pow_data
+                
+                def custom_on_new_pow_data(*args, **kwargs):
+                    self._handle_pow_data(*args, **kwargs)
+                    original_on_new_pow_data(*args, **kwargs)
+                
+                self.subscriber.on_new_pow_data = custom_on_new_pow_data
+            
+            # Replaces the default handler, which prints all 128 samples a second
+            self.subscriber.on_new_eeg_data = self._handle_eeg_data
+            
+            if session_gate is not None:
+                create_session = self.subscriber.c.create_session
+                
+                def create_session_when_open():
+                    # Called from the Cortex thread once the headset is found; don't block it
+                    threading.Thread(target=lambda: (session_gate.wait(), create_session()),
+                                     name="CortexSessionGate", daemon=True).start()
+                
+                self.subscriber.c.create_session = create_session_when_open
+            
             # Start streaming
             self.is_streaming = True
             
             # Create and start streaming thread
             streaming_thread = threading.Thread(
                 target=self._streaming_loop,
+                name="EmotionStaleWatch",
                 daemon=True
             )
             streaming_thread.start()
             
-            # Start Emotiv subscription
-            self.subscriber.start(streams)
+            # Start Emotiv subscription; the stream manager subscribes once the session exists
+            self.subscriber.start([])
             
             return True
             
@@ -93,9 +209,59 @@ class LiveEmotionStreamer:
     def stop_streaming(self):
         """Stop emotion streaming."""
         self.is_streaming = False
+        self.stream_manager.close()
         if self.subscriber:
             # Note: Need to add close method to Subcribe class
             pass
+        if self.rollup_store is not None:
+            self.rollup_store.close()
+        # A baseline taken over from a failed primary has no store to save to
+        if self.baseline is not None and self.baseline_store is not None:
+            self.baseline_store.save(self.baseline)
+    
+    def bind_source(self, source):
+        """
+        Take data from a Cortex-style event source instead of a Cortex session.
+        
+        Args:
+            source: Dispatcher emitting new_met_data (and new_pow_data), e.g. a
+                synthetic_sessions.SyntheticHeadset
+        """
+        source.bind(new_met_data=self._handle_met_data)
+        if self.baseline is not None:
+            source.bind(new_pow_data=self._handle_pow_data)
+    
+    def _handle_pow_data(self, *args, **kwargs):
+        """Fold band power into the user's baseline and keep its z-scores."""
+        data = kwargs.get('data')
+        if data and len(data.get('pow', [])) == 25:
+            self.baseline.update_bands(data['pow'])
+            self.band_z = self.baseline.normalize_bands(data['pow'])
+    
+    def _handle_eeg_data(self, *args, **kwargs):
+        """Batch raw EEG samples into blocks for the viewer."""
+        data = kwargs.get('data')
+        if self.eeg_callback is None or not data or 'eeg' not in data:
+            return
+        
+        values = data['eeg']
+        if len(values) < 2 + len(EEG_CHANNELS):
+            return
+        sample_time = data.get('time', time.time())
+        # A gap (e.g. the stream was unsubscribed) starts a new block
+        if self._eeg_frames and sample_time - self._eeg_last > 0.1:
+            self._eeg_frames = []
+        self._eeg_last = sample_time
+        if not self._eeg_frames:
+            # Met samples keep the Cortex clock offset current; don't let 128 Hz
+            # EEG samples crowd them out of the estimator's window
+            self._eeg_start = clock_sync.to_local('cortex', sample_time)
+        self._eeg_frames.append(values[2:2 + len(EEG_CHANNELS)])
+        
+        if len(self._eeg_frames) >= EEG_BLOCK_FRAMES:
+            block = pack_eeg_block(self._eeg_start, self._eeg_frames)
+            self._eeg_frames = []
+            self.eeg_callback(block)
     
     def _handle_met_data(self, *args, **kwargs):
         """Handle incoming met data from Emotiv."""
@@ -107,10 +273,15 @@ class LiveEmotionStreamer:
             # Extract metrics from met data
             met_values = data['met']
             timestamp = data.get('time', time.time())
+            if 'time' in data:
+                clock_sync.observe_one_way('cortex', timestamp)
             
             # Map met indices to metrics (based on Emotiv format)
             # met: ['eng.isActive', 'eng', 'exc.isActive', 'exc', 'lex', 'str.isActive', 'str', 'rel.isActive', 'rel', 'int.isActive', 'int', 'foc.isActive', 'foc']
             if len(met_values) >= 13:
+                if self.publisher is not None:
+                    self.publisher.publish('met', self.session_id, {'met': met_values, 'time': timestamp})
+                
                 self.current_metrics = {
                     'engagement': float(met_values[1]) if met_values[0] else 0.0,
                     'excitement': float(met_values[3]) if met_values[2] else 0.0,
@@ -122,9 +293,32 @@ class LiveEmotionStreamer:
                 
                 self.last_update_time = time.time()
                 
+                # Learn the baseline from active metrics only (inactive ones read as 0)
+                if self.baseline is not None:
+                    active = (met_values[0], met_values[2], met_values[5],
+                              met_values[7], met_values[9], met_values[11])
+                    self.baseline.update_metrics({
+                        name: value for (name, value), is_active
+                        in zip(self.current_metrics.items(), active) if is_active
+                    })
+                
                 # Analyze emotion
                 emotion_event = self.analyzer.analyze_emotion(self.current_metrics, timestamp)
                 
+                # Headset sample time on the backend clock, comparable across devices
+                emotion_event['synced_timestamp'] = round(clock_sync.to_local('cortex', timestamp), 4)
+                if self.band_z is not None:
+                    emotion_event['band_z'] = self.band_z
+                
+                if self.rollup_store is not None:
+                    self.rollup_store.write(emotion_event, self.session_id)
+                
+                if self.publisher is not None:
+                    self.publisher.publish('emotion', self.session_id, emotion_event)
+                
+                if self.replicator is not None:
+                    self._replicate(emotion_event)
+                
                 # Output event
                 if self.output_callback:
                     self.output_callback(emotion_event)
@@ -134,6 +328,15 @@ class LiveEmotionStreamer:
         except (IndexError, ValueError) as e:
             print(f"Error processing met data: {e}")
     
+    def _replicate(self, emotion_event: Dict):
+        """Send the state a standby needs to continue this session."""
+        self.replicator.replicate('emotion', event=emotion_event, metrics=self.current_metrics)
+        self._replicated_events += 1
+        # The baseline moves slowly; a copy every ~10 s of met data is plenty
+        if self.baseline is not None and self._replicated_events % BASELINE_REPLICATE_EVERY == 0:
+            self.replicator.replicate('baseline', user_id=self.baseline.user_id,
+                                      data=base64.b64encode(self.baseline.to_bytes()).decode('ascii'))
+    
     def _streaming_loop(self):
         """Background thread for streaming management."""
         while self.is_streaming:
@@ -170,80 +373,238 @@ class EmotionWebSocketServer:
     WebSocket server for streaming emotion events to clients.
     """
     
-    def __init__(self, port: int = 8765):
+    def __init__(self, port: int = 8765, raw_eeg: bool = False, replicator=None,
+                 baseline_store=None, user_id: Optional[str] = None):
         self.port = port
+        # Passed to the streamer: normalize against this user's baseline
+        self.baseline_store = baseline_store
+        self.user_id = user_id
+        self.raw_eeg = raw_eeg
+        self.replicator = replicator
         self.streamer = None
+        self.loop = None
         self.clients = set()
+        # Clients that asked for raw EEG blocks ({"type": "eeg", "enabled": true})
+        self.eeg_clients = set()
+        # Clients grouped by subscription shape (fields + filters)
+        self.subscriptions = SubscriptionRegistry()
+        # Subscription and EEG state of clients that connect with ?client=<id>,
+        # restored when they reconnect (also after a failover)
+        self.client_state: Dict[str, Dict] = {}
+        # Conversation segments posted by the gateway ({"type": "segment"})
+        self.segments = deque(maxlen=200)
+        # Set by failover.py after taking over from a failed primary
+        self.failover_report = None
         
-    async def register_client(self, websocket):
-        """Register a new WebSocket client."""
+    def _remember_client(self, client_id: Optional[str], **changes):
+        """Record a named client's subscription state and replicate it."""
+        if client_id is None:
+            return
+        state = self.client_state.setdefault(client_id, {'spec': None, 'eeg': False})
+        state.update(changes)
+        if self.replicator is not None:
+            self.replicator.replicate('client', client=client_id, state=state)
+    
+    def _add_segment(self, message: Dict):
+        """Store a conversation segment with the emotion current at the time."""
+        history = self.streamer.analyzer.emotion_history if self.streamer is not None else []
+        segment = {
+            'role': str(message.get('role', 'user')),
+            'text': str(message.get('text', '')),
+            'timestamp': float(message.get('timestamp', time.time())),
+            'emotion': history[-1]['emotion'] if history else None,
+        }
+        self.segments.append(segment)
+        if self.replicator is not None:
+            self.replicator.replicate('segment', segment=segment)
+    
+    def history(self, limit: int = 20) -> Dict:
+        """Recent session state, as sent for {"type": "history"}."""
+        history = list(self.streamer.analyzer.emotion_history) if self.streamer is not None else []
+        return {
+            'type': 'history',
+            'emotions': history[-limit:],
+            'trend': self.streamer.analyzer.get_emotion_trend() if self.streamer is not None else None,
+            'segments': list(self.segments)[-limit:],
+            'failover': self.failover_report,
+        }
+    
+    async def register_client(self, websocket, spec: Optional[Dict] = None):
+        """Register a new WebSocket client with an optional subscription spec."""
         self.clients.add(websocket)
-        print(f"Client connected. Total clients: {len(self.clients)}")
+        self.subscriptions.subscribe(websocket, spec)
+        print(f"Client connected. Total clients: {len(self.clients)} "
+              f"({len(self.subscriptions.shapes)} subscription shapes)")
         
     async def unregister_client(self, websocket):
         """Unregister a WebSocket client."""
         self.clients.discard(websocket)
+        self._set_eeg(websocket, False)
+        self.subscriptions.unsubscribe(websocket)
         print(f"Client disconnected. Total clients: {len(self.clients)}")
         
     async def broadcast_emotion(self, event):
-        """Broadcast emotion event to all connected clients."""
+        """Send each subscription shape its projected payload, encoded once per shape."""
         if self.clients:
-            message = json.dumps(event)
             disconnected = set()
             
-            for client in self.clients:
-                try:
-                    await client.send(message)
-                except Exception as e:
-                    disconnected.add(client)
+            for message, clients in self.subscriptions.payloads(event):
+                for client in clients:
+                    try:
+                        await client.send(message)
+                    except Exception as e:
+                        disconnected.add(client)
             
             # Remove disconnected clients
             for client in disconnected:
-                self.clients.discard(client)
+                await self.unregister_client(client)
+    
+    def _set_eeg(self, websocket, enabled: bool):
+        """Add or remove a raw EEG client; each one holds the Cortex 'eeg' stream."""
+        if enabled == (websocket in self.eeg_clients):
+            return
+        if enabled:
+            self.eeg_clients.add(websocket)
+        else:
+            self.eeg_clients.discard(websocket)
+        if self.streamer is not None:
+            if enabled:
+                self.streamer.acquire_stream('eeg')
+            else:
+                self.streamer.release_stream('eeg')
+    
+    async def broadcast_eeg(self, block: bytes):
+        """Send a raw EEG block to clients that enabled it."""
+        disconnected = set()
+        for client in list(self.eeg_clients):
+            try:
+                await client.send(block)
+            except Exception:
+                disconnected.add(client)
+        
+        for client in disconnected:
+            await self.unregister_client(client)
     
     async def handle_client(self, websocket):
-        """Handle WebSocket client connection."""
-        await self.register_client(websocket)
+        """Handle WebSocket client connection and subscription changes."""
+        from websockets.exceptions import ConnectionClosed
+        
+        # websockets >= 13 exposes the request; older versions expose .path
+        request = getattr(websocket, 'request', None)
+        path = request.path if request is not None else getattr(websocket, 'path', '')
+        
+        try:
+            spec = spec_from_path(path)
+            if spec is not None:
+                SubscriptionShape.normalize(spec)  # reject a bad spec here, not in register_client
+        except ValueError as e:
+            print(f"Ignoring invalid subscription in {path}: {e}")
+            spec = None
+        
+        client_id = parse_qs(urlparse(path or '').query).get('client', [None])[0]
+        restored = self.client_state.get(client_id) if client_id is not None else None
+        if restored is not None and not (spec and set(spec) - {'client'}):
+            spec = restored['spec']
+        
         try:
-            await websocket.wait_closed()
+            await self.register_client(websocket, spec)
+            if restored is not None and restored['eeg'] and self.raw_eeg:
+                self._set_eeg(websocket, True)
+            async for raw in websocket:
+                kind = None
+                try:
+                    message = json.loads(raw)
+                    kind = message.get('type')
+                    if kind == 'subscribe':
+                        self.subscriptions.subscribe(websocket, message)
+                        self._remember_client(client_id, spec=message)
+                        await websocket.send(json.dumps({'type': 'subscribed'}))
+                    elif kind == 'eeg':
+                        if not self.raw_eeg:
+                            await websocket.send(json.dumps({'type': 'error', 'message': 'Raw EEG is not enabled on this server'}))
+                        else:
+                            enabled = bool(message.get('enabled', True))
+                            self._set_eeg(websocket, enabled)
+                            self._remember_client(client_id, eeg=enabled)
+                    elif kind == 'segment':
+                        self._add_segment(message)
+                    elif kind == 'history':
+                        limit = int(message.get('limit', 20))
+                        if limit < 0:
+                            raise ValueError(f"negative limit {limit}")
+                        await websocket.send(json.dumps(self.history(limit)))
+                except (ValueError, KeyError, TypeError, AttributeError) as e:
+                    label = {'subscribe': 'subscription', 'eeg': 'eeg request',
+                             'segment': 'segment', 'history': 'history request'}.get(kind, 'message')
+                    await websocket.send(json.dumps({'type': 'error', 'message': f"Invalid {label}: {e}"}))
+        except ConnectionClosed:
+            pass
+        except Exception as e:
+            print(f"Error handling client: {e!r}")
         finally:
             await self.unregister_client(websocket)
     
-    def start_server(self, app_client_id: str, app_client_secret: str):
-        """Start WebSocket emotion streaming server."""
+    def attach_streamer(self, streamer: 'LiveEmotionStreamer'):
+        """Broadcast a streamer's emotion events and EEG blocks to clients."""
         import asyncio
-        import websockets
-        from concurrent.futures import ThreadPoolExecutor
-        import threading
-        
-        # Initialize emotion streamer
-        self.streamer = LiveEmotionStreamer(app_client_id, app_client_secret)
         
-        # Create event loop for this thread
-        self.loop = asyncio.new_event_loop()
-        asyncio.set_event_loop(self.loop)
+        self.streamer = streamer
+        if self.loop is None:
+            self.loop = asyncio.new_event_loop()
         
         # Set up callback to broadcast emotions
         def emotion_callback(event):
+            if self.failover_report is not None and 'first_event_at' not in self.failover_report:
+                self.failover_report['first_event_at'] = time.time()
+                self.failover_report['service_gap_ms'] = round(
+                    (time.time() - self.failover_report['last_primary_event_at']) * 1000)
+                print(f"Failover complete: {json.dumps(self.failover_report)}")
             # Schedule coroutine in the event loop
             if self.clients and self.loop.is_running():
                 asyncio.run_coroutine_threadsafe(self.broadcast_emotion(event), self.loop)
         
         self.streamer.set_output_callback(emotion_callback)
         
-        # Start emotion streaming in background thread
+        def eeg_callback(block):
+            if self.eeg_clients and self.loop.is_running():
+                asyncio.run_coroutine_threadsafe(self.broadcast_eeg(block), self.loop)
+        
+        self.streamer.set_eeg_callback(eeg_callback)
+    
+    def start_streaming(self, session_gate: Optional[threading.Event] = None):
+        """Start the attached streamer on a background thread."""
         def start_emotion_streaming():
-            self.streamer.start_streaming(['met'])
+            # 'eeg' is acquired per raw EEG client
+            self.streamer.start_streaming(['met'], session_gate=session_gate)
         
-        streaming_thread = threading.Thread(target=start_emotion_streaming, daemon=True)
+        streaming_thread = threading.Thread(target=start_emotion_streaming, name="EmotionStreaming", daemon=True)
         streaming_thread.start()
+    
+    def serve(self, listen_socket=None):
+        """
+        Serve WebSocket clients until interrupted.
+        
+        Args:
+            listen_socket: Already-listening socket to accept on (e.g. one
+                inherited from a failed primary) instead of binding the port
+        """
+        import asyncio
+        import websockets
+        
+        if self.loop is None:
+            self.loop = asyncio.new_event_loop()
+        asyncio.set_event_loop(self.loop)
         
         # Start WebSocket server
         print(f"Starting WebSocket emotion server on ws://localhost:{self.port}")
         
         async def main():
             try:
-                async with websockets.serve(self.handle_client, "localhost", self.port):
+                if listen_socket is not None:
+                    server = websockets.serve(self.handle_client, sock=listen_socket)
+                else:
+                    server = websockets.serve(self.handle_client, "localhost", self.port)
+                async with server:
                     print(f"WebSocket server listening on ws://localhost:{self.port}")
                     await asyncio.Future()  # Run forever
             except OSError as e:
@@ -258,7 +619,17 @@ class EmotionWebSocketServer:
             print("\nShutting down WebSocket server...")
         finally:
             self.loop.close()
-
+    
+    def start_server(self, app_client_id: str, app_client_secret: str):
+        """Start WebSocket emotion streaming server."""
+        self.attach_streamer(LiveEmotionStreamer(app_client_id, app_client_secret, replicator=self.replicator,
+                                                 baseline_store=self.baseline_store, user_id=self.user_id))
+        self.start_streaming()
+        
+        # Optional on-demand profiler (enabled via THERAPIST_PROFILER_PORT)
+        start_profiler_server()
+        
+        self.serve()
 
 def demo_live_streaming():
     """Demonstrate live emotion streaming from headset."""
@@ -300,8 +671,8 @@ def demo_live_streaming():
         print(f"Error: {e}")
 
 
-def demo_websocket_streaming():
-    """Demonstrate WebSocket emotion streaming server."""
+def demo_websocket_streaming(raw_eeg: bool = False, user_id: Optional[str] = None):
+    """Demonstrate WebSocket emotion streaming server (per-user baseline if user_id is given)."""
     import dotenv
     
     # Load credentials from .env
@@ -317,7 +688,12 @@ def demo_websocket_streaming():
     print("Connect to ws://localhost:8765 to receive emotion events")
     print()
     
-    server = EmotionWebSocketServer(port=8765)
+    baseline_store = None
+    if user_id:
+        from user_baseline import BaselineStore
+        baseline_store = BaselineStore("baselines")
+        print(f"Normalizing against the baseline of user {user_id}")
+    server = EmotionWebSocketServer(port=8765, raw_eeg=raw_eeg, baseline_store=baseline_store, user_id=user_id)
     
     try:
         server.start_server(app_client_id, app_client_secret)
@@ -331,6 +707,9 @@ if __name__ == "__main__":
     import sys
     
     if len(sys.argv) > 1 and sys.argv[1] == "websocket":
-        demo_websocket_streaming()
+        # --raw-eeg also streams raw EEG to clients that enable it (EEG viewer)
+        # --user <id> normalizes against (and keeps learning) that user's baseline
+        user_id = sys.argv[sys.argv.index('--user') + 1] if '--user' in sys.argv[:-1] else None
+        demo_websocket_streaming(raw_eeg='--raw-eeg' in sys.argv, user_id=user_id)
     else:
         demo_live_streaming()
\ No newline at end of file
@@ -0,0 +1,428 @@
+#!/usr/bin/env python3
+"""
+Streaming LLM Gateway
+
+Single entry point for therapist responses from OpenAI-compatible chat
+providers (DeepSeek, Moonshot Kimi-K2, or the local stand-in server).
+
+Features:
+- Token streaming, plus sentence chunking for feeding the TTS stage early
+- Byte-identical, pre-encoded system prompt prefixes so provider-side
+  context caching (e.g. DeepSeek's automatic prefix cache) gets hits
+- Per-provider concurrency limits with FIFO queueing
+- Hedged requests: if the first token is late, a second attempt races it
+"""
+
+import os
+import json
+import time
+import asyncio
+import itertools
+from collections import OrderedDict
+from dataclasses import dataclass
+from typing import AsyncIterator, Dict, List, Optional
+
+import httpx
+
+
+@dataclass
+class ProviderConfig:
+    """Connection and policy settings for one chat provider."""
+    name: str
+    base_url: str
+    model: str
+    api_key_env: Optional[str] = None
+    max_concurrency: int = 4
+    # Launch a hedge if no token arrived after this many seconds (None = off)
+    hedge_after: Optional[float] = 2.0
+    # Total attempts per request, including hedges and retries
+    max_attempts: int = 3
+    retry_backoff: float = 0.25
+    timeout: float = 60.0
+
+
+DEFAULT_PROVIDERS = {
+    'deepseek': ProviderConfig(
+        name='deepseek',
+        base_url='https://api.deepseek.com/v1',
+        model='deepseek-chat',
+        api_key_env='DEEPSEEK_API_KEY'
+    ),
+    'kimi': ProviderConfig(
+        name='kimi',
+        base_url='https://api.moonshot.cn/v1',
+        model='kimi-k2-0711-preview',
+        api_key_env='MOONSHOT_API_KEY'
+    ),
+    'standin': ProviderConfig(
+        name='standin',
+        base_url='http://127.0.0.1:8808/v1',
+        model='standin',
+        max_concurrency=32,
+        hedge_after=1.0
+    ),
+}
+
+
+class GatewayError(Exception):
+    """Raised when a provider request fails and cannot be retried."""
+
+    def __init__(self, message: str, retryable: bool = True):
+        super().__init__(message)
+        self.retryable = retryable
+
+
+class PrefixCache:
+    """
+    Cache of JSON-encoded leading messages.
+
+    Providers match cached prefixes byte for byte, so the system prompt (and
+    any other stable leading messages) is encoded once and reused verbatim
+    for every request instead of being re-serialized per call.
+    """
+
+    def __init__(self, max_entries: int = 64):
+        self.max_entries = max_entries
+        self.entries = OrderedDict()
+        self.hits = 0
+        self.misses = 0
+
+    def encode(self, messages: List[Dict], prefix_len: int) -> bytes:
+        """Encode messages as a JSON array, reusing the cached prefix bytes."""
+        prefix = messages[:prefix_len]
+        key = tuple((m['role'], m['content']) for m in prefix)
+
+        encoded = self.entries.get(key)
+        if encoded is None:
+            self.misses += 1
+            encoded = b','.join(json.dumps(m, ensure_ascii=False).encode('utf-8') for m in prefix)
+            self.entries[key] = encoded
+            if len(self.entries) > self.max_entries:
+                self.entries.popitem(last=False)
+        else:
+            self.hits += 1
+            self.entries.move_to_end(key)
+
+        tail = [json.dumps(m, ensure_ascii=False).encode('utf-8') for m in messages[prefix_len:]]
+        parts = ([encoded] if encoded else []) + tail
+        return b'[' + b','.join(parts) + b']'
+
+
+class ProviderStats:
+    """Running counters for one provider."""
+
+    def __init__(self):
+        self.requests = 0
+        self.attempts = 0
+        self.hedges = 0
+        self.hedge_wins = 0
+        self.retries = 0
+        self.failures = 0
+        self.queued = 0
+        self.max_queued = 0
+        self.queue_wait_total = 0.0
+        self.ttft_samples = []
+        self.prompt_tokens = 0
+        self.cache_hit_tokens = 0
+
+    def snapshot(self) -> Dict:
+        ttfts = sorted(self.ttft_samples)
+
+        def pct(p):
+            return round(ttfts[min(len(ttfts) - 1, int(p * len(ttfts)))], 3) if ttfts else None
+
+        return {
+            'requests': self.requests,
+            'attempts': self.attempts,
+            'hedges': self.hedges,
+            'hedge_wins': self.hedge_wins,
+            'retries': self.retries,
+            'failures': self.failures,
+            'queued': self.queued,
+            'max_queued': self.max_queued,
+            'avg_queue_wait': round(self.queue_wait_total / self.attempts, 4) if self.attempts else 0.0,
+            'ttft_p50': pct(0.5),
+            'ttft_p95': pct(0.95),
+            'prompt_tokens': self.prompt_tokens,
+            'cache_hit_tokens': self.cache_hit_tokens,
+        }
+
+
+class LLMGateway:
+    """
+    Streams chat completions with queueing, hedging and prefix reuse.
+
+    Usage:
+        gateway = LLMGateway()
+        async for text in gateway.stream_chat(messages, provider='deepseek'):
+            tts.feed(text)
+    """
+
+    def __init__(self, providers: Optional[Dict[str, ProviderConfig]] = None):
+        self.providers = dict(providers or DEFAULT_PROVIDERS)
+        self.prefix_cache = PrefixCache()
+        self._client = None
+        self._slots = {}
+        self._stats = {}
+        self._ids = itertools.count()
+
+    async def _get_client(self) -> httpx.AsyncClient:
+        if self._client is None:
+            limits = httpx.Limits(max_connections=sum(p.max_concurrency * 2 for p in self.providers.values()))
+            self._client = httpx.AsyncClient(limits=limits, timeout=None)
+        return self._client
+
+    def _slot(self, provider: ProviderConfig) -> asyncio.Semaphore:
+        if provider.name not in self._slots:
+            self._slots[provider.name] = asyncio.Semaphore(provider.max_concurrency)
+        return self._slots[provider.name]
+
+    def stats(self, provider: str) -> ProviderStats:
+        if provider not in self._stats:
+            self._stats[provider] = ProviderStats()
+        return self._stats[provider]
+
+    def metrics(self) -> Dict:
+        """Per-provider counters plus prefix cache efficiency."""
+        return {
+            'providers': {name: s.snapshot() for name, s in self._stats.items()},
+            'prefix_cache': {'hits': self.prefix_cache.hits, 'misses': self.prefix_cache.misses}
+        }
+
+    async def close(self):
+        if self._client is not None:
+            await self._client.aclose()
+            self._client = None
+
+    async def chat(self, messages: List[Dict], provider: str = 'deepseek', **params) -> str:
+        """Non-streaming convenience wrapper."""
+        parts = []
+        async for text in self.stream_chat(messages, provider, **params):
+            parts.append(text)
+        return ''.join(parts)
+
+    async def stream_chat(self, messages: List[Dict], provider: str = 'deepseek',
+                          prefix_len: Optional[int] = None, **params) -> AsyncIterator[str]:
+        """
+        Stream response text deltas.
+
+        Args:
+            messages: OpenAI-style chat messages
+            provider: Key into the configured providers
+            prefix_len: Number of leading messages that are stable across turns
+                        (defaults to the leading run of system messages)
+            **params: Extra completion parameters (temperature, max_tokens, ...)
+
+        Yields:
+            Text deltas as they arrive from the winning attempt
+        """
+        config = self.providers[provider]
+        stats = self.stats(provider)
+        stats.requests += 1
+
+        if prefix_len is None:
+            prefix_len = next((i for i, m in enumerate(messages) if m['role'] != 'system'), len(messages))
+        body = self._build_body(config, messages, prefix_len, params)
+
+        events = asyncio.Queue()
+        tasks = {}
+        attempts_made = 0
+        hedged = False
+        winner = None
+        started = time.perf_counter()
+        hedge_at = started + (config.hedge_after or 0.0)
+
+        def launch(delay: float = 0.0, is_hedge: bool = False):
+            nonlocal attempts_made
+            attempt_id = next(self._ids)
+            attempts_made += 1
+            tasks[attempt_id] = (asyncio.create_task(
+                self._run_attempt(config, body, attempt_id, events, delay)), is_hedge)
+
+        launch()
+
+        try:
+            while True:
+                timeout = None
+                if winner is None and not hedged and config.hedge_after is not None \
+                        and attempts_made < config.max_attempts:
+                    timeout = max(0.0, hedge_at - time.perf_counter())
+
+                try:
+                    attempt_id, kind, payload = await asyncio.wait_for(events.get(), timeout)
+                except asyncio.TimeoutError:
+                    if self._slot(config).locked():
+                        # Saturated: a hedge would only queue behind the first attempt
+                        hedge_at = time.perf_counter() + config.hedge_after / 4
+                        continue
+                    # First token is late: race a second attempt against the first
+                    hedged = True
+                    stats.hedges += 1
+                    launch(is_hedge=True)
+                    continue
+
+                if winner is None:
+                    if kind == 'error':
+                        tasks.pop(attempt_id, None)
+                        if not payload.retryable or attempts_made >= config.max_attempts:
+                            if not tasks:
+                                stats.failures += 1
+                                raise payload
+                            continue
+                        stats.retries += 1
+                        launch(delay=config.retry_backoff * attempts_made)
+                        continue
+
+                    winner = attempt_id
+                    stats.ttft_samples.append(time.perf_counter() - started)
+                    if len(stats.ttft_samples) > 1000:
+                        del stats.ttft_samples[:500]
+                    if tasks[attempt_id][1]:
+                        stats.hedge_wins += 1
+                    for other_id, (task, _) in list(tasks.items()):
+                        if other_id != attempt_id:
+                            task.cancel()
+
+                if attempt_id != winner:
+                    continue
+                if kind == 'token':
+                    yield payload
+                elif kind == 'done':
+                    return
+                elif kind == 'error':
+                    # Tokens were already emitted, so this can't be retried transparently
+                    stats.failures += 1
+                    raise payload
+        finally:
+            for task, _ in tasks.values():
+                task.cancel()
+
+    def _build_body(self, config: ProviderConfig, messages: List[Dict],
+                    prefix_len: int, params: Dict) -> bytes:
+        # Stable fields first, messages last, so the byte prefix only changes after the system prompt
+        head = {
+            'model': config.model,
+            'stream': True,
+            'stream_options': {'include_usage': True},
+        }
+        head.update(params)
+        encoded_head = json.dumps(head, ensure_ascii=False).encode('utf-8')[:-1]
+        return encoded_head + b', "messages": ' + self.prefix_cache.encode(messages, prefix_len) + b'}'
+
+    async def _run_attempt(self, config: ProviderConfig, body: bytes, attempt_id: int,
+                           events: asyncio.Queue, delay: float):
+        stats = self.stats(config.name)
+        try:
+            if delay:
+                await asyncio.sleep(delay)
+
+            slot = self._slot(config)
+            queued_at = time.perf_counter()
+            stats.queued += 1
+            stats.max_queued = max(stats.max_queued, stats.queued)
+            try:
+                await slot.acquire()
+            finally:
+                stats.queued -= 1
+            stats.queue_wait_total += time.perf_counter() - queued_at
+            stats.attempts += 1
+
+            try:
+                await self._stream_attempt(config, body, attempt_id, events)
+            finally:
+                slot.release()
+        except asyncio.CancelledError:
+            raise
+        except GatewayError as e:
+            await events.put((attempt_id, 'error', e))
+        except Exception as e:
+            # Transport errors (httpx.StreamError is not an HTTPError) and
+            # malformed chunks alike: stream_chat waits for every attempt to
+            # report, so none may end silently
+            await events.put((attempt_id, 'error', GatewayError(f"{config.name}: {e!r}")))
+
+    async def _stream_attempt(self, config: ProviderConfig, body: bytes, attempt_id: int,
+                              events: asyncio.Queue):
+        headers = {'Content-Type': 'application/json', 'Accept': 'text/event-stream'}
+        if config.api_key_env:
+            api_key = os.environ.get(config.api_key_env)
+            if not api_key:
+                raise GatewayError(f"{config.api_key_env} is not set", retryable=False)
+            headers['Authorization'] = f"Bearer {api_key}"
+
+        client = await self._get_client()
+        url = f"{config.base_url}/chat/completions"
+        timeout = httpx.Timeout(config.timeout, connect=5.0)
+
+        async with client.stream('POST', url, content=body, headers=headers, timeout=timeout) as resp:
+            if resp.status_code != 200:
+                detail = (await resp.aread())[:200].decode('utf-8', 'replace')
+                retryable = resp.status_code == 429 or resp.status_code >= 500
+                raise GatewayError(f"{config.name} HTTP {resp.status_code}: {detail}", retryable)
+
+            async for line in resp.aiter_lines():
+                if not line.startswith('data:'):
+                    continue
+                data = line[5:].strip()
+                if data == '[DONE]':
+                    break
+
+                chunk = json.loads(data)
+                usage = chunk.get('usage')
+                if usage:
+                    stats = self.stats(config.name)
+                    stats.prompt_tokens += usage.get('prompt_tokens', 0)
+                    stats.cache_hit_tokens += usage.get('prompt_cache_hit_tokens', 0)
+
+                for choice in chunk.get('choices', []):
+                    text = choice.get('delta', {}).get('content')
+                    if text:
+                        await events.put((attempt_id, 'token', text))
+
+        await events.put((attempt_id, 'done', None))
+
+
+async def sentence_chunks(tokens: AsyncIterator[str], min_chars: int = 20) -> AsyncIterator[str]:
+    """
+    Group streamed tokens into sentence-sized pieces for the TTS stage.
+
+    Speech synthesis can start on the first sentence while the rest of the
+    response is still being generated.
+    """
+    buffer = ''
+    async for text in tokens:
+        buffer += text
+        # Split after the last sentence boundary once enough text is buffered
+        cut = max(buffer.rfind(mark) for mark in ('. ', '! ', '? ', '\n', '。', '！', '？'))
+        if cut >= 0 and cut + 1 >= min_chars:
+            yield buffer[:cut + 1].strip()
+            buffer = buffer[cut + 1:]
+    if buffer.strip():
+        yield buffer.strip()
+
+
+async def _demo():
+    gateway = LLMGateway()
+    messages = [
+        {'role': 'system', 'content': 'You are a compassionate therapist. Respond briefly and warmly.'},
+        {'role': 'user', 'content': "I've been feeling anxious about work lately. [Emotion: Anxious]"},
+    ]
+
+    print("Streaming from the local stand-in (run llm_standin.py first)...")
+    async for sentence in sentence_chunks(gateway.stream_chat(messages, provider='standin')):
+        print(f"  TTS <- {sentence}")
+
+    # Load test: many concurrent sessions against the stand-in
+    async def one():
+        return await gateway.chat(messages, provider='standin', max_tokens=40)
+
+    start = time.perf_counter()
+    results = await asyncio.gather(*(one() for _ in range(200)), return_exceptions=True)
+    failed = sum(isinstance(r, Exception) for r in results)
+    print(f"200 requests in {time.perf_counter() - start:.2f}s ({failed} failed)")
+    print(json.dumps(gateway.metrics(), indent=2))
+    await gateway.close()
+
+
+if __name__ == "__main__":
+    asyncio.run(_demo())
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+Local LLM Stand-in Server
+
+Emulates an OpenAI-compatible streaming chat endpoint for offline load tests
+of the LLM gateway. Token rate, time-to-first-token, jitter, error rate and
+concurrency limits are configurable; requests whose system prompt prefix was
+seen recently get a faster first token and report prompt_cache_hit_tokens,
+like DeepSeek's prefix cache.
+"""
+
+import json
+import time
+import random
+import asyncio
+import argparse
+import hashlib
+from collections import OrderedDict
+
+CANNED_REPLY = (
+    "It sounds like work has been weighing on you. That's a very understandable "
+    "reaction to pressure. Can you tell me a little more about what happens in "
+    "your body when the anxiety shows up? Sometimes noticing it is the first step. "
+    "We can take this one piece at a time, together."
+)
+
+
+class StandinLLMServer:
+    """Minimal HTTP/1.1 server streaming canned completions as SSE."""
+
+    def __init__(self, port: int = 8808, tokens_per_second: float = 40.0,
+                 ttft: float = 0.35, cached_ttft: float = 0.12, jitter: float = 0.1,
+                 error_rate: float = 0.0, stall_rate: float = 0.0, max_concurrency: int = 32):
+        """
+        Initialize stand-in server.
+
+        Args:
+            port: Port to listen on (localhost only)
+            tokens_per_second: Streaming rate per request
+            ttft: Time to first token for uncached prompts (seconds)
+            cached_ttft: Time to first token when the prompt prefix is cached
+            jitter: Relative random variation applied to every delay
+            error_rate: Fraction of requests answered with HTTP 500
+            stall_rate: Fraction of requests whose first token takes 10x longer
+            max_concurrency: Requests beyond this get HTTP 429
+        """
+        self.port = port
+        self.tokens_per_second = tokens_per_second
+        self.ttft = ttft
+        self.cached_ttft = cached_ttft
+        self.jitter = jitter
+        self.error_rate = error_rate
+        self.stall_rate = stall_rate
+        self.max_concurrency = max_concurrency
+
+        self.active = 0
+        self.served = 0
+        self.prefix_cache = OrderedDict()
+
+    def _delay(self, base: float) -> float:
+        return max(0.0, base * (1 + random.uniform(-self.jitter, self.jitter)))
+
+    def _cache_lookup(self, messages) -> int:
+        """Return cached prefix token count for the leading system messages."""
+        prefix = [m for m in messages if m.get('role') == 'system']
+        if not prefix:
+            return 0
+        digest = hashlib.sha1(json.dumps(prefix, sort_keys=True).encode()).hexdigest()
+        tokens = sum(len(m.get('content', '')) for m in prefix) // 4
+        if digest in self.prefix_cache:
+            self.prefix_cache.move_to_end(digest)
+            return tokens
+        self.prefix_cache[digest] = tokens
+        if len(self.prefix_cache) > 256:
+            self.prefix_cache.popitem(last=False)
+        return 0
+
+    async def handle(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter):
+        try:
+            request_line = await reader.readline()
+            if not request_line:
+                return
+            method, path, _ = request_line.decode().split(' ', 2)
+
+            headers = {}
+            while True:
+                line = await reader.readline()
+                if line in (b'\r\n', b'\n', b''):
+                    break
+                key, _, value = line.decode().partition(':')
+                headers[key.strip().lower()] = value.strip()
+
+            body = await reader.readexactly(int(headers.get('content-length', 0)))
+
+            if method != 'POST' or not path.endswith('/chat/completions'):
+                await self._respond(writer, 404, b'{"error": "not found"}')
+                return
+            if self.active >= self.max_concurrency:
+                await self._respond(writer, 429, b'{"error": "rate limited"}')
+                return
+            if random.random() < self.error_rate:
+                await self._respond(writer, 500, b'{"error": "injected failure"}')
+                return
+
+            self.active += 1
+            try:
+                await self._stream(writer, json.loads(body))
+            finally:
+                self.active -= 1
+                self.served += 1
+        except (ConnectionError, asyncio.IncompleteReadError, ValueError):
+            pass
+        finally:
+            writer.close()
+
+    async def _respond(self, writer, status: int, body: bytes):
+        reason = {404: 'Not Found', 429: 'Too Many Requests', 500: 'Internal Server Error'}[status]
+        writer.write(f"HTTP/1.1 {status} {reason}\r\nContent-Type: application/json\r\n"
+                     f"Content-Length: {len(body)}\r\nConnection: close\r\n\r\n".encode() + body)
+        await writer.drain()
+
+    async def _stream(self, writer, request):
+        messages = request.get('messages', [])
+        max_tokens = int(request.get('max_tokens', 120))
+        cached_tokens = self._cache_lookup(messages)
+        prompt_tokens = sum(len(m.get('content', '')) for m in messages) // 4
+
+        writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                     b"Cache-Control: no-cache\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n")
+
+        def send_event(payload: str):
+            data = f"data: {payload}\n\n".encode()
+            writer.write(f"{len(data):x}\r\n".encode() + data + b"\r\n")
+
+        ttft = self.cached_ttft if cached_tokens else self.ttft
+        if random.random() < self.stall_rate:
+            ttft *= 10
+        await asyncio.sleep(self._delay(ttft))
+
+        words = CANNED_REPLY.split(' ')
+        created = int(time.time())
+        for i, word in enumerate(words[:max_tokens]):
+            if i:
+                await asyncio.sleep(self._delay(1.0 / self.tokens_per_second))
+            chunk = {
+                'id': 'standin', 'object': 'chat.completion.chunk', 'created': created,
+                'model': request.get('model', 'standin'),
+                'choices': [{'index': 0, 'delta': {'content': word if i == 0 else ' ' + word}}]
+            }
+            send_event(json.dumps(chunk))
+            await writer.drain()
+
+        usage = {
+            'prompt_tokens': prompt_tokens,
+            'completion_tokens': min(len(words), max_tokens),
+            'prompt_cache_hit_tokens': cached_tokens,
+            'prompt_cache_miss_tokens': prompt_tokens - cached_tokens
+        }
+        send_event(json.dumps({'id': 'standin', 'choices': [], 'usage': usage}))
+        send_event('[DONE]')
+        writer.write(b"0\r\n\r\n")
+        await writer.drain()
+
+    async def serve(self):
+        server = await asyncio.start_server(self.handle, '127.0.0.1', self.port)
+        print(f"Stand-in LLM listening on http://127.0.0.1:{self.port}/v1/chat/completions")
+        print(f"  {self.tokens_per_second} tok/s, TTFT {self.ttft}s (cached {self.cached_ttft}s), "
+              f"errors {self.error_rate:.0%}, stalls {self.stall_rate:.0%}")
+        async with server:
+            await server.serve_forever()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Local streaming LLM stand-in')
+    parser.add_argument('--port', type=int, default=8808)
+    parser.add_argument('--tps', type=float, default=40.0, help='Tokens per second per request')
+    parser.add_argument('--ttft', type=float, default=0.35, help='Time to first token (s)')
+    parser.add_argument('--cached-ttft', type=float, default=0.12)
+    parser.add_argument('--jitter', type=float, default=0.1)
+    parser.add_argument('--error-rate', type=float, default=0.0)
+    parser.add_argument('--stall-rate', type=float, default=0.0)
+    parser.add_argument('--max-concurrency', type=int, default=32)
+    args = parser.parse_args()
+
+    server = StandinLLMServer(
+        port=args.port,
+        tokens_per_second=args.tps,
+        ttft=args.ttft,
+        cached_ttft=args.cached_ttft,
+        jitter=args.jitter,
+        error_rate=args.error_rate,
+        stall_rate=args.stall_rate,
+        max_concurrency=args.max_concurrency
+    )
+
+    try:
+        asyncio.run(server.serve())
+    except KeyboardInterrupt:
+        print("\nStand-in stopped")
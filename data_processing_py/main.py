@@ -1,5 +1,7 @@
+import sys
 import dotenv
 from sub_data import Subcribe
+from stream_manager import StreamManager
 
 def main():
 	app_client_id = dotenv.get_key(dotenv_path='.env', key_to_get='EMOTIV_APP_CLIENT_ID')
@@ -13,9 +15,14 @@ def main():
 	print("Starting subscription with secret.")
 
 	s = Subcribe(app_client_id, app_client_secret)
-	streams = ['dev', 'eq', 'pow', 'met']
+	# Only the streams asked for on the command line, e.g. `python main.py met pow`
+	streams = sys.argv[1:] or ['met']
 
-	s.start(streams)
+	manager = StreamManager(s)
+	for stream in streams:
+		manager.acquire(stream)
+
+	s.start([])
 
 if __name__ == "__main__":
-	main()
\ No newline at end of file
+	main()
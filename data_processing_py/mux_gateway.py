@@ -0,0 +1,458 @@
+#!/usr/bin/env python3
+"""
+Multiplexed WebSocket Gateway
+
+Gives each browser tab a single WebSocket carrying every stream it needs,
+instead of one connection to the chat backend (ws://localhost:8000/ws/chat)
+and another to the emotion server (ws://localhost:8765). The gateway holds
+those upstream connections per session and maps them onto typed channels.
+
+Wire format (both directions), one binary WebSocket message per frame:
+
+    byte 0   channel id
+    byte 1   flags: 0x01 FIN (last fragment of a message), 0x02 TEXT (UTF-8 JSON)
+    rest     payload fragment
+
+Channels, highest priority first:
+
+    0 control      mux control (credit, clock ping/pong) and chat control messages
+    1 audio_up     microphone chunks (binary); {"type": "start"|"end"} as text
+    2 audio_down   synthesized speech (binary, one message per reply)
+    3 transcript   transcriptions and therapist text
+    4 emotion      emotion events (latest-only: stale events are dropped); also
+                   voice prosody events ({"type": "prosody", ...}) from the gateway
+    5 voice        16 kHz mono int16 microphone PCM for prosody analysis, each
+                   message prefixed with the capture time of its first sample
+                   (float64 LE, browser clock)
+    6 eeg          raw EEG blocks for the viewer (binary, see
+                   live_emotion.pack_eeg_block); enabled by sending
+                   {"type": "eeg", "enabled": true} on the emotion channel
+
+Messages are cut into fragments of at most MAX_FRAGMENT bytes and the
+sender always picks the next fragment from the highest-priority channel that
+has data and credit, so an audio frame waits for at most one fragment of a
+bulk message, never for the whole message. Each channel except control has
+a credit window in bytes; the receiver returns credit with
+{"type": "credit", "channel": n, "bytes": k} on the control channel as it
+consumes messages, so a slow consumer of one channel cannot stall the others.
+
+Voice PCM is analysed per session by prosody.ProsodyExtractor. Feature
+events are stamped on the backend clock (via the browser clock estimate) so
+they line up with emotion events' synced_timestamp, and each utterance sent
+to the chat backend carries a "voice" summary of its prosody.
+
+Clock sync runs on the control channel: the client sends
+{"type": "ping", "id": n, "t0": ..., "sample": [t0, t1, t2, t3]} (its previous
+completed exchange, in seconds) and gets {"type": "pong", "id": n, "t0",
+"t1", "t2"} back; see clock_sync.py.
+
+    python mux_gateway.py                      # ws://localhost:8770
+    python mux_gateway.py --port 8770 --chat-url ws://localhost:8000/ws/chat
+"""
+
+import json
+import struct
+import time
+import base64
+import asyncio
+from collections import deque
+from dataclasses import dataclass
+from typing import Awaitable, Callable, Dict, Optional, Union
+
+import websockets
+
+from clock_sync import clock_sync
+from prosody import ProsodyExtractor
+
+FLAG_FIN = 0x01
+FLAG_TEXT = 0x02
+MAX_FRAGMENT = 16 * 1024
+# Buffered audio_up bytes per utterance (~17 min of 64 kbit/s Opus); a client
+# that never sends "end" gets an error instead of growing the buffer forever
+MAX_UTTERANCE = 8 * 1024 * 1024
+
+
+@dataclass(frozen=True)
+class ChannelSpec:
+    """Static properties of one mux channel."""
+    id: int
+    name: str
+    priority: int
+    # Initial credit in bytes (None = not flow controlled)
+    window: Optional[int]
+    # Keep at most this many queued messages, dropping the oldest (None = keep all)
+    max_queued: Optional[int] = None
+
+
+CHANNELS = {spec.name: spec for spec in (
+    ChannelSpec(0, 'control', 0, None),
+    ChannelSpec(1, 'audio_up', 1, 512 * 1024),
+    ChannelSpec(2, 'audio_down', 1, 512 * 1024),
+    ChannelSpec(3, 'transcript', 2, 64 * 1024),
+    ChannelSpec(4, 'emotion', 3, 32 * 1024, max_queued=8),
+    ChannelSpec(5, 'voice', 1, 256 * 1024),
+    # ~3 KB/s; a stalled viewer loses the oldest blocks rather than delaying newer ones
+    ChannelSpec(6, 'eeg', 4, 64 * 1024, max_queued=64),
+)}
+
+MessageHandler = Callable[[str, Union[str, bytes]], Awaitable[None]]
+
+
+class _ChannelState:
+    """Send queue, credit and reassembly buffer for one channel of one session."""
+
+    def __init__(self, spec: ChannelSpec):
+        self.spec = spec
+        self.queue = deque()  # (payload bytes, is_text)
+        self.offset = 0  # bytes of the head message already sent
+        self.credit = spec.window
+        self.partial = bytearray()
+        self.consumed = 0  # received bytes not yet credited back
+        self.dropped = 0
+
+    def sendable(self) -> bool:
+        return bool(self.queue) and (self.credit is None or self.credit > 0)
+
+
+class MuxSession:
+    """
+    One multiplexed connection: prioritized, credit-limited sending and
+    per-channel reassembly of received messages.
+    """
+
+    def __init__(self, websocket):
+        self.websocket = websocket
+        self.channels = {spec.id: _ChannelState(spec) for spec in CHANNELS.values()}
+        self._by_priority = sorted(self.channels.values(), key=lambda c: c.spec.priority)
+        self._wakeup = asyncio.Event()
+        self.closed = False
+        self.sent_frames = 0
+        # Peer name of this client's clock in the shared ClockSyncService
+        self.clock_peer = f"browser:{id(self):x}"
+
+    def send(self, channel: str, payload: Union[str, bytes]):
+        """Queue a message on a channel (never blocks)."""
+        state = self.channels[CHANNELS[channel].id]
+        is_text = isinstance(payload, str)
+        state.queue.append((payload.encode('utf-8') if is_text else bytes(payload), is_text))
+
+        # Latest-only channels drop the oldest messages that have not started sending
+        limit = state.spec.max_queued
+        if limit is not None:
+            first = 1 if state.offset else 0
+            while len(state.queue) - first > limit:
+                del state.queue[first]
+                state.dropped += 1
+        self._wakeup.set()
+
+    def send_json(self, channel: str, message: Dict):
+        self.send(channel, json.dumps(message))
+
+    def _next_frame(self) -> Optional[bytes]:
+        for state in self._by_priority:
+            if not state.sendable():
+                continue
+            payload, is_text = state.queue[0]
+            size = min(MAX_FRAGMENT, len(payload) - state.offset)
+            if state.credit is not None:
+                size = min(size, state.credit)
+                state.credit -= size
+            chunk = payload[state.offset:state.offset + size]
+            state.offset += size
+            flags = FLAG_TEXT if is_text else 0
+            if state.offset >= len(payload):
+                flags |= FLAG_FIN
+                state.queue.popleft()
+                state.offset = 0
+            return bytes((state.spec.id, flags)) + chunk
+        return None
+
+    async def _writer(self):
+        while not self.closed:
+            frame = self._next_frame()
+            if frame is None:
+                self._wakeup.clear()
+                await self._wakeup.wait()
+                continue
+            # send() waits while the transport's write buffer is full, so
+            # priorities are re-evaluated at most one fragment behind the wire
+            await self.websocket.send(frame)
+            self.sent_frames += 1
+
+    async def _handle_frame(self, frame: bytes, on_message: MessageHandler):
+        received_at = time.time()
+        if len(frame) < 2 or frame[0] not in self.channels:
+            return
+        state = self.channels[frame[0]]
+        flags = frame[1]
+        state.partial += frame[2:]
+        if flags & FLAG_FIN:
+            data = bytes(state.partial)
+            state.partial.clear()
+            await self._deliver(state, data, flags, on_message, received_at)
+
+        # Return credit once a quarter of the window has been received and
+        # handled (messages larger than the window still make progress)
+        state.consumed += len(frame) - 2
+        if state.spec.window is not None and state.consumed >= state.spec.window // 4:
+            self.send_json('control', {'type': 'credit', 'channel': state.spec.id, 'bytes': state.consumed})
+            state.consumed = 0
+
+    async def _deliver(self, state: _ChannelState, data: bytes, flags: int, on_message: MessageHandler,
+                       received_at: float):
+        if state.spec.name == 'control':
+            # A bad control message is answered, not allowed to end the session
+            try:
+                message = json.loads(data)
+                if not isinstance(message, dict):
+                    raise ValueError("expected a JSON object")
+                if message.get('type') == 'credit':
+                    target = self.channels.get(message.get('channel'))
+                    if target is not None and target.credit is not None:
+                        target.credit += int(message.get('bytes', 0))
+                        self._wakeup.set()
+                    return
+                if message.get('type') == 'ping':
+                    # NTP-style: echo the client's send time with our receive and send times
+                    self.send_json('control', {'type': 'pong', 'id': message.get('id'), 't0': message.get('t0'),
+                                               't1': received_at, 't2': time.time()})
+                    sample = message.get('sample')
+                    if sample and len(sample) == 4:
+                        clock_sync.observe_exchange(self.clock_peer, *map(float, sample), initiator=False)
+                    return
+            except (ValueError, TypeError, AttributeError) as e:
+                self.send_json('control', {'type': 'error', 'message': f"Invalid control message: {e}"})
+                return
+            await on_message('control', message)
+            return
+
+        await on_message(state.spec.name, data.decode('utf-8') if flags & FLAG_TEXT else data)
+
+    async def run(self, on_message: MessageHandler):
+        """Read frames until the connection closes, dispatching whole messages."""
+        writer = asyncio.create_task(self._writer())
+        try:
+            async for frame in self.websocket:
+                if isinstance(frame, str):
+                    continue  # Frames are always binary
+                try:
+                    await self._handle_frame(frame, on_message)
+                except (ValueError, KeyError, TypeError, AttributeError) as e:
+                    print(f"Error handling mux frame: {e}")
+        except websockets.ConnectionClosed:
+            pass
+        finally:
+            self.closed = True
+            self._wakeup.set()
+            writer.cancel()
+            try:
+                await writer
+            except (asyncio.CancelledError, websockets.ConnectionClosed):
+                pass
+
+
+class _Upstream:
+    """
+    A reconnecting upstream WebSocket owned by one session.
+
+    The latest message of each type in sticky (e.g. subscription changes) is
+    replayed after every reconnect, so upstream restarts keep client state.
+    """
+
+    def __init__(self, name: str, url: str, session: MuxSession, on_message: Callable[[Union[str, bytes]], None],
+                 sticky: tuple = ()):
+        self.name = name
+        self.url = url
+        self.session = session
+        self.on_message = on_message
+        self.sticky = sticky
+        self._sticky_messages: Dict[str, str] = {}
+        self.websocket = None
+        self.task = asyncio.create_task(self._run())
+
+    async def _run(self):
+        delay = 0.5
+        while not self.session.closed:
+            try:
+                # Chat replies carry whole base64 WAV files
+                async with websockets.connect(self.url, max_size=2 ** 25) as websocket:
+                    for message in self._sticky_messages.values():
+                        await websocket.send(message)
+                    self.websocket = websocket
+                    delay = 0.5
+                    self.session.send_json('control', {'type': 'upstream', 'name': self.name, 'connected': True})
+                    async for message in websocket:
+                        self.on_message(message)
+            except (OSError, websockets.WebSocketException):
+                pass
+            finally:
+                if self.websocket is not None:
+                    self.websocket = None
+                    self.session.send_json('control', {'type': 'upstream', 'name': self.name, 'connected': False})
+            await asyncio.sleep(delay)
+            delay = min(delay * 2, 8.0)
+
+    async def send(self, message: str) -> bool:
+        if self.sticky:
+            try:
+                kind = json.loads(message).get('type')
+            except (ValueError, AttributeError):
+                kind = None
+            if kind in self.sticky:
+                self._sticky_messages[kind] = message
+        if self.websocket is None:
+            return False
+        try:
+            await self.websocket.send(message)
+            return True
+        except websockets.ConnectionClosed:
+            return False
+
+    async def close(self):
+        self.task.cancel()
+        if self.websocket is not None:
+            await self.websocket.close()
+
+
+class MuxGateway:
+    """
+    Serves the multiplexed protocol and bridges each session to the chat and
+    emotion backends.
+    """
+
+    def __init__(self, port: int = 8770, chat_url: str = "ws://localhost:8000/ws/chat",
+                 emotion_url: str = "ws://localhost:8765", host: str = "localhost"):
+        self.port = port
+        self.host = host
+        self.chat_url = chat_url
+        self.emotion_url = emotion_url
+        self.sessions = set()
+
+    @staticmethod
+    def _route_chat(session: MuxSession, raw: str, on_segment: Optional[Callable[[str, str], None]] = None):
+        """Map a chat backend message onto mux channels; conversation text also goes to on_segment(role, text)."""
+        try:
+            message = json.loads(raw)
+        except ValueError:
+            return
+        kind = message.get('type')
+        if on_segment is not None and message.get('text'):
+            if kind == 'transcription':
+                on_segment('user', message['text'])
+            elif kind in ('audio_response', 'text_response'):
+                on_segment('therapist', message['text'])
+        if kind == 'transcription':
+            session.send_json('transcript', message)
+        elif kind == 'audio_response':
+            # Text first so it shows while the (much larger) audio streams in
+            session.send_json('transcript', {'type': 'response', 'text': message.get('text', ''), 'audio': True})
+            try:
+                session.send('audio_down', base64.b64decode(message.get('audio', '')))
+            except ValueError:
+                session.send_json('control', {'type': 'error', 'message': 'Invalid audio from chat backend'})
+        elif kind == 'backchannel':
+            # Pre-synthesized filler (csm/backchannel.py): audio only, no transcript line
+            try:
+                session.send('audio_down', base64.b64decode(message.get('audio', '')))
+            except ValueError:
+                pass
+        elif kind == 'text_response':
+            session.send_json('transcript', {'type': 'response', 'text': message.get('text', ''), 'audio': False})
+        else:
+            session.send_json('control', message)
+
+    async def handle_client(self, websocket):
+        session = MuxSession(websocket)
+        self.sessions.add(session)
+        # Binary messages from the emotion server are raw EEG blocks
+        emotion = _Upstream('emotion', self.emotion_url, session,
+                            lambda raw: session.send('eeg' if isinstance(raw, bytes) else 'emotion', raw),
+                            sticky=('subscribe', 'eeg'))
+
+        def on_segment(role: str, text: str):
+            # The emotion server keeps (and replicates) the conversation alongside emotion history
+            segment = {'type': 'segment', 'role': role, 'text': text, 'timestamp': time.time()}
+            asyncio.ensure_future(emotion.send(json.dumps(segment)))
+
+        chat = _Upstream('chat', self.chat_url, session, lambda raw: self._route_chat(session, raw, on_segment))
+        utterance = bytearray()
+        overflowed = False
+        prosody = ProsodyExtractor(callback=lambda event: session.send_json('emotion', event))
+
+        async def on_message(channel: str, data: Union[str, bytes, Dict]):
+            nonlocal overflowed
+            if channel == 'audio_up':
+                if isinstance(data, bytes):
+                    if overflowed:
+                        return  # dropped until the next "start"
+                    if len(utterance) + len(data) > MAX_UTTERANCE:
+                        overflowed = True
+                        utterance.clear()
+                        session.send_json('control', {'type': 'error',
+                                                      'message': 'Utterance too long, audio dropped until next start'})
+                        return
+                    utterance.extend(data)
+                    return
+                try:
+                    message = json.loads(data)
+                    kind = message.get('type')
+                except (ValueError, AttributeError):
+                    session.send_json('control', {'type': 'error', 'message': 'Invalid audio_up message'})
+                    return
+                if kind == 'start':
+                    utterance.clear()
+                    overflowed = False
+                    prosody.reset_utterance()
+                elif kind == 'end' and overflowed:
+                    overflowed = False
+                elif kind == 'end':
+                    payload = json.dumps({'type': 'audio', 'audio': base64.b64encode(utterance).decode('ascii'),
+                                          'voice': prosody.utterance_summary()})
+                    utterance.clear()
+                    if not await chat.send(payload):
+                        session.send_json('control', {'type': 'error', 'message': 'Chat backend not connected'})
+            elif channel == 'voice':
+                if isinstance(data, bytes) and len(data) > 8:
+                    (captured,) = struct.unpack_from('<d', data)
+                    # ~1 ms of NumPy per 100 ms chunk, cheap enough to run inline
+                    prosody.push(data[8:len(data) - (len(data) - 8) % 2],
+                                 clock_sync.to_local(session.clock_peer, captured))
+            elif channel == 'emotion':
+                await emotion.send(data)  # e.g. subscription changes
+            elif channel == 'control':
+                await chat.send(json.dumps(data))
+
+        print(f"Mux client connected ({len(self.sessions)} sessions)")
+        try:
+            await session.run(on_message)
+        finally:
+            await chat.close()
+            await emotion.close()
+            clock_sync.forget(session.clock_peer)
+            self.sessions.discard(session)
+            print(f"Mux client disconnected ({len(self.sessions)} sessions)")
+
+    def start_server(self):
+        """Run the gateway until interrupted."""
+        async def main():
+            async with websockets.serve(self.handle_client, self.host, self.port, max_size=2 ** 20):
+                print(f"Mux gateway on ws://{self.host}:{self.port} "
+                      f"(chat: {self.chat_url}, emotion: {self.emotion_url})")
+                await asyncio.Future()
+
+        try:
+            asyncio.run(main())
+        except KeyboardInterrupt:
+            print("\nShutting down mux gateway...")
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(description="Multiplexed WebSocket gateway")
+    parser.add_argument("--port", type=int, default=8770)
+    parser.add_argument("--chat-url", default="ws://localhost:8000/ws/chat")
+    parser.add_argument("--emotion-url", default="ws://localhost:8765")
+    args = parser.parse_args()
+
+    MuxGateway(args.port, args.chat_url, args.emotion_url).start_server()
@@ -0,0 +1,308 @@
+#!/usr/bin/env python3
+"""
+Network Impairment Proxy
+
+Local TCP proxy that sits between a client and a server (Cortex client ->
+Cortex service, browser -> emotion/chat WebSocket servers) and injects
+latency, jitter, bandwidth caps, reordering stalls and disconnects.
+Scripted profiles step through phases over time so queueing, reconnect logic
+and delivery latency can be measured under reproducible conditions.
+
+TLS (wss://) passes through untouched since the proxy works on raw bytes.
+Because TCP delivers in order, "reordering" and "loss" surface the way
+they do on a real link: as head-of-line stalls on the affected segment.
+"""
+
+import copy
+import json
+import time
+import random
+import asyncio
+import argparse
+from dataclasses import dataclass, field, asdict
+from typing import Dict, List, Optional
+
+
+@dataclass
+class Impairment:
+    """Link conditions for one direction of traffic."""
+    latency_ms: float = 0.0
+    jitter_ms: float = 0.0
+    # None = unlimited
+    bandwidth_kbps: Optional[float] = None
+    # Probability a segment is held back (reordered/lost on the wire) ...
+    reorder_prob: float = 0.0
+    # ... and how long the hold lasts (roughly one retransmission timeout)
+    reorder_delay_ms: float = 200.0
+    # Expected disconnects per minute per connection
+    disconnects_per_min: float = 0.0
+
+
+@dataclass
+class Phase:
+    """One step of a scripted profile."""
+    duration: float
+    impairment: Impairment = field(default_factory=Impairment)
+    # Drop every open connection when this phase starts
+    disconnect: bool = False
+
+
+PROFILES = {
+    'clean': [Phase(0, Impairment())],
+    'wifi-good': [Phase(0, Impairment(latency_ms=8, jitter_ms=4))],
+    'wifi-congested': [Phase(0, Impairment(latency_ms=60, jitter_ms=40, bandwidth_kbps=1500,
+                                           reorder_prob=0.02))],
+    'bluetooth': [Phase(0, Impairment(latency_ms=30, jitter_ms=25, bandwidth_kbps=200,
+                                      reorder_prob=0.01))],
+    'flaky': [
+        Phase(20, Impairment(latency_ms=20, jitter_ms=10)),
+        Phase(5, Impairment(latency_ms=400, jitter_ms=200, bandwidth_kbps=64, reorder_prob=0.1)),
+        Phase(0, Impairment(latency_ms=20, jitter_ms=10), disconnect=True),
+    ],
+}
+
+
+def load_profile(spec: str) -> List[Phase]:
+    """
+    Load a named profile or a JSON script.
+
+    JSON format:
+        {"phases": [{"duration": 30, "latency_ms": 20, "jitter_ms": 5},
+                    {"duration": 10, "bandwidth_kbps": 64, "disconnect": true}]}
+    A duration of 0 on the last phase means "hold forever"; otherwise the
+    script loops. A duration of 0 on any other phase applies it and moves
+    straight on (e.g. a bare disconnect).
+    """
+    if spec in PROFILES:
+        return copy.deepcopy(PROFILES[spec])
+
+    with open(spec) as f:
+        script = json.load(f)
+
+    phases = []
+    fields = Impairment.__dataclass_fields__
+    for entry in script['phases']:
+        impairment = Impairment(**{k: v for k, v in entry.items() if k in fields})
+        duration = float(entry.get('duration', 0))
+        if duration < 0:
+            raise ValueError(f"Negative phase duration in {spec}: {duration}")
+        phases.append(Phase(duration, impairment, entry.get('disconnect', False)))
+    return phases
+
+
+class ImpairmentProxy:
+    """
+    Asyncio TCP proxy applying the current phase of a profile.
+
+    Each direction of each connection is a bounded pipe, so a slow link exerts
+    real backpressure on the sender instead of buffering without limit.
+    """
+
+    def __init__(self, listen_port: int, target_host: str, target_port: int,
+                 phases: List[Phase], max_buffer: int = 256 * 1024, seed: Optional[int] = None):
+        self.listen_port = listen_port
+        self.target_host = target_host
+        self.target_port = target_port
+        self.phases = phases
+        self.max_buffer = max_buffer
+        self.rng = random.Random(seed)
+
+        self.current = phases[0]
+        self._conns: Dict[int, Dict] = {}
+        self.stats = {
+            'connections': 0,
+            'disconnects': 0,
+            'bytes_up': 0,
+            'bytes_down': 0,
+            'segments': 0,
+            'held_segments': 0,
+            'added_delay_ms_total': 0.0,
+        }
+
+    def _release_time(self, state: Dict, size: int, now: float) -> float:
+        imp = self.current.impairment
+        delay = imp.latency_ms + self.rng.uniform(-imp.jitter_ms, imp.jitter_ms)
+
+        if imp.reorder_prob and self.rng.random() < imp.reorder_prob:
+            delay += imp.reorder_delay_ms
+            self.stats['held_segments'] += 1
+
+        release = now + max(0.0, delay) / 1000.0
+
+        if imp.bandwidth_kbps:
+            # Serialize on the link after whatever is already in flight
+            transmit = size * 8 / (imp.bandwidth_kbps * 1000.0)
+            release = max(release, state['link_free_at']) + transmit
+            state['link_free_at'] = release
+
+        # TCP is in-order: a held segment stalls everything behind it
+        release = max(release, state['last_release'])
+        state['last_release'] = release
+
+        self.stats['segments'] += 1
+        self.stats['added_delay_ms_total'] += (release - now) * 1000.0
+        return release
+
+    async def _pipe(self, reader, writer, direction: str, conn):
+        queue = asyncio.Queue()
+        state = {'link_free_at': 0.0, 'last_release': 0.0, 'buffered': 0}
+        space = asyncio.Event()
+        space.set()
+
+        async def pump_in():
+            while True:
+                data = await reader.read(16384)
+                if not data:
+                    await queue.put(None)
+                    return
+                await space.wait()
+                now = time.monotonic()
+                await queue.put((self._release_time(state, len(data), now), data))
+                state['buffered'] += len(data)
+                if state['buffered'] >= self.max_buffer:
+                    space.clear()
+
+        async def pump_out():
+            while True:
+                item = await queue.get()
+                if item is None:
+                    writer.close()
+                    return
+                release, data = item
+                wait = release - time.monotonic()
+                if wait > 0:
+                    await asyncio.sleep(wait)
+                writer.write(data)
+                await writer.drain()
+                self.stats[f"bytes_{direction}"] += len(data)
+                state['buffered'] -= len(data)
+                if state['buffered'] < self.max_buffer:
+                    space.set()
+
+        tasks = [asyncio.create_task(pump_in()), asyncio.create_task(pump_out())]
+        conn['tasks'].extend(tasks)
+        try:
+            await asyncio.gather(*tasks)
+        except (ConnectionError, asyncio.CancelledError):
+            pass
+        finally:
+            # gather() does not cancel the surviving pump when the other fails
+            for task in tasks:
+                task.cancel()
+
+    async def _handle(self, client_reader, client_writer):
+        try:
+            server_reader, server_writer = await asyncio.open_connection(self.target_host, self.target_port)
+        except OSError as e:
+            print(f"Proxy could not reach {self.target_host}:{self.target_port}: {e}")
+            client_writer.close()
+            return
+
+        conn = {'writers': (client_writer, server_writer), 'tasks': []}
+        self.stats['connections'] += 1
+        self._conns[id(conn)] = conn
+
+        watcher = asyncio.create_task(self._random_disconnects(conn))
+        conn['tasks'].append(watcher)
+        try:
+            await asyncio.gather(
+                self._pipe(client_reader, server_writer, 'up', conn),
+                self._pipe(server_reader, client_writer, 'down', conn),
+                return_exceptions=True
+            )
+        except asyncio.CancelledError:
+            pass
+        finally:
+            watcher.cancel()
+            self._conns.pop(id(conn), None)
+            for w in conn['writers']:
+                w.close()
+
+    async def _random_disconnects(self, conn):
+        while True:
+            rate = self.current.impairment.disconnects_per_min
+            if rate <= 0:
+                await asyncio.sleep(1.0)
+                continue
+            await asyncio.sleep(self.rng.expovariate(rate / 60.0))
+            if self.current.impairment.disconnects_per_min > 0:
+                self._drop(conn)
+                return
+
+    def _drop(self, conn):
+        self.stats['disconnects'] += 1
+        for task in conn['tasks']:
+            task.cancel()
+        for w in conn['writers']:
+            w.close()
+
+    async def _run_script(self):
+        while True:
+            for i, phase in enumerate(self.phases):
+                self.current = phase
+                print(f"[proxy :{self.listen_port}] phase {asdict(phase.impairment)}"
+                      f"{' + disconnect' if phase.disconnect else ''}")
+                if phase.disconnect:
+                    for conn in list(self._conns.values()):
+                        self._drop(conn)
+                if phase.duration <= 0:
+                    if i == len(self.phases) - 1:
+                        return  # hold the last phase forever
+                    continue
+                await asyncio.sleep(phase.duration)
+
+    def report(self) -> Dict:
+        segments = max(1, self.stats['segments'])
+        report = dict(self.stats)
+        report['avg_added_delay_ms'] = round(self.stats['added_delay_ms_total'] / segments, 2)
+        report['open_connections'] = len(self._conns)
+        return report
+
+    async def serve(self):
+        server = await asyncio.start_server(self._handle, '127.0.0.1', self.listen_port)
+        print(f"Impairment proxy 127.0.0.1:{self.listen_port} -> {self.target_host}:{self.target_port}")
+        async with server:
+            await asyncio.gather(server.serve_forever(), self._run_script())
+
+
+async def run_routes(routes: List[str], phases: List[Phase], report_every: float, seed: Optional[int]):
+    proxies = []
+    for route in routes:
+        listen, host, port = route.split(':')
+        proxies.append(ImpairmentProxy(int(listen), host, int(port), phases, seed=seed))
+
+    async def reporter():
+        while True:
+            await asyncio.sleep(report_every)
+            for proxy in proxies:
+                print(f"[proxy :{proxy.listen_port}] {json.dumps(proxy.report())}")
+
+    await asyncio.gather(reporter(), *(p.serve() for p in proxies))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Network impairment proxy')
+    parser.add_argument('--route', action='append', required=True,
+                        help='listen_port:target_host:target_port, e.g. 7868:localhost:6868 (repeatable)')
+    parser.add_argument('--profile', default='clean',
+                        help=f"Named profile ({', '.join(PROFILES)}) or path to a JSON script")
+    parser.add_argument('--latency', type=float, help='Override latency (ms)')
+    parser.add_argument('--jitter', type=float, help='Override jitter (ms)')
+    parser.add_argument('--bandwidth', type=float, help='Override bandwidth cap (kbps)')
+    parser.add_argument('--report-every', type=float, default=10.0)
+    parser.add_argument('--seed', type=int)
+    args = parser.parse_args()
+
+    phases = load_profile(args.profile)
+    for phase in phases:
+        if args.latency is not None:
+            phase.impairment.latency_ms = args.latency
+        if args.jitter is not None:
+            phase.impairment.jitter_ms = args.jitter
+        if args.bandwidth is not None:
+            phase.impairment.bandwidth_kbps = args.bandwidth
+
+    try:
+        asyncio.run(run_routes(args.route, phases, args.report_every, args.seed))
+    except KeyboardInterrupt:
+        print("\nProxy stopped")
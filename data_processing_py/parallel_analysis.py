@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""
+Parallel Per-Session Analysis
+
+Runs each session's analysis (emotion classification, EEG band power, JSON
+encoding) on its own worker thread with its own EmotionAnalyzer, so sessions
+share nothing mutable. On a free-threaded interpreter (python3.13t and
+later, GIL disabled) these threads run truly in parallel; on a regular
+build they still work but serialize on the GIL, which the benchmark makes
+visible.
+
+    python parallel_analysis.py            # scaling benchmark
+    python3.13t parallel_analysis.py       # same, without the GIL
+"""
+
+import os
+import sys
+import json
+import time
+import queue
+import sysconfig
+import threading
+import numpy as np
+from typing import Callable, Dict, Optional
+
+from emotion_analyzer import EmotionAnalyzer
+
+# Emotiv POW bands (Hz)
+BANDS = (('theta', 4, 8), ('alpha', 8, 12), ('betaL', 12, 16), ('betaH', 16, 25), ('gamma', 25, 45))
+
+
+def gil_status() -> Dict[str, bool]:
+    """Whether this interpreter is a free-threaded build and whether the GIL is off."""
+    free_threaded_build = bool(sysconfig.get_config_var('Py_GIL_DISABLED'))
+    is_gil_enabled = getattr(sys, '_is_gil_enabled', None)
+    return {
+        'free_threaded_build': free_threaded_build,
+        # A free-threaded build can still re-enable the GIL (PYTHON_GIL=1 or
+        # an extension module that does not declare support)
+        'gil_enabled': is_gil_enabled() if is_gil_enabled else True
+    }
+
+
+def band_powers(eeg: np.ndarray, fs: float = 128.0) -> np.ndarray:
+    """
+    Band power per channel from one EEG window.
+
+    Args:
+        eeg: (channels, samples) window in microvolts
+        fs: Sampling rate
+
+    Returns:
+        (channels, len(BANDS)) mean power per band
+    """
+    window = np.hanning(eeg.shape[1])
+    centered = eeg - eeg.mean(axis=1, keepdims=True)
+    spectrum = np.abs(np.fft.rfft(centered * window, axis=1)) ** 2
+    freqs = np.fft.rfftfreq(eeg.shape[1], 1.0 / fs)
+    return np.stack([spectrum[:, (freqs >= lo) & (freqs < hi)].mean(axis=1) for _, lo, hi in BANDS], axis=1)
+
+
+class SessionAnalysis:
+    """
+    All analysis state for one session; not shared with any other session.
+
+    Items are dicts with 'time' and optionally 'met' (13 values, Cortex order)
+    and 'eeg' ((channels, samples) window).
+    """
+
+    def __init__(self, session_id: str):
+        self.session_id = session_id
+        self.analyzer = EmotionAnalyzer()
+        self.processed = 0
+
+    def process(self, item: Dict) -> str:
+        """Analyze one item and return the encoded event."""
+        event = {'session_id': self.session_id, 'timestamp': item['time']}
+
+        met = item.get('met')
+        if met is not None:
+            metrics = {
+                'engagement': met[1] if met[0] else 0.0,
+                'excitement': met[3] if met[2] else 0.0,
+                'stress': met[6] if met[5] else 0.0,
+                'relaxation': met[8] if met[7] else 0.0,
+                'interest': met[10] if met[9] else 0.0
+            }
+            event.update(self.analyzer.analyze_emotion(metrics, item['time']))
+
+        eeg = item.get('eeg')
+        if eeg is not None:
+            powers = band_powers(eeg)
+            event['band_power'] = {name: round(float(v), 3) for (name, _, _), v in zip(BANDS, powers.mean(axis=0))}
+
+        self.processed += 1
+        return json.dumps(event)
+
+
+class SessionWorker:
+    """
+    Worker thread processing one session's items in order.
+
+    Results are JSON strings handed to the output callback from this
+    worker's thread.
+    """
+
+    def __init__(self, session_id: str, output_callback: Optional[Callable[[str, str], None]] = None,
+                 max_queue: int = 1000):
+        self.session_id = session_id
+        self.output_callback = output_callback
+        self.analysis = SessionAnalysis(session_id)
+        self.queue = queue.Queue(maxsize=max_queue)
+        self._thread = threading.Thread(target=self._run, name=f"Session-{session_id}", daemon=True)
+        self._thread.start()
+
+    def submit(self, item: Dict):
+        self.queue.put(item)
+
+    def _run(self):
+        while True:
+            item = self.queue.get()
+            if item is None:
+                return
+            try:
+                message = self.analysis.process(item)
+                if self.output_callback:
+                    self.output_callback(self.session_id, message)
+            except (KeyError, ValueError, IndexError) as e:
+                print(f"Error analyzing session {self.session_id}: {e}")
+
+    def close(self, timeout: float = 5.0):
+        self.queue.put(None)
+        self._thread.join(timeout)
+
+
+class ParallelSessionAnalyzer:
+    """
+    Routes samples to one SessionWorker per session.
+
+    Usage:
+        pool = ParallelSessionAnalyzer(output_callback=send)
+        pool.submit("s1", {'time': t, 'met': met_values})
+    """
+
+    def __init__(self, output_callback: Optional[Callable[[str, str], None]] = None):
+        self.output_callback = output_callback
+        self.workers: Dict[str, SessionWorker] = {}
+        self._lock = threading.Lock()
+
+        status = gil_status()
+        if status['gil_enabled']:
+            print("Note: GIL is enabled; session workers will not run in parallel. "
+                  "Use a free-threaded interpreter (e.g. python3.13t) to scale across cores.")
+
+    def submit(self, session_id: str, item: Dict):
+        worker = self.workers.get(session_id)
+        if worker is None:
+            with self._lock:
+                worker = self.workers.get(session_id)
+                if worker is None:
+                    worker = self.workers[session_id] = SessionWorker(session_id, self.output_callback)
+        worker.submit(item)
+
+    def end_session(self, session_id: str):
+        with self._lock:
+            worker = self.workers.pop(session_id, None)
+        if worker:
+            worker.close()
+
+    def close(self):
+        for session_id in list(self.workers):
+            self.end_session(session_id)
+
+
+def benchmark(events_per_session: int = 2000, max_threads: Optional[int] = None) -> Dict[int, float]:
+    """
+    Throughput (events/s) with 1, 2, 4, ... threads, one session per thread.
+
+    Every event carries met data plus a 1 s, 5-channel EEG window, so each
+    includes classification, an FFT and JSON encoding.
+    """
+    max_threads = max_threads or os.cpu_count() or 1
+    rng = np.random.default_rng(0)
+    met = [1, 0.6, 1, 0.4, 0.5, 1, 0.7, 1, 0.3, 1, 0.5, 1, 0.6]
+    eeg = rng.normal(4200, 20, (5, 128))
+
+    def run_session(session_id: str):
+        analysis = SessionAnalysis(session_id)
+        for i in range(events_per_session):
+            analysis.process({'time': float(i), 'met': met, 'eeg': eeg})
+
+    results = {}
+    threads = 1
+    while threads <= max_threads:
+        pool = [threading.Thread(target=run_session, args=(f"bench-{i}",)) for i in range(threads)]
+        start = time.perf_counter()
+        for t in pool:
+            t.start()
+        for t in pool:
+            t.join()
+        elapsed = time.perf_counter() - start
+        results[threads] = threads * events_per_session / elapsed
+        threads *= 2
+    return results
+
+
+if __name__ == "__main__":
+    status = gil_status()
+    print(f"Python {sys.version.split()[0]}, free-threaded build: {status['free_threaded_build']}, "
+          f"GIL enabled: {status['gil_enabled']}, cores: {os.cpu_count()}")
+
+    results = benchmark()
+    base = results[1]
+    for threads, rate in results.items():
+        print(f"{threads:>3} threads: {rate:>9.0f} events/s  "
+              f"speedup {rate / base:4.2f}x  efficiency {rate / base / threads:4.0%}")
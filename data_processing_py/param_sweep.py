@@ -0,0 +1,459 @@
+#!/usr/bin/env python3
+"""
+Vectorized Parameter Sweep for EmotionAnalyzer Tuning
+
+Evaluates a whole grid of analyzer settings against archived sessions. The
+alternative is re-running CSVReplayEngine.batch_analyze once per setting per
+file, at roughly 1,000 settings x every session of the archive.
+
+The grid is the product of five axes:
+
+    prototypes           emotion prototype matrices (EMOTION_VECTORS variants)
+    min_change_threshold hysteresis: keep the current emotion unless the new
+                         winner's score leads it by at least this much
+    smoothing_window     batch_analyze's majority-vote window (1 = off)
+    crisis_weights       (stress, 1 - relaxation) weights of the crisis level
+    crisis_threshold     crisis level above which an alert (needs_intervention)
+                         is raised
+
+Labels depend only on the first three axes and alerts only on the last two.
+Each session is therefore scored once per prototype variant, in one
+broadcasted pass over all samples. Every label setting and alert setting is
+evaluated from those scores, and the per-setting metrics are broadcast back
+over the full grid. Sessions are spread across worker processes.
+
+The reference setting is what the analyzer does today: its own prototypes, no
+hysteresis (min_change_threshold is stored but not applied), batch_analyze's
+default window of 10, crisis weights (0.7, 0.3) and alerts above 0.7 (the
+needs_intervention cut-off; crisis_threshold is stored but not applied).
+Labels and alerts for that setting match batch_analyze exactly.
+
+    python param_sweep.py                        # 1,000-point synthetic benchmark
+    python param_sweep.py recorded_samples/*.csv --out sweep.csv
+"""
+
+import os
+import csv
+import time
+import itertools
+import numpy as np
+from concurrent.futures import ProcessPoolExecutor
+from typing import Dict, List, Optional, Sequence, Tuple, Union
+
+from emotion_analyzer import EmotionAnalyzer
+
+EMOTION_NAMES = EmotionAnalyzer.EMOTION_NAMES
+REFERENCE_PROTOTYPES = np.array(EmotionAnalyzer._EMOTION_MATRIX)
+NEGATIVE_MASK = np.array([name in EmotionAnalyzer.NEGATIVE_EMOTIONS for name in EMOTION_NAMES])
+STRESS = EmotionAnalyzer.METRIC_NAMES.index('stress')
+RELAXATION = EmotionAnalyzer.METRIC_NAMES.index('relaxation')
+
+AXES = ('prototypes', 'min_change_threshold', 'smoothing_window', 'crisis_weights', 'crisis_threshold')
+REFERENCE = {
+    'prototypes': ('reference', REFERENCE_PROTOTYPES),
+    'min_change_threshold': 0.0,
+    'smoothing_window': 10,
+    'crisis_weights': (0.7, 0.3),
+    'crisis_threshold': 0.7,
+}
+
+# A session is an archived CSV path or (timestamps, metrics) with metric
+# columns in EmotionAnalyzer.METRIC_NAMES order (attention may be missing)
+Session = Union[str, Tuple[np.ndarray, np.ndarray]]
+
+
+def scale_prototypes(factor: float, prototypes: np.ndarray = REFERENCE_PROTOTYPES) -> np.ndarray:
+    """
+    Pull prototypes towards neutral (factor < 1) or push them apart (factor > 1).
+
+    Args:
+        factor: Scale of each prototype's offset from 0.5
+        prototypes: (emotions, metrics) matrix to scale
+
+    Returns:
+        Scaled matrix, clipped to [0, 1]; factor 1 returns an exact copy so
+        score ties resolve as in the analyzer
+    """
+    if factor == 1:
+        return np.array(prototypes)
+    return np.clip(0.5 + (prototypes - 0.5) * factor, 0, 1)
+
+
+class SweepGrid:
+    """
+    Parameter axes of a sweep; every axis defaults to the reference value.
+
+    Usage:
+        grid = SweepGrid(smoothing_window=[1, 5, 10, 20],
+                         crisis_threshold=[0.6, 0.7, 0.8])
+        result = run_sweep(sessions, grid)
+    """
+
+    def __init__(self, prototypes: Optional[Sequence[Tuple[str, np.ndarray]]] = None,
+                 min_change_threshold: Optional[Sequence[float]] = None,
+                 smoothing_window: Optional[Sequence[int]] = None,
+                 crisis_weights: Optional[Sequence[Tuple[float, float]]] = None,
+                 crisis_threshold: Optional[Sequence[float]] = None):
+        """
+        Initialize grid.
+
+        Args:
+            prototypes: (name, matrix) pairs; matrices are shaped like
+                EmotionAnalyzer._EMOTION_MATRIX
+            min_change_threshold: Hysteresis margins (0 = off)
+            smoothing_window: Majority-vote windows in samples (1 = off)
+            crisis_weights: (stress weight, 1 - relaxation weight) pairs
+            crisis_threshold: Alert thresholds on the crisis level
+        """
+        self.prototypes = list(prototypes or [REFERENCE['prototypes']])
+        self.min_change_threshold = list(min_change_threshold or [REFERENCE['min_change_threshold']])
+        self.smoothing_window = list(smoothing_window or [REFERENCE['smoothing_window']])
+        self.crisis_weights = list(crisis_weights or [REFERENCE['crisis_weights']])
+        self.crisis_threshold = list(crisis_threshold or [REFERENCE['crisis_threshold']])
+
+        self.prototype_matrix = np.stack([np.asarray(matrix, dtype=np.float64) for _, matrix in self.prototypes])
+        if self.prototype_matrix.shape[1:] != REFERENCE_PROTOTYPES.shape:
+            raise ValueError(f"prototype matrices must be shaped {REFERENCE_PROTOTYPES.shape}")
+
+    @property
+    def shape(self) -> Tuple[int, ...]:
+        return tuple(len(getattr(self, axis)) for axis in AXES)
+
+    @property
+    def size(self) -> int:
+        return int(np.prod(self.shape))
+
+    def setting(self, index: Tuple[int, ...]) -> Dict:
+        """Parameter values at a grid index (prototypes by name)."""
+        values = {axis: getattr(self, axis)[i] for axis, i in zip(AXES, index)}
+        values['prototypes'] = values['prototypes'][0]
+        return values
+
+
+def _emotion_scores(metrics: np.ndarray, prototypes: np.ndarray) -> np.ndarray:
+    """
+    (variants, samples, emotions) similarity scores.
+
+    Accumulated metric by metric like EmotionAnalyzer._calculate_emotion_scores
+    so results (and argmax ties) are bit-identical.
+    """
+    columns = metrics.shape[1]
+    scores = np.zeros((prototypes.shape[0], metrics.shape[0], prototypes.shape[1]))
+    for i in range(columns):
+        scores += 1 - np.abs(metrics[None, :, i, None] - prototypes[:, None, :, i])
+    return scores / columns
+
+
+def _hysteresis_labels(scores: np.ndarray, dominant: np.ndarray, variants: np.ndarray,
+                       thresholds: np.ndarray) -> np.ndarray:
+    """
+    Labels with hysteresis for several (prototype variant, threshold) settings.
+
+    The scan is sequential in time but vectorized over settings.
+    """
+    top = np.take_along_axis(scores, dominant[..., None], axis=2)[..., 0]
+    candidates = dominant[variants]
+    leads = top[variants]
+    labels = np.empty_like(candidates)
+    current = labels[:, 0] = candidates[:, 0]
+    for t in range(1, candidates.shape[1]):
+        switch = leads[:, t] - scores[variants, t, current] >= thresholds
+        current = labels[:, t] = np.where(switch, candidates[:, t], current)
+    return labels
+
+
+def _majority_smooth(labels: np.ndarray, windows: Sequence[int], emotions: int) -> np.ndarray:
+    """
+    (windows, samples) majority-vote smoothing of one label sequence.
+
+    Same window and tie rule as CSVReplayEngine._smooth_emotions: a centered
+    window of window // 2 samples either side, clipped at the ends, and ties go
+    to the emotion that appears first in the window.
+    """
+    n = len(labels)
+    onehot = np.zeros((n, emotions), dtype=np.int32)
+    onehot[np.arange(n), labels] = 1
+    counts = np.zeros((n + 1, emotions), dtype=np.int32)
+    np.cumsum(onehot, axis=0, out=counts[1:])
+
+    # First occurrence of each emotion at or after every position
+    first = np.where(onehot, np.arange(n)[:, None], n)
+    first = np.minimum.accumulate(first[::-1], axis=0)[::-1]
+
+    positions = np.arange(n)
+    smoothed = np.empty((len(windows), n), dtype=labels.dtype)
+    for w, window in enumerate(windows):
+        if window <= 1 or n < window:
+            smoothed[w] = labels
+            continue
+        lo = np.maximum(0, positions - window // 2)
+        hi = np.minimum(n, positions + window // 2 + 1)
+        in_window = counts[hi] - counts[lo]
+        tied = in_window == in_window.max(axis=1, keepdims=True)
+        smoothed[w] = np.argmin(np.where(tied, first[lo], n + 1), axis=1)
+    return smoothed
+
+
+def _label_sets(metrics: np.ndarray, grid: SweepGrid) -> np.ndarray:
+    """(variants, min_change, windows, samples) emotion labels for one session."""
+    prototypes = grid.prototype_matrix[:, :, :metrics.shape[1]]
+    scores = _emotion_scores(metrics, prototypes)
+    dominant = np.argmax(scores, axis=2)
+
+    variants, margins = len(grid.prototypes), len(grid.min_change_threshold)
+    raw = np.empty((variants, margins, metrics.shape[0]), dtype=dominant.dtype)
+    thresholds = np.array(grid.min_change_threshold, dtype=np.float64)
+    raw[:, thresholds <= 0] = dominant[:, None]
+    held = np.flatnonzero(thresholds > 0)
+    if len(held):
+        v, m = np.meshgrid(np.arange(variants), held, indexing='ij')
+        raw[v.ravel(), m.ravel()] = _hysteresis_labels(scores, dominant, v.ravel(), thresholds[m.ravel()])
+
+    labels = np.empty((variants, margins, len(grid.smoothing_window), metrics.shape[0]), dtype=dominant.dtype)
+    for v, m in itertools.product(range(variants), range(margins)):
+        labels[v, m] = _majority_smooth(raw[v, m], grid.smoothing_window, len(EMOTION_NAMES))
+    return labels
+
+
+def _alert_sets(metrics: np.ndarray, grid: SweepGrid) -> np.ndarray:
+    """(weights, thresholds, samples) alert flags for one session."""
+    weights = np.array(grid.crisis_weights, dtype=np.float64)
+    stress = metrics[:, STRESS]
+    relaxation = metrics[:, RELAXATION]
+    # Same expression as EmotionAnalyzer._calculate_crisis_level
+    crisis = np.minimum(1.0, (stress * weights[:, :1]) + ((1 - relaxation) * weights[:, 1:]))
+    return crisis[:, None, :] > np.array(grid.crisis_threshold)[None, :, None]
+
+
+def load_session(session: Session) -> Tuple[np.ndarray, np.ndarray]:
+    """Timestamps and clamped metrics of a session, in recorded order."""
+    if isinstance(session, str):
+        from csv_replay import CSVReplayEngine
+        return CSVReplayEngine(session).metrics_matrix()
+    timestamps, metrics = session
+    return np.asarray(timestamps, dtype=np.float64), np.clip(np.asarray(metrics, dtype=np.float64), 0, 1)
+
+
+def evaluate_session(session: Session, grid: SweepGrid) -> Optional[Dict[str, np.ndarray]]:
+    """
+    Metric counts of every grid setting on one session.
+
+    Returns:
+        Counts shaped by the label axes (agree, switches, negative) or the
+        alert axes (alerts, alert_agree, alert_onsets), plus samples and
+        seconds; None if the session has no usable metrics
+    """
+    timestamps, metrics = load_session(session)
+    if len(timestamps) == 0 or metrics.shape[1] <= RELAXATION:
+        return None
+
+    reference = SweepGrid()
+    reference_labels = _label_sets(metrics, reference)[0, 0, 0]
+    reference_alerts = _alert_sets(metrics, reference)[0, 0]
+
+    labels = _label_sets(metrics, grid)
+    alerts = _alert_sets(metrics, grid)
+    onsets = alerts[..., 0] + (alerts[..., 1:] & ~alerts[..., :-1]).sum(axis=-1)
+    return {
+        'agree': (labels == reference_labels).sum(axis=-1),
+        'switches': (labels[..., 1:] != labels[..., :-1]).sum(axis=-1),
+        'negative': NEGATIVE_MASK[labels].sum(axis=-1),
+        'alerts': alerts.sum(axis=-1),
+        'alert_agree': (alerts == reference_alerts).sum(axis=-1),
+        'alert_onsets': onsets,
+        'samples': np.int64(len(timestamps)),
+        'seconds': float(timestamps.max() - timestamps.min()),
+    }
+
+
+# Worker processes receive the grid once, not with every session
+_worker_grid: Optional[SweepGrid] = None
+
+
+def _init_worker(grid: SweepGrid):
+    global _worker_grid
+    _worker_grid = grid
+
+
+def _evaluate_in_worker(session: Session):
+    return evaluate_session(session, _worker_grid)
+
+
+def run_sweep(sessions: Sequence[Session], grid: SweepGrid, workers: Optional[int] = None) -> Dict:
+    """
+    Evaluate every grid setting against every session.
+
+    Args:
+        sessions: CSV paths and/or (timestamps, metrics) pairs
+        grid: Parameter axes
+        workers: Worker processes (default: CPU count; 1 runs inline)
+
+    Returns:
+        Dictionary with the grid, per-setting metric arrays shaped grid.shape
+        (agreement, negative_rate, switches_per_minute, alert_rate,
+        alert_agreement, alerts_per_hour), and totals
+    """
+    workers = workers or os.cpu_count() or 1
+    start = time.perf_counter()
+    totals = None
+    evaluated = 0
+
+    if workers == 1:
+        results = (evaluate_session(session, grid) for session in sessions)
+        executor = None
+    else:
+        executor = ProcessPoolExecutor(workers, initializer=_init_worker, initargs=(grid,))
+        results = executor.map(_evaluate_in_worker, sessions, chunksize=max(1, len(sessions) // (workers * 4)))
+    try:
+        for counts in results:
+            if counts is None:
+                continue
+            evaluated += 1
+            if totals is None:
+                totals = {key: np.array(value, dtype=np.float64) for key, value in counts.items()}
+            else:
+                for key, value in counts.items():
+                    totals[key] += value
+    finally:
+        if executor is not None:
+            executor.shutdown()
+
+    if totals is None:
+        print("No session had usable performance metrics")
+        return {'grid': grid, 'sessions': 0, 'samples': 0, 'seconds': 0.0, 'metrics': {},
+                'elapsed': round(time.perf_counter() - start, 3)}
+
+    samples, seconds = float(totals['samples']), float(totals['seconds'])
+    minutes, hours = max(seconds / 60, 1e-9), max(seconds / 3600, 1e-9)
+    label_axes = (slice(None),) * 3 + (None, None)
+    alert_axes = (None,) * 3 + (slice(None),) * 2
+    metrics = {
+        'agreement': totals['agree'][label_axes] / samples,
+        'negative_rate': totals['negative'][label_axes] / samples,
+        'switches_per_minute': totals['switches'][label_axes] / minutes,
+        'alert_rate': totals['alerts'][alert_axes] / samples,
+        'alert_agreement': totals['alert_agree'][alert_axes] / samples,
+        'alerts_per_hour': totals['alert_onsets'][alert_axes] / hours,
+    }
+    metrics = {name: np.broadcast_to(values, grid.shape) for name, values in metrics.items()}
+    return {
+        'grid': grid,
+        'sessions': evaluated,
+        'samples': int(samples),
+        'seconds': round(seconds, 1),
+        'metrics': metrics,
+        'elapsed': round(time.perf_counter() - start, 3),
+    }
+
+
+def sweep_rows(result: Dict) -> List[Dict]:
+    """One flat row per grid setting: parameters followed by metrics."""
+    grid, metrics = result['grid'], result['metrics']
+    rows = []
+    for index in np.ndindex(grid.shape):
+        row = grid.setting(index)
+        row['crisis_weights'] = '/'.join(f"{w:g}" for w in row['crisis_weights'])
+        row.update({name: round(float(values[index]), 4) for name, values in metrics.items()})
+        rows.append(row)
+    return rows
+
+
+def write_csv(result: Dict, path: str):
+    """Write sweep_rows to a CSV file."""
+    rows = sweep_rows(result)
+    if not rows:
+        return
+    with open(path, 'w', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=list(rows[0]))
+        writer.writeheader()
+        writer.writerows(rows)
+
+
+def synthetic_archive(sessions: int = 100, duration: float = 3600.0, seed: int = 1) -> List[Tuple[np.ndarray, np.ndarray]]:
+    """
+    (timestamps, metrics) sessions from the synthetic session generator.
+
+    Args:
+        sessions: Number of sessions (one virtual user each)
+        duration: Seconds per session
+        seed: Random seed
+
+    Returns:
+        Sessions with all six metrics at 2 Hz
+    """
+    from synthetic_sessions import SyntheticSessionGenerator
+
+    times, rows = [], []
+
+    def collect(stream, session_ids, batch_times, values):
+        times.append(batch_times)
+        rows.append(values[:, :, [1, 3, 6, 8, 10, 12]])  # met order -> METRIC_NAMES
+
+    generator = SyntheticSessionGenerator(users=sessions, seed=seed, streams=('met',), batch_sink=collect)
+    generator.run(duration, start_time=1.7e9)
+    timestamps = np.concatenate(times)
+    metrics = np.concatenate(rows, axis=1)
+    return [(timestamps, metrics[i]) for i in range(sessions)]
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(description='Parameter sweep for EmotionAnalyzer tuning')
+    parser.add_argument('csv_files', nargs='*', help='Archived Emotiv CSVs (default: synthetic archive)')
+    parser.add_argument('--sessions', type=int, default=100, help='Synthetic sessions')
+    parser.add_argument('--duration', type=float, default=3600.0, help='Seconds per synthetic session')
+    parser.add_argument('--workers', type=int, default=None)
+    parser.add_argument('--out', help='Write one row per setting to this CSV')
+    args = parser.parse_args()
+
+    # 5 x 4 x 5 x 5 x 2 = 1,000 settings
+    grid = SweepGrid(
+        prototypes=[(f"scale{factor:g}", scale_prototypes(factor)) for factor in (0.8, 0.9, 1.0, 1.1, 1.2)],
+        min_change_threshold=[0.0, 0.01, 0.02, 0.05],
+        smoothing_window=[1, 5, 10, 20, 40],
+        crisis_weights=[(0.5, 0.5), (0.6, 0.4), (0.7, 0.3), (0.8, 0.2), (0.9, 0.1)],
+        crisis_threshold=[0.7, 0.8],
+    )
+
+    if args.csv_files:
+        archive = args.csv_files
+    else:
+        start = time.perf_counter()
+        archive = synthetic_archive(args.sessions, args.duration)
+        print(f"Generated {len(archive)} synthetic sessions x {args.duration:.0f}s "
+              f"in {time.perf_counter() - start:.1f}s")
+
+    print(f"=== Sweeping {grid.size} settings over {len(archive)} sessions ===")
+    result = run_sweep(archive, grid, workers=args.workers)
+    if not result['sessions']:
+        raise SystemExit(1)
+    print(f"{result['sessions']} sessions, {result['samples']} samples ({result['seconds'] / 3600:.1f}h) "
+          f"in {result['elapsed']:.1f}s")
+
+    # What the per-setting batch_analyze loop would have cost
+    timestamps, metrics = load_session(archive[0])
+    names = EmotionAnalyzer.METRIC_NAMES[:metrics.shape[1]]
+    analyzer = EmotionAnalyzer()
+    start = time.perf_counter()
+    for t, row in zip(timestamps.tolist(), metrics.tolist()):
+        analyzer.analyze_emotion(dict(zip(names, row)), t)
+    per_sample = (time.perf_counter() - start) / len(timestamps)
+    naive = per_sample * result['samples'] * grid.size
+    print(f"Per-setting analyze_emotion loop would take ~{naive / 3600:.1f}h "
+          f"({naive / result['elapsed']:.0f}x slower)")
+
+    rows = sweep_rows(result)
+    reference = next(row for row in rows if row['prototypes'] == 'scale1' and row['min_change_threshold'] == 0.0
+                     and row['smoothing_window'] == 10 and row['crisis_weights'] == '0.7/0.3'
+                     and row['crisis_threshold'] == 0.7)
+    print(f"\nReference setting: {reference}")
+
+    print("\nFewest alerts per hour with >= 90% label and alert agreement:")
+    candidates = [row for row in rows if row['agreement'] >= 0.9 and row['alert_agreement'] >= 0.9]
+    for row in sorted(candidates, key=lambda r: (r['alerts_per_hour'], r['switches_per_minute']))[:5]:
+        print(f"  {row}")
+
+    if args.out:
+        write_csv(result, args.out)
+        print(f"\nWrote {len(rows)} settings to {args.out}")
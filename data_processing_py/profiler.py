@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""
+On-demand Sampling Profiler
+
+Low-overhead, in-process stack sampler that can be triggered on a running
+pipeline (emotion server, synthesis worker) through a local HTTP control
+endpoint. Every Python thread is sampled, including the websocket-client
+reader thread, the asyncio event loop and any thread driving torch.
+
+Output is collapsed-stack text (one "frame;frame;frame count" line per unique
+stack), which can be fed directly to flamegraph.pl or speedscope.
+"""
+
+import sys
+import json
+import time
+import threading
+from collections import Counter
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Dict, Optional
+from urllib.parse import urlparse, parse_qs
+
+
+class SamplingProfiler:
+    """
+    Samples the stacks of all live threads at a fixed rate.
+
+    Sampling only happens while a profile is being collected, so an idle
+    profiler costs nothing. Native threads without a Python frame (e.g. torch
+    intra-op workers) show up under the Python thread that called into them.
+    """
+
+    MAX_SECONDS = 120.0
+    MAX_HZ = 1000
+
+    def __init__(self):
+        self._lock = threading.Lock()
+
+    def profile(self, seconds: float = 5.0, hz: int = 100) -> Dict[str, Counter]:
+        """
+        Collect samples for the given duration.
+
+        Args:
+            seconds: How long to sample for
+            hz: Sampling frequency
+
+        Returns:
+            Mapping of thread name to a Counter of collapsed stacks
+        """
+        seconds = max(0.1, min(float(seconds), self.MAX_SECONDS))
+        hz = max(1, min(int(hz), self.MAX_HZ))
+        interval = 1.0 / hz
+
+        # Only one profile at a time; concurrent requests would skew each other
+        if not self._lock.acquire(blocking=False):
+            raise RuntimeError("A profile is already being collected")
+
+        try:
+            stacks: Dict[str, Counter] = {}
+            own_ident = threading.get_ident()
+            deadline = time.perf_counter() + seconds
+            next_tick = time.perf_counter()
+
+            while next_tick < deadline:
+                names = {t.ident: t.name for t in threading.enumerate()}
+
+                for ident, frame in sys._current_frames().items():
+                    if ident == own_ident:
+                        continue
+                    thread_name = names.get(ident, f"thread-{ident}")
+                    stack = self._collapse(frame)
+                    stacks.setdefault(thread_name, Counter())[stack] += 1
+
+                next_tick += interval
+                delay = next_tick - time.perf_counter()
+                if delay > 0:
+                    time.sleep(delay)
+                else:
+                    # Fell behind (e.g. GIL contention); don't try to catch up
+                    next_tick = time.perf_counter()
+
+            return stacks
+        finally:
+            self._lock.release()
+
+    @staticmethod
+    def _collapse(frame) -> str:
+        """Render a frame chain as a root-first, semicolon-separated stack."""
+        parts = []
+        while frame is not None:
+            code = frame.f_code
+            filename = code.co_filename.rsplit('/', 1)[-1]
+            parts.append(f"{code.co_name} ({filename}:{frame.f_lineno})")
+            frame = frame.f_back
+        parts.reverse()
+        return ';'.join(parts)
+
+    @staticmethod
+    def to_collapsed(stacks: Dict[str, Counter]) -> str:
+        """Format samples as collapsed stacks, rooted at the thread name."""
+        lines = []
+        for thread_name, counter in stacks.items():
+            root = thread_name.replace(';', '_').replace(' ', '_')
+            for stack, count in counter.most_common():
+                lines.append(f"{root};{stack} {count}")
+        return '\n'.join(lines) + '\n'
+
+    @staticmethod
+    def to_summary(stacks: Dict[str, Counter]) -> Dict:
+        """Per-thread sample totals and hottest leaf frames."""
+        summary = {}
+        for thread_name, counter in stacks.items():
+            leaves = Counter()
+            for stack, count in counter.items():
+                leaves[stack.rsplit(';', 1)[-1]] += count
+            summary[thread_name] = {
+                'samples': sum(counter.values()),
+                'top_frames': leaves.most_common(10)
+            }
+        return summary
+
+
+class ProfilerServer:
+    """
+    Local HTTP control endpoint for the sampling profiler.
+
+    Endpoints:
+        GET /profile?seconds=5&hz=100             collapsed stacks (text/plain)
+        GET /profile?seconds=5&format=json        per-thread summary (JSON)
+        GET /threads                              live thread names (JSON)
+    """
+
+    def __init__(self, port: int = 8799, host: str = "127.0.0.1"):
+        self.port = port
+        self.host = host
+        self.profiler = SamplingProfiler()
+        self.httpd = None
+        self.thread = None
+
+    def start(self):
+        """Start serving in a daemon thread."""
+        profiler = self.profiler
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                url = urlparse(self.path)
+                params = parse_qs(url.query)
+
+                if url.path == '/threads':
+                    names = sorted(t.name for t in threading.enumerate())
+                    self._send(200, 'application/json', json.dumps(names))
+                    return
+
+                if url.path != '/profile':
+                    self._send(404, 'text/plain', 'not found\n')
+                    return
+
+                try:
+                    seconds = float(params.get('seconds', ['5'])[0])
+                    hz = int(params.get('hz', ['100'])[0])
+                    fmt = params.get('format', ['collapsed'])[0]
+                    stacks = profiler.profile(seconds, hz)
+                except RuntimeError as e:
+                    self._send(409, 'text/plain', f"{e}\n")
+                    return
+                except ValueError as e:
+                    self._send(400, 'text/plain', f"{e}\n")
+                    return
+
+                if fmt == 'json':
+                    body = json.dumps(SamplingProfiler.to_summary(stacks), indent=2)
+                    self._send(200, 'application/json', body)
+                else:
+                    self._send(200, 'text/plain', SamplingProfiler.to_collapsed(stacks))
+
+            def _send(self, status, content_type, body):
+                data = body.encode('utf-8')
+                self.send_response(status)
+                self.send_header('Content-Type', content_type)
+                self.send_header('Content-Length', str(len(data)))
+                self.end_headers()
+                self.wfile.write(data)
+
+            def log_message(self, format, *args):
+                pass  # Keep the pipeline's stdout clean
+
+        self.httpd = ThreadingHTTPServer((self.host, self.port), Handler)
+        self.httpd.daemon_threads = True
+        self.thread = threading.Thread(
+            target=self.httpd.serve_forever,
+            name="ProfilerServer",
+            daemon=True
+        )
+        self.thread.start()
+        print(f"Profiler endpoint on http://{self.host}:{self.port}/profile")
+
+    def stop(self):
+        """Stop the control endpoint."""
+        if self.httpd:
+            self.httpd.shutdown()
+            self.httpd.server_close()
+            self.httpd = None
+
+
+def start_profiler_server(port: Optional[int] = None) -> Optional[ProfilerServer]:
+    """
+    Start the profiler endpoint if a port is given or THERAPIST_PROFILER_PORT is set.
+
+    Args:
+        port: Port to listen on (localhost only)
+
+    Returns:
+        The running ProfilerServer, or None if profiling is disabled
+    """
+    import os
+
+    if port is None:
+        env_port = os.environ.get('THERAPIST_PROFILER_PORT')
+        if not env_port:
+            return None
+        port = int(env_port)
+
+    try:
+        server = ProfilerServer(port)
+        server.start()
+        return server
+    except OSError as e:
+        print(f"Could not start profiler endpoint on port {port}: {e}")
+        return None
+
+
+if __name__ == "__main__":
+    # Profile a small busy workload as a demo
+    import numpy as np
+
+    def busy():
+        while True:
+            np.fft.rfft(np.random.randn(4096))
+
+    threading.Thread(target=busy, name="BusyWorker", daemon=True).start()
+
+    server = start_profiler_server(8799)
+    print("Try: curl 'http://127.0.0.1:8799/profile?seconds=2' > out.folded")
+
+    try:
+        while True:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        server.stop()
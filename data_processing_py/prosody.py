@@ -0,0 +1,327 @@
+#!/usr/bin/env python3
+"""
+Streaming Voice Prosody
+
+Extracts pitch, energy, speaking rate and voice-quality features from the
+user's microphone audio as chunks arrive, so voice cues can sit next to the
+EEG emotion stream (e.g. "[Voice: tense] [Emotion: stressed]").
+
+Audio is 16 kHz mono PCM. Each chunk is cut into 40 ms frames at a 10 ms hop
+(carrying the previous chunk's tail over) and all frames are analysed at
+once with NumPy: RMS energy, and an FFT autocorrelation whose peak in the
+60-400 Hz lag range gives F0, voicing strength and harmonics-to-noise ratio.
+Work per chunk is proportional to its length and independent of how long
+the stream has run.
+
+Every publish interval (250 ms) the frames since the last event are
+summarised into one feature event stamped with the capture time of its
+last frame:
+
+    pitch_hz, pitch_var_st   median F0 of voiced frames, and its spread in semitones
+    energy_db                mean power over the interval (dBFS)
+    voiced_ratio             fraction of voiced frames
+    speaking_rate            energy peaks (syllable nuclei) per second over 2 s
+    jitter, shimmer          frame-to-frame period and amplitude perturbation
+    hnr_db                   mean harmonics-to-noise ratio of voiced frames
+
+Jitter and shimmer are frame-level approximations (one period estimate per
+10 ms hop), not cycle-to-cycle measurements.
+"""
+
+import time
+import numpy as np
+from collections import deque
+from typing import Callable, Dict, List, Optional
+
+SAMPLE_RATE = 16000
+MIN_F0 = 60.0
+MAX_F0 = 400.0
+# Normalized autocorrelation peak above which a frame counts as voiced
+VOICING_THRESHOLD = 0.45
+SILENCE_DB = -50.0
+# Per-event weight of the running speaker baseline (~10 s of voiced speech)
+BASELINE_ALPHA = 0.025
+
+
+def analyze_frames(frames: np.ndarray, sample_rate: int = SAMPLE_RATE) -> Dict[str, np.ndarray]:
+    """
+    Per-frame energy, F0, voicing and HNR for a batch of frames.
+
+    Args:
+        frames: (n_frames, frame_length) float samples in [-1, 1]
+        sample_rate: Sampling rate
+
+    Returns:
+        Dict of (n_frames,) arrays: energy_db, rms, f0 (0 if unvoiced), voicing, hnr_db
+    """
+    n, length = frames.shape
+    rms = np.sqrt(np.mean(frames ** 2, axis=1))
+    energy_db = 20 * np.log10(np.maximum(rms, 1e-6))
+
+    centered = (frames - frames.mean(axis=1, keepdims=True)) * np.hanning(length)
+    size = 1 << int(np.ceil(np.log2(2 * length)))
+    spectrum = np.fft.rfft(centered, size, axis=1)
+    acf = np.fft.irfft(spectrum.real ** 2 + spectrum.imag ** 2, size, axis=1)[:, :length]
+    # Normalize by the zero lag and undo the window's own autocorrelation taper
+    window_acf = np.fft.irfft(np.abs(np.fft.rfft(np.hanning(length), size)) ** 2, size)[:length]
+    acf = acf / np.maximum(acf[:, :1], 1e-12) / np.maximum(window_acf / window_acf[0], 1e-3)
+
+    lo, hi = int(sample_rate / MAX_F0), min(int(sample_rate / MIN_F0), length - 2)
+    region = acf[:, lo - 1:hi + 1]
+    rows = np.arange(n)
+    # Shortest-lag local maximum within 10% of the best one, so a period
+    # multiple (sub-octave) never wins over the true period
+    is_peak = (region[:, 1:-1] > region[:, :-2]) & (region[:, 1:-1] >= region[:, 2:])
+    candidates = np.where(is_peak, region[:, 1:-1], -1.0)
+    best = candidates.max(axis=1, keepdims=True)
+    peak = np.argmax(candidates >= 0.9 * best, axis=1)
+    lag = peak + lo
+    strength = np.clip(acf[rows, lag], 1e-3, 0.999)
+
+    # Parabolic interpolation around the peak for sub-sample lag
+    left, center, right = acf[rows, lag - 1], acf[rows, lag], acf[rows, lag + 1]
+    denom = left - 2 * center + right
+    shift = np.where(np.abs(denom) > 1e-12, 0.5 * (left - right) / np.where(denom == 0, 1, denom), 0.0)
+    precise_lag = lag + np.clip(shift, -0.5, 0.5)
+
+    voiced = (strength >= VOICING_THRESHOLD) & (energy_db > SILENCE_DB)
+    return {
+        'energy_db': energy_db,
+        'rms': rms,
+        'f0': np.where(voiced, sample_rate / precise_lag, 0.0),
+        'voicing': strength,
+        'hnr_db': 10 * np.log10(strength / (1 - strength)),
+    }
+
+
+class ProsodyExtractor:
+    """
+    Streaming prosody for one audio stream.
+
+    Usage:
+        extractor = ProsodyExtractor(callback=publish)
+        extractor.push(pcm_chunk, capture_time)   # per uploaded chunk
+    """
+
+    def __init__(self, sample_rate: int = SAMPLE_RATE, frame_ms: float = 40, hop_ms: float = 10,
+                 publish_ms: float = 250, rate_window_s: float = 2.0,
+                 callback: Optional[Callable[[Dict], None]] = None):
+        """
+        Initialize extractor.
+
+        Args:
+            sample_rate: Input sampling rate
+            frame_ms: Analysis frame length
+            hop_ms: Hop between frames
+            publish_ms: Interval between feature events
+            rate_window_s: Window for the speaking-rate estimate
+            callback: Receives each feature event as it is produced
+        """
+        self.sample_rate = sample_rate
+        self.frame = int(sample_rate * frame_ms / 1000)
+        self.hop = int(sample_rate * hop_ms / 1000)
+        self.frames_per_event = max(1, int(publish_ms / hop_ms))
+        self.callback = callback
+
+        self._tail = np.zeros(0, dtype=np.float32)
+        self._tail_end_time = None
+        # Frame-level results not yet summarised into an event
+        self._pending = {key: [] for key in ('energy_db', 'rms', 'f0', 'voicing', 'hnr_db')}
+        self._pending_end = 0.0
+        # Energy envelope (10 ms hop) for the speaking-rate estimate
+        self._envelope = deque(maxlen=int(rate_window_s * 1000 / hop_ms))
+        self._utterance = []
+        # Slow running level of this speaker's voiced energy and pitch, so
+        # labels do not depend on microphone gain or vocal range
+        self.baseline_energy_db = None
+        self.baseline_pitch_hz = None
+
+    def reset_utterance(self):
+        self._utterance = []
+
+    def push(self, pcm, capture_time: Optional[float] = None) -> List[Dict]:
+        """
+        Add a chunk of audio.
+
+        Args:
+            pcm: int16 bytes / ndarray, or float ndarray in [-1, 1]
+            capture_time: Capture time of the chunk's first sample (defaults
+                to continuing from the previous chunk, or now)
+
+        Returns:
+            Feature events completed by this chunk
+        """
+        if isinstance(pcm, (bytes, bytearray, memoryview)):
+            pcm = np.frombuffer(pcm, dtype='<i2')
+        samples = pcm.astype(np.float32) / 32768.0 if pcm.dtype.kind == 'i' else pcm.astype(np.float32)
+
+        if capture_time is None:
+            capture_time = self._tail_end_time if self._tail_end_time is not None else time.time()
+        # Realign to the new chunk's clock, keeping the carried-over tail
+        buffer = np.concatenate([self._tail, samples])
+        buffer_start = capture_time - len(self._tail) / self.sample_rate
+        self._tail_end_time = capture_time + len(samples) / self.sample_rate
+
+        n_frames = 0 if len(buffer) < self.frame else 1 + (len(buffer) - self.frame) // self.hop
+        if n_frames == 0:
+            self._tail = buffer
+            return []
+
+        frames = np.lib.stride_tricks.sliding_window_view(buffer, self.frame)[::self.hop][:n_frames]
+        features = analyze_frames(frames, self.sample_rate)
+        self._tail = buffer[n_frames * self.hop:]
+        frame_ends = buffer_start + (np.arange(n_frames) * self.hop + self.frame) / self.sample_rate
+
+        events = []
+        start = 0
+        while start < n_frames:
+            # Fill the pending event up to frames_per_event, emitting when full
+            stop = min(n_frames, start + self.frames_per_event - len(self._pending['f0']))
+            for key, values in features.items():
+                self._pending[key].extend(values[start:stop].tolist())
+            self._envelope.extend(features['energy_db'][start:stop].tolist())
+            self._pending_end = float(frame_ends[stop - 1])
+            if len(self._pending['f0']) >= self.frames_per_event:
+                events.append(self._emit())
+            start = stop
+        return events
+
+    def _emit(self) -> Dict:
+        pending = {key: np.array(values) for key, values in self._pending.items()}
+        for values in self._pending.values():
+            values.clear()
+
+        f0 = pending['f0']
+        voiced = f0 > 0
+        voiced_f0 = f0[voiced]
+        event = {
+            'type': 'prosody',
+            'timestamp': round(self._pending_end, 4),
+            'energy_db': round(float(10 * np.log10(max(np.mean(pending['rms'] ** 2), 1e-12))), 2),
+            'voiced_ratio': round(float(voiced.mean()), 3),
+            'pitch_hz': round(float(np.median(voiced_f0)), 1) if len(voiced_f0) else None,
+            'pitch_var_st': None,
+            'jitter': None,
+            'shimmer': None,
+            'hnr_db': round(float(pending['hnr_db'][voiced].mean()), 2) if voiced.any() else None,
+            'speaking_rate': round(self._speaking_rate(), 2),
+        }
+        if len(voiced_f0) >= 2:
+            semitones = 12 * np.log2(voiced_f0 / np.median(voiced_f0))
+            event['pitch_var_st'] = round(float(semitones.std()), 2)
+            # Consecutive voiced frames only
+            both = voiced[1:] & voiced[:-1]
+            if both.any():
+                periods = 1.0 / np.where(voiced, f0, 1.0)
+                amps = pending['rms']
+                event['jitter'] = round(float(np.mean(np.abs(np.diff(periods)[both])) /
+                                              np.mean(periods[voiced])), 4)
+                event['shimmer'] = round(float(np.mean(np.abs(np.diff(amps)[both])) /
+                                               np.mean(amps[voiced])), 4)
+
+        if event['pitch_hz']:
+            if self.baseline_energy_db is None:
+                self.baseline_energy_db, self.baseline_pitch_hz = event['energy_db'], event['pitch_hz']
+            else:
+                self.baseline_energy_db += BASELINE_ALPHA * (event['energy_db'] - self.baseline_energy_db)
+                self.baseline_pitch_hz += BASELINE_ALPHA * (event['pitch_hz'] - self.baseline_pitch_hz)
+            event['energy_rel_db'] = round(event['energy_db'] - self.baseline_energy_db, 2)
+            event['pitch_rel_st'] = round(float(12 * np.log2(event['pitch_hz'] / self.baseline_pitch_hz)), 2)
+
+        event['label'] = voice_label(event)
+        self._utterance.append(event)
+        if self.callback:
+            self.callback(event)
+        return event
+
+    def _speaking_rate(self) -> float:
+        """Syllable nuclei per second: prominent local maxima of the energy envelope."""
+        envelope = np.array(self._envelope)
+        if len(envelope) < 5:
+            return 0.0
+        smooth = np.convolve(envelope, np.ones(5) / 5, mode='same')
+        threshold = max(SILENCE_DB, np.percentile(smooth, 30) + 6)
+        peaks = (smooth[1:-1] > smooth[:-2]) & (smooth[1:-1] >= smooth[2:]) & (smooth[1:-1] > threshold)
+        # Merge peaks closer than 100 ms (one syllable)
+        idx = np.flatnonzero(peaks)
+        if len(idx):
+            idx = idx[np.concatenate(([True], np.diff(idx) >= 10))]
+        return len(idx) / (len(envelope) * self.hop / self.sample_rate)
+
+    def utterance_summary(self) -> Optional[Dict]:
+        """Summary over the events since reset_utterance(), for tagging a transcript."""
+        voiced = [e for e in self._utterance if e['pitch_hz']]
+        if not voiced:
+            return None
+        summary = {
+            'pitch_hz': round(float(np.median([e['pitch_hz'] for e in voiced])), 1),
+            'pitch_var_st': round(float(np.mean([e['pitch_var_st'] or 0 for e in voiced])), 2),
+            'energy_db': round(float(np.mean([e['energy_db'] for e in voiced])), 2),
+            'speaking_rate': round(float(np.mean([e['speaking_rate'] for e in voiced])), 2),
+            'hnr_db': round(float(np.mean([e['hnr_db'] for e in voiced])), 2),
+            'energy_rel_db': round(float(np.mean([e['energy_rel_db'] for e in voiced])), 2),
+            'pitch_rel_st': round(float(np.mean([e['pitch_rel_st'] for e in voiced])), 2),
+        }
+        summary['label'] = voice_label(summary)
+        return summary
+
+
+def voice_label(features: Dict) -> str:
+    """
+    Coarse vocal affect label from prosodic arousal cues (heuristic).
+
+    Louder or higher than the speaker's own baseline with lively pitch reads
+    as 'excited', louder/higher with flat pitch or fast speech as 'tense',
+    quieter with flat pitch and slow speech as 'subdued'.
+
+    Args:
+        features: A prosody event or utterance summary
+
+    Returns:
+        One of silent, excited, tense, subdued, flat, calm
+    """
+    if not features.get('pitch_hz'):
+        return 'silent'
+    arousal = (features.get('energy_rel_db') or 0.0) / 4 + (features.get('pitch_rel_st') or 0.0) / 2
+    variation = features.get('pitch_var_st') or 0.0
+    rate = features.get('speaking_rate') or 0.0
+    if arousal > 1 and variation > 2.5:
+        return 'excited'
+    if arousal > 1 or rate > 5.5:
+        return 'tense'
+    if arousal < -1 and variation < 1.0 and rate < 3.0:
+        return 'subdued'
+    if variation < 1.0 and rate < 3.0:
+        return 'flat'
+    return 'calm'
+
+
+if __name__ == "__main__":
+    rng = np.random.default_rng(0)
+    fs = SAMPLE_RATE
+
+    # 6 s: syllable-like bursts of a 120-180 Hz gliding voice, with pauses
+    t = np.arange(6 * fs) / fs
+    f0 = 150 + 30 * np.sin(2 * np.pi * 0.5 * t)
+    phase = 2 * np.pi * np.cumsum(f0) / fs
+    voice = sum(np.sin(k * phase) / k for k in range(1, 8))
+    syllables = (np.sin(2 * np.pi * 4 * t) > 0) & ((t % 3) < 2.2)
+    audio = 0.3 * voice * syllables + 0.003 * rng.normal(size=len(t))
+    pcm = (np.clip(audio, -1, 1) * 32767).astype('<i2')
+
+    extractor = ProsodyExtractor()
+    chunk = fs // 10  # 100 ms chunks, as uploaded
+    start = time.time()
+    timings, events = [], []
+    for i in range(0, len(pcm), chunk):
+        t0 = time.perf_counter()
+        events += extractor.push(pcm[i:i + chunk].tobytes(), start + i / fs)
+        timings.append((time.perf_counter() - t0) * 1000)
+
+    print(f"{len(events)} events from {len(pcm) / fs:.0f} s of audio; per 100 ms chunk: "
+          f"mean {np.mean(timings):.2f} ms, max {np.max(timings):.2f} ms")
+    for event in events[::4]:
+        print(f"  +{event['timestamp'] - start:5.2f}s pitch={event['pitch_hz']} "
+              f"energy={event['energy_db']} voiced={event['voiced_ratio']} "
+              f"rate={event['speaking_rate']} jitter={event['jitter']} hnr={event['hnr_db']} -> {event['label']}")
+    print(f"Utterance: {extractor.utterance_summary()}")
@@ -11,7 +11,7 @@ import time
 import argparse
 import matplotlib.pyplot as plt
 import numpy as np
-from csv_replay import CSVReplayEngine, list_available_csvs
+from csv_replay import CSVReplayEngine, ReplayWebSocketServer, list_available_csvs
 from emotion_analyzer import EmotionAnalyzer
 
 def run_batch_analysis(csv_file: str, output_file: str = None):
@@ -77,8 +77,8 @@ def run_replay_demo(csv_file: str, replay_speed: float = 1.0, duration: float =
     # Start replay
     events = engine.replay(
         replay_speed=replay_speed,
-        start_time=0,
-        end_time=duration,
+        start_time=start_time,
+        end_time=start_time + duration,
         output_file="replay_output.json"
     )
     
@@ -211,8 +211,10 @@ def main():
     parser.add_argument('--csv', type=str, 
                        default='recorded_samples/Record Sample_INSIGHT2_432033_2025.07.25T15.25.42+08.00.pm.bp.csv',
                        help='CSV file to analyze')
-    parser.add_argument('--mode', choices=['batch', 'replay'], default='batch',
-                       help='Analysis mode')
+    parser.add_argument('--mode', choices=['batch', 'replay', 'server'], default='batch',
+                       help='Analysis mode (server = interactive replay over WebSocket)')
+    parser.add_argument('--port', type=int, default=8766,
+                       help='Replay server port')
     parser.add_argument('--speed', type=float, default=1.0,
                        help='Replay speed multiplier')
     parser.add_argument('--duration', type=float, default=30.0,
@@ -239,6 +241,10 @@ def main():
     print("Emotiv CSV Emotion Analysis Demo")
     print("=" * 40)
     
+    if args.mode == 'server':
+        ReplayWebSocketServer(args.csv, port=args.port, speed=args.speed).start_server()
+        return
+    
     if args.mode == 'batch':
         events = run_batch_analysis(args.csv, args.output)
     else:  # replay
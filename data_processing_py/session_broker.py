@@ -0,0 +1,563 @@
+#!/usr/bin/env python3
+"""
+Session Broker
+
+Small JSON-lines-over-TCP message broker for running the pipeline across
+several nodes. Ingestion nodes publish per-session streams (raw met data,
+emotion events, transcripts) and worker nodes (analysis, LLM, synthesis)
+join consumer groups. Within a group every session is owned by exactly one
+member, chosen by rendezvous hashing, so assignment is sticky: a member
+joining or leaving only moves the sessions that hash to it.
+
+Each (topic, session) stream is an offset-addressed log with bounded
+retention. Members commit offsets after handling a message; when a session
+moves, the new owner is replayed everything after the last commit, giving
+at-least-once delivery across rebalances and consumer crashes.
+
+Runs as a single local process, which stands in for a real broker and keeps
+the whole cluster mode testable on one machine:
+
+    python session_broker.py serve --port 8790
+    python session_broker.py demo
+"""
+
+import json
+import time
+import queue
+import socket
+import asyncio
+import hashlib
+import argparse
+import threading
+from collections import deque, defaultdict
+from typing import Awaitable, Callable, Dict, List, Optional, Set, Tuple, Union
+
+DEFAULT_PORT = 8790
+
+
+def rendezvous_owner(session: str, members: List[str]) -> Optional[str]:
+    """Highest-random-weight owner of a session among the given members."""
+    best, best_score = None, -1
+    for member in members:
+        score = int.from_bytes(hashlib.blake2b(f"{member}|{session}".encode(), digest_size=8).digest(), 'big')
+        if score > best_score:
+            best, best_score = member, score
+    return best
+
+
+class _Log:
+    """Bounded offset-addressed log for one (topic, session) stream."""
+
+    __slots__ = ('entries', 'next_offset')
+
+    def __init__(self, retention: int):
+        self.entries = deque(maxlen=retention)
+        self.next_offset = 0
+
+    def append(self, data) -> int:
+        offset = self.next_offset
+        self.entries.append((offset, data))
+        self.next_offset += 1
+        return offset
+
+    @property
+    def first_offset(self) -> int:
+        return self.entries[0][0] if self.entries else self.next_offset
+
+    def since(self, offset: int):
+        start = max(0, offset - self.first_offset)
+        for i in range(start, len(self.entries)):
+            yield self.entries[i]
+
+
+class _Member:
+    """Connected consumer-group member."""
+
+    def __init__(self, member_id: str, group: str, topics: Set[str], writer: asyncio.StreamWriter,
+                 max_pending: int):
+        self.id = member_id
+        self.group = group
+        self.topics = topics
+        self.writer = writer
+        self.outbox = asyncio.Queue(maxsize=max_pending)
+        self.sender = None
+
+    def send(self, message: Dict) -> bool:
+        """Queue a message; False means the member is too far behind."""
+        try:
+            self.outbox.put_nowait(message)
+            return True
+        except asyncio.QueueFull:
+            return False
+
+
+class SessionBroker:
+    """
+    Local broker with per-session streams and sticky consumer groups.
+
+    Usage:
+        broker = SessionBroker(port=8790)
+        asyncio.run(broker.serve())
+    """
+
+    def __init__(self, host: str = '127.0.0.1', port: int = DEFAULT_PORT,
+                 retention: int = 10000, max_pending: int = 10000):
+        """
+        Initialize broker.
+
+        Args:
+            host: Interface to listen on
+            port: TCP port
+            retention: Messages kept per (topic, session) for replay
+            max_pending: Undelivered messages per member before it is evicted
+        """
+        self.host = host
+        self.port = port
+        self.retention = retention
+        self.max_pending = max_pending
+
+        self.logs: Dict[Tuple[str, str], _Log] = {}
+        self.sessions: Dict[str, Set[str]] = defaultdict(set)   # session -> topics
+        self.groups: Dict[str, Dict[str, _Member]] = defaultdict(dict)
+        self.owners: Dict[str, Dict[str, str]] = defaultdict(dict)  # group -> session -> member
+        self.committed: Dict[str, Dict[Tuple[str, str], int]] = defaultdict(dict)
+        self.stats = defaultdict(int)
+
+    # -- connection handling -------------------------------------------------
+
+    async def _handle(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter):
+        member = None
+        try:
+            while True:
+                line = await reader.readline()
+                if not line:
+                    break
+                try:
+                    message = json.loads(line)
+                except ValueError:
+                    continue
+
+                op = message.get('op')
+                if op == 'publish':
+                    self.publish(message['topic'], message['session'], message.get('data'))
+                elif op == 'commit' and member:
+                    self._commit(member, message['topic'], message['session'], message['offset'])
+                elif op == 'end':
+                    self.end_session(message['session'])
+                elif op == 'join' and member is None:
+                    member = _Member(message['member'], message['group'], set(message.get('topics', [])),
+                                     writer, self.max_pending)
+                    member.sender = asyncio.create_task(self._sender(member))
+                    self._join(member)
+                elif op == 'stats':
+                    writer.write((json.dumps({'type': 'stats', 'stats': self.report()}) + '\n').encode())
+                    await writer.drain()
+        except (ConnectionError, asyncio.IncompleteReadError, asyncio.CancelledError):
+            pass
+        finally:
+            if member:
+                self._leave(member)
+            writer.close()
+
+    async def _sender(self, member: _Member):
+        try:
+            while True:
+                message = await member.outbox.get()
+                member.writer.write((json.dumps(message) + '\n').encode())
+                if member.outbox.empty():
+                    await member.writer.drain()
+        except (ConnectionError, asyncio.CancelledError):
+            pass
+
+    # -- publishing ----------------------------------------------------------
+
+    def publish(self, topic: str, session: str, data) -> int:
+        """Append to a session stream and deliver to each group's owner."""
+        key = (topic, session)
+        log = self.logs.get(key)
+        if log is None:
+            log = self.logs[key] = _Log(self.retention)
+
+        if session not in self.sessions:
+            self.sessions[session] = set()
+            for group in list(self.groups):
+                self._assign(group, session)
+        self.sessions[session].add(topic)
+
+        offset = log.append(data)
+        self.stats['published'] += 1
+
+        for group, owners in self.owners.items():
+            owner = self.groups[group].get(owners.get(session))
+            if owner and topic in owner.topics:
+                self._deliver(owner, topic, session, offset, data)
+        return offset
+
+    def end_session(self, session: str):
+        """Notify owners that a session finished and drop its streams."""
+        for group, owners in self.owners.items():
+            owner = self.groups[group].get(owners.pop(session, None))
+            if owner:
+                owner.send({'type': 'end', 'session': session})
+            for topic in self.sessions.get(session, ()):
+                self.committed[group].pop((topic, session), None)
+        for topic in self.sessions.pop(session, ()):
+            self.logs.pop((topic, session), None)
+
+    def _deliver(self, member: _Member, topic: str, session: str, offset: int, data) -> bool:
+        """Queue a message for a member; False if it was evicted instead."""
+        if not member.send({'type': 'msg', 'topic': topic, 'session': session, 'offset': offset, 'data': data}):
+            # Slow consumer: evict it; its sessions are replayed elsewhere from the last commit
+            print(f"Evicting slow member {member.group}/{member.id}")
+            self.stats['evictions'] += 1
+            member.writer.close()
+            self._leave(member)
+            return False
+        self.stats['delivered'] += 1
+        return True
+
+    def _commit(self, member: _Member, topic: str, session: str, offset: int):
+        # Only the current owner may move the group's position
+        if self.owners[member.group].get(session) == member.id:
+            key = (topic, session)
+            self.committed[member.group][key] = max(self.committed[member.group].get(key, 0), offset + 1)
+
+    # -- group membership ----------------------------------------------------
+
+    def _join(self, member: _Member):
+        group = self.groups[member.group]
+        if member.id in group:
+            # Same id reconnecting: replace the stale connection
+            self._leave(group[member.id], rebalance=False)
+        group[member.id] = member
+        print(f"Member {member.group}/{member.id} joined ({len(group)} in group)")
+        self._rebalance(member.group)
+
+    def _leave(self, member: _Member, rebalance: bool = True):
+        group = self.groups.get(member.group, {})
+        if group.get(member.id) is not member:
+            return
+        del group[member.id]
+        if member.sender:
+            member.sender.cancel()
+        print(f"Member {member.group}/{member.id} left ({len(group)} in group)")
+        if rebalance:
+            self._rebalance(member.group)
+
+    def _assign(self, group: str, session: str):
+        owner_id = rendezvous_owner(session, list(self.groups[group]))
+        if owner_id is None:
+            self.owners[group].pop(session, None)
+            return
+        self.owners[group][session] = owner_id
+        owner = self.groups[group][owner_id]
+        owner.send({'type': 'assign', 'sessions': [session]})
+        self._replay(owner, session)
+
+    def _rebalance(self, group: str):
+        """Recompute owners; only sessions whose owner changed are moved."""
+        members = list(self.groups[group])
+        owners = self.owners[group]
+        moved: Dict[str, List[str]] = defaultdict(list)
+        revoked: Dict[str, List[str]] = defaultdict(list)
+
+        for session in self.sessions:
+            new_owner = rendezvous_owner(session, members)
+            old_owner = owners.get(session)
+            if new_owner == old_owner:
+                continue
+            if old_owner in self.groups[group]:
+                revoked[old_owner].append(session)
+            if new_owner is None:
+                owners.pop(session, None)
+            else:
+                owners[session] = new_owner
+                moved[new_owner].append(session)
+
+        # Replays can evict a slow member, whose _leave rebalances (and
+        # replays) again; skip members and sessions that changed under us
+        for member_id, sessions in list(revoked.items()):
+            member = self.groups[group].get(member_id)
+            if member is not None:
+                member.send({'type': 'revoke', 'sessions': sessions})
+        for member_id, sessions in list(moved.items()):
+            member = self.groups[group].get(member_id)
+            sessions = [s for s in sessions if owners.get(s) == member_id]
+            if member is None or not sessions:
+                continue
+            member.send({'type': 'assign', 'sessions': sessions})
+            for session in sessions:
+                if not self._replay(member, session):
+                    break
+
+        self.stats['rebalances'] += 1
+        self.stats['sessions_moved'] += sum(len(s) for s in moved.values())
+
+    def _replay(self, member: _Member, session: str) -> bool:
+        """Resend a session from the group's last commit; False if the member was evicted."""
+        for topic in self.sessions.get(session, ()):
+            if topic not in member.topics:
+                continue
+            log = self.logs[(topic, session)]
+            start = self.committed[member.group].get((topic, session), 0)
+            if start < log.first_offset:
+                self.stats['retention_gaps'] += 1
+            for offset, data in log.since(start):
+                self.stats['replayed'] += 1
+                if not self._deliver(member, topic, session, offset, data):
+                    return False
+        return True
+
+    def report(self) -> Dict:
+        return {
+            **self.stats,
+            'sessions': len(self.sessions),
+            'groups': {g: {m: sum(1 for o in self.owners[g].values() if o == m) for m in members}
+                       for g, members in self.groups.items()}
+        }
+
+    async def serve(self):
+        server = await asyncio.start_server(self._handle, self.host, self.port, limit=2 ** 22)
+        print(f"Session broker listening on {self.host}:{self.port}")
+        async with server:
+            await server.serve_forever()
+
+
+class BrokerClient:
+    """
+    Asyncio broker client for workers (and async publishers).
+
+    Usage:
+        client = BrokerClient()
+        await client.connect()
+        await client.consume('analysis', 'node-b', ['met'], handler)
+    """
+
+    def __init__(self, host: str = '127.0.0.1', port: int = DEFAULT_PORT):
+        self.host = host
+        self.port = port
+        self.reader = None
+        self.writer = None
+        self.assigned: Set[str] = set()
+
+    async def connect(self):
+        self.reader, self.writer = await asyncio.open_connection(self.host, self.port, limit=2 ** 22)
+
+    async def _send(self, message: Dict):
+        self.writer.write((json.dumps(message) + '\n').encode())
+        await self.writer.drain()
+
+    async def publish(self, topic: str, session: str, data):
+        await self._send({'op': 'publish', 'topic': topic, 'session': session, 'data': data})
+
+    async def end_session(self, session: str):
+        await self._send({'op': 'end', 'session': session})
+
+    async def consume(self, group: str, member: str, topics: List[str],
+                      handler: Callable[[str, str, int, object], Union[None, Awaitable[None]]],
+                      on_assign: Optional[Callable[[str, List[str]], None]] = None):
+        """
+        Join a consumer group and handle messages until the connection closes.
+
+        Args:
+            group: Consumer group (e.g. "analysis", "llm", "tts")
+            member: Stable member id; reconnecting with the same id takes over
+            topics: Topics this member handles
+            handler: Called as handler(topic, session, offset, data); may be async.
+                The offset is committed after it returns.
+            on_assign: Called as on_assign(kind, sessions) for assign/revoke/end
+        """
+        await self._send({'op': 'join', 'group': group, 'member': member, 'topics': topics})
+
+        while True:
+            line = await self.reader.readline()
+            if not line:
+                return
+            message = json.loads(line)
+            kind = message['type']
+
+            if kind == 'msg':
+                if message['session'] not in self.assigned:
+                    continue
+                result = handler(message['topic'], message['session'], message['offset'], message['data'])
+                if asyncio.iscoroutine(result):
+                    await result
+                await self._send({'op': 'commit', 'topic': message['topic'],
+                                  'session': message['session'], 'offset': message['offset']})
+            elif kind in ('assign', 'revoke', 'end'):
+                sessions = message.get('sessions') or [message['session']]
+                if kind == 'assign':
+                    self.assigned.update(sessions)
+                else:
+                    self.assigned.difference_update(sessions)
+                if on_assign:
+                    on_assign(kind, sessions)
+
+    async def close(self):
+        if self.writer:
+            self.writer.close()
+
+
+class BrokerPublisher:
+    """
+    Thread-safe, non-blocking publisher for ingestion threads.
+
+    publish() never blocks the caller (e.g. the Cortex websocket thread):
+    messages go through a bounded queue to a sender thread that reconnects
+    on failure. When the queue is full the oldest message is dropped.
+    """
+
+    def __init__(self, host: str = '127.0.0.1', port: int = DEFAULT_PORT, max_queue: int = 10000):
+        self.host = host
+        self.port = port
+        self.queue = queue.Queue(maxsize=max_queue)
+        self.dropped = 0
+        self.sent = 0
+        self._running = True
+        self._thread = threading.Thread(target=self._run, name="BrokerPublisher", daemon=True)
+        self._thread.start()
+
+    def publish(self, topic: str, session: str, data):
+        self._put({'op': 'publish', 'topic': topic, 'session': session, 'data': data})
+
+    def end_session(self, session: str):
+        self._put({'op': 'end', 'session': session})
+
+    def _put(self, message: Dict):
+        line = (json.dumps(message) + '\n').encode()
+        while True:
+            try:
+                self.queue.put_nowait(line)
+                return
+            except queue.Full:
+                try:
+                    self.queue.get_nowait()
+                    self.dropped += 1
+                except queue.Empty:
+                    pass
+
+    def _run(self):
+        sock = None
+        batch: List[bytes] = []
+        while self._running:
+            if not batch:
+                try:
+                    batch.append(self.queue.get(timeout=0.5))
+                except queue.Empty:
+                    continue
+                # Coalesce whatever else is queued into one write
+                while len(batch) < 512:
+                    try:
+                        batch.append(self.queue.get_nowait())
+                    except queue.Empty:
+                        break
+            try:
+                if sock is None:
+                    sock = socket.create_connection((self.host, self.port), timeout=5)
+                sock.sendall(b''.join(batch))
+                self.sent += len(batch)
+                batch = []
+            except OSError as e:
+                # Retry the same batch after reconnecting so order is kept
+                print(f"Broker publish error: {e}; retrying")
+                if sock:
+                    sock.close()
+                sock = None
+                time.sleep(1.0)
+        if sock:
+            sock.close()
+
+    def flush(self, timeout: float = 5.0):
+        deadline = time.time() + timeout
+        while not self.queue.empty() and time.time() < deadline:
+            time.sleep(0.01)
+
+    def close(self):
+        self.flush()
+        self._running = False
+        self._thread.join(timeout=2.0)
+
+
+async def _demo(port: int):
+    """Broker + 3 analysis workers + churn, all in one process."""
+    import random
+    from emotion_analyzer import EmotionAnalyzer
+
+    broker = SessionBroker(port=port)
+    broker_task = asyncio.create_task(broker.serve())
+    await asyncio.sleep(0.2)
+
+    handled = defaultdict(list)          # session -> offsets handled (any member)
+    owners_seen = defaultdict(set)       # session -> members that handled it
+    analyzers = defaultdict(EmotionAnalyzer)
+
+    def make_handler(member_id):
+        def handler(topic, session, offset, data):
+            handled[session].append(offset)
+            owners_seen[session].add(member_id)
+            met = data['met']
+            metrics = {'engagement': met[1], 'excitement': met[3], 'stress': met[6],
+                       'relaxation': met[8], 'interest': met[10]}
+            analyzers[(member_id, session)].analyze_emotion(metrics, data['time'])
+        return handler
+
+    workers = {}
+
+    async def start_worker(member_id):
+        client = BrokerClient(port=port)
+        await client.connect()
+        workers[member_id] = (client, asyncio.create_task(
+            client.consume('analysis', member_id, ['met'], make_handler(member_id))))
+
+    for member_id in ('node-a', 'node-b', 'node-c'):
+        await start_worker(member_id)
+
+    publisher = BrokerPublisher(port=port)
+    sessions = [f"session-{i:02d}" for i in range(24)]
+    published = 0
+    for step in range(60):
+        for session in sessions:
+            met = [1, random.random(), 1, random.random(), 0.5, 1, random.random(),
+                   1, random.random(), 1, random.random(), 1, random.random()]
+            publisher.publish('met', session, {'met': met, 'time': time.time()})
+            published += 1
+        if step == 20:
+            await start_worker('node-d')
+        if step == 40:
+            client, task = workers.pop('node-b')
+            await client.close()
+            task.cancel()
+        await asyncio.sleep(0.02)
+
+    publisher.flush()
+    await asyncio.sleep(0.5)
+
+    unique = sum(len(set(v)) for v in handled.values())
+    total = sum(len(v) for v in handled.values())
+    print(f"Published {published}, handled {unique} unique ({total - unique} redelivered)")
+    print(f"Sessions handled by >1 member over time: "
+          f"{sum(1 for s in owners_seen.values() if len(s) > 1)}/{len(sessions)}")
+    print(json.dumps(broker.report(), indent=2))
+
+    publisher.close()
+    for client, task in workers.values():
+        await client.close()
+        task.cancel()
+    broker_task.cancel()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Local session broker')
+    parser.add_argument('mode', choices=['serve', 'demo'], nargs='?', default='serve')
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=DEFAULT_PORT)
+    parser.add_argument('--retention', type=int, default=10000)
+    args = parser.parse_args()
+
+    try:
+        if args.mode == 'demo':
+            asyncio.run(_demo(args.port))
+        else:
+            asyncio.run(SessionBroker(args.host, args.port, retention=args.retention).serve())
+    except KeyboardInterrupt:
+        print("\nBroker stopped")
@@ -0,0 +1,332 @@
+#!/usr/bin/env python3
+"""
+Rolling Session Memory
+
+Keeps the LLM prompt for a therapy session within a fixed token budget.
+The last K turns are kept verbatim; older turns are folded into a rolling
+summary by a background worker after each turn, so nothing on the turn's
+critical path grows with session length.
+
+Budget layout (estimated tokens, including per-message overhead):
+
+    system prompt | summary section <= summary_budget | verbatim turns | new user message <= user_reserve
+
+Until the worker's summary covering an evicted turn lands, the turn stays in
+the summary section as a one-line placeholder, so no turn is ever missing
+from the prompt in both forms.
+"""
+
+import re
+import math
+import queue
+import threading
+import time
+from collections import Counter, deque
+from dataclasses import dataclass, field
+from typing import Callable, Dict, List, Optional
+
+
+@dataclass
+class Turn:
+    """One user/therapist exchange with its emotional context."""
+    user_text: str
+    assistant_text: str = ''
+    # Annotations such as 'anxious' or 'Voice:Happy' observed during the turn
+    emotions: List[str] = field(default_factory=list)
+    timestamp: float = field(default_factory=time.time)
+
+
+# Role and framing tokens each chat message costs on top of its content
+MESSAGE_OVERHEAD = 4
+SUMMARY_HEADER = "Earlier in this session:\n"
+EMOTIONS_PREFIX = "Emotions so far: "
+SENTENCE_END = re.compile(r'[.?!](?=\s|$)')
+
+
+def estimate_tokens(text: str) -> int:
+    """Cheap token estimate (~4 characters per token for English text)."""
+    return math.ceil(len(text) / 4) if text else 0
+
+
+def truncate_tokens(text: str, budget: int, keep_end: bool = False) -> str:
+    """Cut text so estimate_tokens() stays within budget, marking the cut with '...'."""
+    if estimate_tokens(text) <= budget:
+        return text
+    chars = budget * 4 - 3
+    if chars <= 0:
+        return ''
+    return '...' + text[-chars:] if keep_end else text[:chars] + '...'
+
+
+def message_tokens(messages: List[Dict[str, str]]) -> int:
+    """Estimated prompt size of a message list."""
+    return sum(estimate_tokens(m['content']) + MESSAGE_OVERHEAD for m in messages)
+
+
+def format_emotions(emotions: List[str]) -> str:
+    """Render annotations in the README's '[Emotion: X]' style."""
+    tags = []
+    for emotion in emotions:
+        if ':' in emotion:
+            tags.append(f"[{emotion}]")
+        else:
+            tags.append(f"[Emotion: {emotion.title()}]")
+    return ' '.join(tags)
+
+
+def first_sentence(text: str, max_chars: int) -> str:
+    """First sentence of text, or its first max_chars characters."""
+    text = ' '.join(text.split())
+    # Earliest mark followed by a space or the end, so '3.50' doesn't cut
+    end = SENTENCE_END.search(text, 1)
+    if end and end.start() < max_chars:
+        return text[:end.start() + 1]
+    if len(text) > max_chars:
+        return text[:max(0, max_chars - 3)] + '...'
+    return text
+
+
+def turn_line(turn: Turn, max_chars: int = 160) -> str:
+    """One-line digest of a turn: the client's first sentence plus annotations."""
+    line = f"- Client: {first_sentence(turn.user_text, max_chars)}"
+    if turn.emotions:
+        line += f" {format_emotions(turn.emotions)}"
+    return line
+
+
+class ExtractiveSummarizer:
+    """
+    Default summarizer that needs no model call.
+
+    Keeps one short line per folded turn plus running emotion counts, and drops
+    the oldest lines once the summary exceeds its budget. All state lives in
+    the summary text it is given, as with any summarizer. Any callable with
+    the same signature (e.g. one that asks the LLM to update the summary) can
+    be passed to SessionMemory instead.
+    """
+
+    _COUNT = re.compile(r'([^,()]+?) \((\d+)\)')
+
+    def __init__(self, max_line_chars: int = 160):
+        self.max_line_chars = max_line_chars
+
+    def __call__(self, summary: str, turns: List[Turn], budget_tokens: int) -> str:
+        emotion_counts, lines = self._parse(summary)
+        for turn in turns:
+            emotion_counts.update(e.lower() for e in turn.emotions)
+            lines.append(turn_line(turn, self.max_line_chars))
+
+        header = ''
+        if emotion_counts:
+            counts = ', '.join(f"{e} ({n})" for e, n in emotion_counts.most_common())
+            header = f"{EMOTIONS_PREFIX}{counts}\n"
+
+        # Oldest details go first when over budget
+        while lines and estimate_tokens(header + '\n'.join(lines)) > budget_tokens:
+            lines.popleft()
+
+        return truncate_tokens(header + '\n'.join(lines), budget_tokens)
+
+    def _parse(self, summary: str):
+        """Emotion counts and turn lines back out of a summary this class wrote."""
+        emotion_counts = Counter()
+        lines = deque()
+        for line in summary.splitlines():
+            if line.startswith(EMOTIONS_PREFIX):
+                for emotion, n in self._COUNT.findall(line[len(EMOTIONS_PREFIX):]):
+                    emotion_counts[emotion.strip()] += int(n)
+            elif line.startswith('- '):
+                lines.append(line)
+        return emotion_counts, lines
+
+
+class SessionMemory:
+    """
+    Bounded conversational context for one session.
+
+    get_messages() returns a prebuilt snapshot, so assembling the prompt at
+    turn time is a list copy. All summarization happens on a worker thread
+    after add_turn() returns.
+    """
+
+    def __init__(self, system_prompt: str, recent_turns: int = 4,
+                 token_budget: int = 2000, summary_budget: int = 400, user_reserve: int = 200,
+                 summarizer: Optional[Callable[[str, List[Turn], int], str]] = None):
+        """
+        Initialize session memory.
+
+        Args:
+            system_prompt: Fixed therapist instructions, always sent first
+            recent_turns: Number of most recent turns kept verbatim (K)
+            token_budget: Upper bound for the whole assembled prompt
+            summary_budget: Upper bound for the summary message (header,
+                summary and placeholders for turns still being summarized)
+            user_reserve: Room kept for the new user message; longer
+                utterances are truncated by get_messages()
+            summarizer: fn(previous_summary, evicted_turns, budget) -> summary;
+                output beyond the budget is truncated
+        """
+        self.system_prompt = system_prompt
+        self.recent_turns = max(1, recent_turns)
+        self.token_budget = token_budget
+        self.summary_budget = summary_budget
+        self.user_reserve = user_reserve
+        # What the summarizer itself may use of the summary message
+        self.summary_share = max(0, summary_budget - estimate_tokens(SUMMARY_HEADER) - MESSAGE_OVERHEAD)
+        self.summarizer = summarizer or ExtractiveSummarizer()
+
+        self.summary = ''
+        self.turns = deque()
+        # Evicted turns whose summary has not landed yet, oldest first
+        self.folding = deque()
+        self.total_turns = 0
+
+        self._lock = threading.Lock()
+        # (messages, estimated tokens), replaced as a whole
+        self._snapshot = ([], 0)
+        self._pending = queue.Queue()
+        self._worker = threading.Thread(target=self._summarize_loop, name="SessionMemory", daemon=True)
+        self._worker.start()
+
+        self._rebuild_snapshot()
+
+    def add_turn(self, turn: Turn):
+        """Record a finished turn. Eviction and summarization run in the background."""
+        with self._lock:
+            self.turns.append(turn)
+            self.total_turns += 1
+
+            evicted = []
+            while len(self.turns) > self.recent_turns:
+                evicted.append(self.turns.popleft())
+
+            # Keep verbatim turns within what the budget leaves after everything
+            # else; a single turn bigger than that is folded like older ones
+            verbatim_budget = (self.token_budget - estimate_tokens(self.system_prompt) - MESSAGE_OVERHEAD
+                               - self.summary_budget - self.user_reserve)
+            while self.turns and self._turns_tokens() > verbatim_budget:
+                evicted.append(self.turns.popleft())
+
+            self.folding.extend(evicted)
+            self._rebuild_snapshot_locked()
+
+        if evicted:
+            self._pending.put(evicted)
+
+    def get_messages(self, user_text: Optional[str] = None,
+                     emotions: Optional[List[str]] = None) -> List[Dict[str, str]]:
+        """
+        Chat messages for the next LLM call.
+
+        Args:
+            user_text: The new user utterance to append, if any
+            emotions: Annotations for the new utterance
+
+        Returns:
+            OpenAI-style message list within token_budget; the system prompt is
+            always first and byte-identical so providers can reuse a cached prefix
+        """
+        messages, used = self._snapshot
+        messages = list(messages)
+        if user_text is not None:
+            room = self.token_budget - used - MESSAGE_OVERHEAD
+            content = truncate_tokens(self._render_user(user_text, emotions or []), room)
+            messages.append({'role': 'user', 'content': content})
+        return messages
+
+    def prompt_tokens(self) -> int:
+        """Estimated size of the current snapshot (without a new user message)."""
+        return self._snapshot[1]
+
+    def flush(self, timeout: float = 5.0):
+        """Wait until queued turns have been folded into the summary."""
+        deadline = time.time() + timeout
+        while self._pending.unfinished_tasks and time.time() < deadline:
+            time.sleep(0.01)
+
+    def close(self):
+        """Stop the background summarizer."""
+        self._pending.put(None)
+
+    def _summarize_loop(self):
+        while True:
+            evicted = self._pending.get()
+            try:
+                if evicted is None:
+                    return
+                try:
+                    summary = self.summarizer(self.summary, evicted, self.summary_share)
+                except Exception as e:
+                    print(f"Error updating session summary, using extractive fallback: {e}")
+                    summary = ExtractiveSummarizer()(self.summary, evicted, self.summary_share)
+                with self._lock:
+                    self.summary = truncate_tokens(summary, self.summary_share)
+                    for _ in evicted:
+                        self.folding.popleft()
+                    self._rebuild_snapshot_locked()
+            finally:
+                self._pending.task_done()
+
+    def _turns_tokens(self) -> int:
+        return sum(estimate_tokens(self._render_user(t.user_text, t.emotions)) + MESSAGE_OVERHEAD
+                   + (estimate_tokens(t.assistant_text) + MESSAGE_OVERHEAD if t.assistant_text else 0)
+                   for t in self.turns)
+
+    def _render_user(self, text: str, emotions: List[str]) -> str:
+        tags = format_emotions(emotions)
+        return f"{text} {tags}" if tags else text
+
+    def _rebuild_snapshot(self):
+        with self._lock:
+            self._rebuild_snapshot_locked()
+
+    def _rebuild_snapshot_locked(self):
+        messages = [{'role': 'system', 'content': self.system_prompt}]
+        section = self.summary
+        if self.folding:
+            # Placeholders for turns still being summarized come first; the
+            # older summary is cut in the prompt (not in self.summary) to fit
+            per_line = max(8, min(40, self.summary_share // len(self.folding) - 1))
+            lines = [truncate_tokens(turn_line(turn), per_line) for turn in self.folding]
+            # Only a backlog of many unsummarized batches overflows; keep the newest
+            while len(lines) > 1 and estimate_tokens('\n'.join(lines)) > self.summary_share:
+                lines.pop(0)
+            lines = '\n'.join(lines)
+            room = self.summary_share - estimate_tokens(lines) - 1
+            summary = truncate_tokens(self.summary, room, keep_end=True) if room > 0 else ''
+            section = f"{summary}\n{lines}" if summary else lines
+        if section:
+            messages.append({'role': 'system', 'content': f"{SUMMARY_HEADER}{section}"})
+        for turn in self.turns:
+            messages.append({'role': 'user', 'content': self._render_user(turn.user_text, turn.emotions)})
+            if turn.assistant_text:
+                messages.append({'role': 'assistant', 'content': turn.assistant_text})
+        # Swap in one assignment so readers never see a half-built list
+        self._snapshot = (messages, message_tokens(messages))
+
+
+if __name__ == "__main__":
+    memory = SessionMemory(
+        "You are a compassionate therapist. Respond briefly and warmly.",
+        recent_turns=3,
+        token_budget=600,
+        summary_budget=150
+    )
+
+    for i in range(40):
+        memory.add_turn(Turn(
+            user_text=f"This is what I wanted to talk about in turn {i}. It has been a long week.",
+            assistant_text="That sounds hard. Tell me more about what made it long.",
+            emotions=['anxious' if i % 3 else 'calm']
+        ))
+
+        start = time.perf_counter()
+        messages = memory.get_messages("And another thing...", ['stressed'])
+        elapsed_us = (time.perf_counter() - start) * 1e6
+
+        if i % 10 == 9:
+            memory.flush()
+            print(f"Turn {i + 1}: {len(messages)} messages, ~{memory.prompt_tokens()} tokens, "
+                  f"assembled in {elapsed_us:.1f}us")
+
+    memory.close()
@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+"""
+Session Trajectory Similarity Search
+
+Summarizes each session (and sliding windows within it) as a fixed-length
+embedding of its performance-metric time series, and stores the embeddings
+in an approximate nearest-neighbour index (inverted file over k-means
+cells) that supports incremental inserts. Answers "which past sessions
+looked like this one" without reloading or re-analyzing archived CSVs.
+"""
+
+import os
+import json
+import time
+import numpy as np
+from typing import Dict, List, Optional, Tuple
+
+from csv_replay import CSVReplayEngine
+
+METRICS = tuple(CSVReplayEngine.METRIC_COLUMNS.keys())
+
+
+def embed_trajectory(timestamps: np.ndarray, metrics: np.ndarray, points: int = 12) -> np.ndarray:
+    """
+    Fixed-length embedding of a metric time series.
+
+    Per metric: the series resampled to `points` evenly spaced samples (shape),
+    plus mean, standard deviation and linear slope (level and drift). The
+    result is unit-normalized so inner product equals cosine similarity.
+
+    Args:
+        timestamps: (N,) sample times in seconds
+        metrics: (N, M) metric values in [0, 1]
+        points: Resampled shape length per metric
+
+    Returns:
+        (M * (points + 3),) float32 vector
+    """
+    n, m = metrics.shape
+    if n == 0:
+        return np.zeros(m * (points + 3), dtype=np.float32)
+
+    t = timestamps - timestamps[0]
+    duration = t[-1] if n > 1 and t[-1] > 0 else 1.0
+    grid = np.linspace(0, duration, points)
+
+    shape = np.stack([np.interp(grid, t, metrics[:, j]) for j in range(m)])
+    mean = metrics.mean(axis=0)
+    std = metrics.std(axis=0)
+    if n > 1:
+        tc = (t - t.mean()) / duration
+        slope = (tc @ (metrics - mean)) / max(float(tc @ tc), 1e-9)
+    else:
+        slope = np.zeros(m)
+
+    # Center shapes on the overall neutral level so similarity reflects deviations
+    vector = np.concatenate([(shape - 0.5).ravel(), (mean - 0.5) * 2, std * 2, slope])
+    norm = np.linalg.norm(vector)
+    return (vector / norm if norm > 0 else vector).astype(np.float32)
+
+
+class IVFIndex:
+    """
+    Inverted-file ANN index for cosine similarity with incremental inserts.
+
+    Until enough vectors exist to train cells, search is exact. Cells are
+    re-trained with a few k-means iterations each time the index doubles in
+    size since the last training, so inserts stay O(cells) amortized.
+    """
+
+    def __init__(self, dim: int, min_train: int = 256):
+        self.dim = dim
+        self.min_train = min_train
+        self.vectors = np.zeros((1024, dim), dtype=np.float32)
+        self.ids: List = []
+        self.centroids: Optional[np.ndarray] = None
+        self.lists: List[List[int]] = []
+        self._trained_at = 0
+
+    def __len__(self):
+        return len(self.ids)
+
+    def add(self, item_id, vector: np.ndarray):
+        """Insert one unit-normalized vector."""
+        row = len(self.ids)
+        if row == len(self.vectors):
+            self.vectors = np.concatenate([self.vectors, np.zeros_like(self.vectors)])
+        self.vectors[row] = vector
+        self.ids.append(item_id)
+
+        if self.centroids is not None:
+            cell = int(np.argmax(self.centroids @ vector))
+            self.lists[cell].append(row)
+
+        if len(self.ids) >= self.min_train and len(self.ids) >= 2 * self._trained_at:
+            self._train()
+
+    def _train(self, iterations: int = 8):
+        data = self.vectors[:len(self.ids)]
+        cells = max(4, int(np.sqrt(len(data))))
+        rng = np.random.default_rng(len(data))
+        centroids = data[rng.choice(len(data), cells, replace=False)].copy()
+
+        for _ in range(iterations):
+            assign = np.argmax(data @ centroids.T, axis=1)
+            for c in range(cells):
+                members = data[assign == c]
+                if len(members):
+                    centroid = members.mean(axis=0)
+                    norm = np.linalg.norm(centroid)
+                    if norm > 0:
+                        centroids[c] = centroid / norm
+
+        assign = np.argmax(data @ centroids.T, axis=1)
+        self.centroids = centroids
+        self.lists = [np.flatnonzero(assign == c).tolist() for c in range(cells)]
+        self._trained_at = len(data)
+
+    def search(self, query: np.ndarray, k: int = 10, nprobe: int = 8) -> List[Tuple[object, float]]:
+        """
+        Approximate top-k by cosine similarity.
+
+        Args:
+            query: Unit-normalized query vector
+            k: Number of results
+            nprobe: Cells to scan (more = higher recall, slower)
+
+        Returns:
+            List of (id, similarity), best first
+        """
+        if not self.ids:
+            return []
+
+        if self.centroids is None:
+            candidates = np.arange(len(self.ids))
+        else:
+            probe = np.argsort(-(self.centroids @ query))[:nprobe]
+            candidates = np.fromiter((r for c in probe for r in self.lists[c]), dtype=np.int64)
+            if len(candidates) == 0:
+                return []
+
+        scores = self.vectors[candidates] @ query
+        top = np.argsort(-scores)[:k]
+        return [(self.ids[candidates[i]], float(scores[i])) for i in top]
+
+    def save(self, path: str):
+        """Persist vectors, ids and the trained cells so load() skips k-means."""
+        n = len(self.ids)
+        assign = np.full(n, -1, dtype=np.int32)
+        for c, rows in enumerate(self.lists):
+            assign[rows] = c
+        centroids = self.centroids if self.centroids is not None else np.zeros((0, self.dim), dtype=np.float32)
+        np.savez_compressed(path, vectors=self.vectors[:n], ids=np.array(json.dumps(self.ids)),
+                            centroids=centroids, assign=assign,
+                            meta=np.array([self.min_train, self._trained_at]))
+
+    @classmethod
+    def load(cls, path: str) -> 'IVFIndex':
+        data = np.load(path)
+        vectors = data['vectors']
+        min_train, trained_at = (int(v) for v in data['meta'])
+        index = cls(vectors.shape[1], min_train=min_train)
+        index.vectors = np.zeros((max(1024, len(vectors)), index.dim), dtype=np.float32)
+        index.vectors[:len(vectors)] = vectors
+        index.ids = [tuple(i) if isinstance(i, list) else i for i in json.loads(str(data['ids']))]
+        if len(data['centroids']):
+            assign = data['assign']
+            index.centroids = data['centroids']
+            index.lists = [np.flatnonzero(assign == c).tolist() for c in range(len(index.centroids))]
+        index._trained_at = trained_at
+        return index
+
+
+class SessionSimilarityIndex:
+    """
+    Whole-session and window-level trajectory search.
+
+    Usage:
+        index = SessionSimilarityIndex()
+        index.add_session("2025-07-25-a", timestamps, metrics)
+        index.similar_sessions(timestamps, metrics, k=5)
+    """
+
+    def __init__(self, points: int = 12, window_seconds: float = 300.0, window_step: float = 60.0):
+        """
+        Initialize similarity index.
+
+        Args:
+            points: Resampled shape length per metric
+            window_seconds: Length of windows indexed for partial matches
+            window_step: Stride between consecutive windows
+        """
+        self.points = points
+        self.window_seconds = window_seconds
+        self.window_step = window_step
+        dim = len(METRICS) * (points + 3)
+        self.sessions = IVFIndex(dim)
+        self.windows = IVFIndex(dim)
+
+    def add_session(self, session_id: str, timestamps: np.ndarray, metrics: np.ndarray):
+        """Embed and insert a session and all of its windows."""
+        if len(timestamps) < 2:
+            return
+        self.sessions.add(session_id, embed_trajectory(timestamps, metrics, self.points))
+
+        for start, vector in self._window_embeddings(timestamps, metrics):
+            self.windows.add((session_id, round(start, 1)), vector)
+
+    def add_csv(self, csv_file: str, session_id: Optional[str] = None):
+        """Index an archived Emotiv CSV export."""
+        engine = CSVReplayEngine(csv_file)
+        timestamps, metrics = engine.metrics_matrix()
+        self.add_session(session_id or os.path.basename(csv_file), timestamps, metrics)
+
+    def similar_sessions(self, timestamps: np.ndarray, metrics: np.ndarray,
+                         k: int = 5, nprobe: int = 8) -> List[Tuple[str, float]]:
+        """Sessions whose overall trajectory is most similar."""
+        query = embed_trajectory(timestamps, metrics, self.points)
+        return self.sessions.search(query, k, nprobe)
+
+    def similar_windows(self, timestamps: np.ndarray, metrics: np.ndarray,
+                        k: int = 5, nprobe: int = 8) -> List[Tuple[Tuple[str, float], float]]:
+        """
+        Past session windows similar to the given stretch.
+
+        Returns:
+            List of ((session_id, window_start_offset_seconds), similarity)
+        """
+        query = embed_trajectory(timestamps, metrics, self.points)
+        return self.windows.search(query, k, nprobe)
+
+    def _window_embeddings(self, timestamps: np.ndarray, metrics: np.ndarray):
+        offsets = timestamps - timestamps[0]
+        start = 0.0
+        while start + self.window_seconds <= offsets[-1] + 1e-9:
+            lo, hi = np.searchsorted(offsets, [start, start + self.window_seconds])
+            if hi - lo >= 2:
+                yield start, embed_trajectory(timestamps[lo:hi], metrics[lo:hi], self.points)
+            start += self.window_step
+
+    def save(self, directory: str):
+        os.makedirs(directory, exist_ok=True)
+        with open(os.path.join(directory, 'params.json'), 'w') as f:
+            json.dump({'points': self.points, 'window_seconds': self.window_seconds,
+                       'window_step': self.window_step}, f)
+        self.sessions.save(os.path.join(directory, 'sessions.npz'))
+        self.windows.save(os.path.join(directory, 'windows.npz'))
+
+    @classmethod
+    def load(cls, directory: str) -> 'SessionSimilarityIndex':
+        """Restore an index saved with save(), including its embedding parameters."""
+        with open(os.path.join(directory, 'params.json')) as f:
+            index = cls(**json.load(f))
+        index.sessions = IVFIndex.load(os.path.join(directory, 'sessions.npz'))
+        index.windows = IVFIndex.load(os.path.join(directory, 'windows.npz'))
+        return index
+
+if __name__ == "__main__":
+    rng = np.random.default_rng(0)
+    index = SessionSimilarityIndex()
+
+    # Synthetic archive: 3,000 hour-long sessions drifting between random levels
+    def fake_session(n=7200):
+        knots = rng.random((6, len(METRICS)))
+        t = np.arange(n) * 0.5
+        series = np.stack([np.interp(t, np.linspace(0, t[-1], 6), knots[:, j]) for j in range(len(METRICS))], axis=1)
+        return t + 1.7e9, np.clip(series + rng.normal(0, 0.05, series.shape), 0, 1)
+
+    start = time.perf_counter()
+    for i in range(3000):
+        index.add_session(f"session-{i:04d}", *fake_session(720))
+    print(f"Indexed {len(index.sessions)} sessions / {len(index.windows)} windows "
+          f"in {time.perf_counter() - start:.1f}s")
+
+    query = fake_session(720)
+    start = time.perf_counter()
+    hits = index.similar_sessions(*query, k=5)
+    print(f"Top sessions in {(time.perf_counter() - start) * 1000:.2f}ms: {hits}")
+
+    start = time.perf_counter()
+    hits = index.similar_windows(query[0][:600], query[1][:600], k=5)
+    print(f"Top windows in {(time.perf_counter() - start) * 1000:.2f}ms: {hits}")
+
+    sample = "recorded_samples/Record Sample_INSIGHT2_432033_2025.07.25T15.25.42+08.00.pm.bp.csv"
+    if os.path.exists(sample):
+        index.add_csv(sample)
+        print(f"Added {sample}")
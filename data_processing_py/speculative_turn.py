@@ -0,0 +1,396 @@
+#!/usr/bin/env python3
+"""
+Speculative Response Start
+
+Starts the therapist's LLM response before the user's turn is officially
+over. While the user speaks, streaming STT delivers partial transcripts and
+the mux gateway delivers prosody events (prosody.py). Once the partial
+transcript has stopped changing and an end-of-turn predictor fed by those
+prosody events is confident the user is done, a response is generated
+speculatively from the partial text.
+
+When the final transcript arrives:
+- if it matches the speculated text (ignoring case and punctuation), the
+  speculative stream is handed over, often with tokens already buffered
+- otherwise the speculation is cancelled and a fresh request is started
+Speculations are also cancelled as soon as a newer partial diverges (the
+user kept talking).
+
+The thresholds trade wasted generation against response latency; metrics()
+reports both sides (speculation hit rate, wasted tokens and seconds, and the
+first-token latency saved per turn).
+
+Usage:
+    responder = SpeculativeResponder(gateway, build_messages, provider='deepseek')
+    responder.on_prosody(event)        # from the mux gateway
+    responder.on_partial(text)         # from streaming STT
+    async for delta in responder.respond(final_text):
+        tts.feed(delta)
+"""
+
+import re
+import math
+import time
+import asyncio
+from collections import deque
+from dataclasses import asdict, dataclass
+from typing import AsyncIterator, Callable, Dict, List, Optional
+
+from llm_gateway import LLMGateway
+
+
+@dataclass
+class SpeculationPolicy:
+    """Decision thresholds for starting a speculative response."""
+    # Partial transcript unchanged for at least this long (seconds)
+    stable_for: float = 0.3
+    min_words: int = 3
+    # Predicted end-of-turn probability needed to speculate
+    end_of_turn: float = 0.6
+    # Cap on speculative requests per turn (bounds the waste when a user pauses a lot)
+    max_per_turn: int = 2
+
+
+class EndOfTurnPredictor:
+    """
+    Probability that the user has finished their turn, from prosody events.
+
+    Trailing silence is the main cue; a marked pitch movement on the last
+    voiced stretch (final lowering, or a question's rise) makes an end of
+    turn more likely after a shorter pause.
+    """
+
+    def __init__(self, pause: float = 0.35, voiced_ratio: float = 0.2):
+        """
+        Initialize predictor.
+
+        Args:
+            pause: Trailing silence (seconds) at which the probability reaches 0.5
+                without a pitch cue
+            voiced_ratio: Minimum voiced fraction for an event to count as speech
+        """
+        self.pause = pause
+        self.voiced_ratio = voiced_ratio
+        self.last_voiced = None
+        self.pitches = deque(maxlen=8)
+
+    def reset(self):
+        self.last_voiced = None
+        self.pitches.clear()
+
+    def update(self, event: Dict):
+        if event.get('pitch_hz') and event.get('voiced_ratio', 0) >= self.voiced_ratio:
+            self.last_voiced = event['timestamp']
+            self.pitches.append(12 * math.log2(event['pitch_hz']))
+
+    def probability(self, now: Optional[float] = None) -> float:
+        if self.last_voiced is None:
+            return 0.0
+        silence = (time.time() if now is None else now) - self.last_voiced
+        terminal = 0.0
+        if len(self.pitches) >= 3:
+            pitches = list(self.pitches)
+            # Last voiced event against the stretch before it, in semitones
+            terminal = abs(pitches[-1] - sum(pitches[:-1]) / (len(pitches) - 1))
+        score = 10 * (silence - self.pause) + 0.5 * min(terminal, 4.0)
+        return 1 / (1 + math.exp(-score))
+
+
+def normalize_transcript(text: str) -> str:
+    """Lowercase, punctuation-free, single-spaced text for comparing transcripts."""
+    return ' '.join(re.sub(r"[^\w\s']", ' ', text.lower()).split())
+
+
+class _Speculation:
+    """One in-flight response and the tokens it has produced so far."""
+
+    def __init__(self, text: str, started: float):
+        self.text = text
+        self.key = normalize_transcript(text)
+        self.started = started
+        self.first_token_at = None
+        self.tokens: List[str] = []
+        self.done = False
+        self.finished_at = None
+        self.error = None
+        self.updated = asyncio.Event()
+        self.task = None
+
+
+class SpeculativeResponder:
+    """
+    Per-session speculative LLM response starter.
+
+    Not thread-safe: call it from the session's event loop.
+    """
+
+    def __init__(self, gateway: LLMGateway, build_messages: Callable[[str], List[Dict]],
+                 provider: str = 'deepseek', policy: Optional[SpeculationPolicy] = None,
+                 predictor: Optional[EndOfTurnPredictor] = None, **params):
+        """
+        Initialize responder.
+
+        Args:
+            gateway: LLM gateway used for all requests
+            build_messages: Maps a user transcript to the chat messages to send
+            provider: Gateway provider key
+            policy: Speculation thresholds
+            predictor: End-of-turn predictor (defaults to prosody-based)
+            **params: Extra completion parameters
+        """
+        self.gateway = gateway
+        self.build_messages = build_messages
+        self.provider = provider
+        self.policy = policy or SpeculationPolicy()
+        self.predictor = predictor or EndOfTurnPredictor()
+        self.params = params
+
+        self._partial = ''
+        self._partial_since = 0.0
+        self._speculation: Optional[_Speculation] = None
+        self._turn_speculations = 0
+
+        self.counters = {
+            'turns': 0,
+            'speculated_turns': 0,
+            'speculations': 0,
+            'committed': 0,
+            'cancelled_partial': 0,
+            'cancelled_final': 0,
+            'wasted_tokens': 0,
+            'wasted_seconds': 0.0,
+            'saved_seconds': 0.0,
+        }
+        # First token latency after the final transcript, per turn
+        self.latency_hit = deque(maxlen=500)
+        self.latency_miss = deque(maxlen=500)
+
+    # Inputs
+
+    def on_partial(self, text: str, now: Optional[float] = None):
+        """A new partial transcript for the current turn."""
+        now = time.time() if now is None else now
+        if normalize_transcript(text) != normalize_transcript(self._partial):
+            self._partial = text
+            self._partial_since = now
+            spec = self._speculation
+            if spec is not None and spec.key != normalize_transcript(text):
+                self._cancel('cancelled_partial', now)
+        self._evaluate(now)
+
+    def on_prosody(self, event: Dict, now: Optional[float] = None):
+        """A prosody event from the same speaker (see prosody.py)."""
+        self.predictor.update(event)
+        self._evaluate(time.time() if now is None else now)
+
+    def poll(self, now: Optional[float] = None):
+        """Re-check the thresholds without new input (e.g. from a timer)."""
+        self._evaluate(time.time() if now is None else now)
+
+    def _evaluate(self, now: float):
+        policy = self.policy
+        if self._speculation is not None or self._turn_speculations >= policy.max_per_turn:
+            return
+        if len(self._partial.split()) < policy.min_words or now - self._partial_since < policy.stable_for:
+            return
+        if self.predictor.probability(now) < policy.end_of_turn:
+            return
+        self._speculation = self._start(self._partial, now)
+        self._turn_speculations += 1
+        self.counters['speculations'] += 1
+
+    # Generation
+
+    def _start(self, text: str, now: float) -> _Speculation:
+        spec = _Speculation(text, now)
+        spec.task = asyncio.get_running_loop().create_task(self._generate(spec))
+        return spec
+
+    async def _generate(self, spec: _Speculation):
+        try:
+            async for delta in self.gateway.stream_chat(self.build_messages(spec.text), self.provider,
+                                                        **self.params):
+                if spec.first_token_at is None:
+                    spec.first_token_at = time.time()
+                spec.tokens.append(delta)
+                spec.updated.set()
+        except asyncio.CancelledError:
+            raise
+        except Exception as e:
+            spec.error = e
+        finally:
+            spec.done = True
+            spec.finished_at = time.time()
+            spec.updated.set()
+
+    def _cancel(self, reason: str, now: float):
+        spec, self._speculation = self._speculation, None
+        if spec is None:
+            return
+        spec.task.cancel()
+        self.counters[reason] += 1
+        self.counters['wasted_tokens'] += len(spec.tokens)
+        self.counters['wasted_seconds'] += (spec.finished_at or now) - spec.started
+
+    async def respond(self, final_text: str) -> AsyncIterator[str]:
+        """
+        Stream the response to the final transcript, reusing a matching
+        speculation. Ends the turn.
+        """
+        final_at = time.time()
+        self.counters['turns'] += 1
+        if self._turn_speculations:
+            self.counters['speculated_turns'] += 1
+
+        spec = self._speculation
+        self._speculation = None
+        hit = spec is not None and spec.key == normalize_transcript(final_text)
+        if spec is not None and not hit:
+            self._speculation = spec
+            self._cancel('cancelled_final', final_at)
+        if hit:
+            self.counters['committed'] += 1
+        else:
+            spec = self._start(final_text, final_at)
+        self._reset_turn()
+
+        index = 0
+        first = True
+        try:
+            while True:
+                while index < len(spec.tokens):
+                    if first:
+                        first = False
+                        self._record_first_token(spec, final_at, hit)
+                    yield spec.tokens[index]
+                    index += 1
+                if spec.done:
+                    if spec.error is not None:
+                        raise spec.error
+                    return
+                spec.updated.clear()
+                if index == len(spec.tokens) and not spec.done:
+                    await spec.updated.wait()
+        finally:
+            if not spec.done:
+                spec.task.cancel()
+
+    def _record_first_token(self, spec: _Speculation, final_at: float, hit: bool):
+        now = time.time()
+        if hit:
+            self.latency_hit.append(now - final_at)
+            # Without speculation the first token would have come one TTFT after the final transcript
+            ttft = spec.first_token_at - spec.started
+            self.counters['saved_seconds'] += max(0.0, final_at + ttft - max(final_at, spec.first_token_at))
+        else:
+            self.latency_miss.append(now - final_at)
+
+    def _reset_turn(self):
+        self._partial = ''
+        self._partial_since = 0.0
+        self._turn_speculations = 0
+        self.predictor.reset()
+
+    def cancel(self):
+        """Drop any speculation (e.g. the session closed)."""
+        self._cancel('cancelled_partial', time.time())
+
+    # Metrics
+
+    def metrics(self) -> Dict:
+        """Decision thresholds, speculation outcomes, wasted compute and latency saved."""
+        counters = dict(self.counters)
+
+        def p50(samples):
+            ordered = sorted(samples)
+            return round(ordered[len(ordered) // 2], 4) if ordered else None
+
+        speculations = counters['speculations']
+        committed = counters['committed']
+        counters['wasted_seconds'] = round(counters['wasted_seconds'], 3)
+        counters['saved_seconds'] = round(counters['saved_seconds'], 3)
+        return {
+            'policy': asdict(self.policy),
+            'predictor': {'pause': self.predictor.pause, 'voiced_ratio': self.predictor.voiced_ratio},
+            **counters,
+            'hit_rate': round(committed / speculations, 3) if speculations else None,
+            'saved_per_hit': round(counters['saved_seconds'] / committed, 4) if committed else None,
+            'first_token_p50_hit': p50(self.latency_hit),
+            'first_token_p50_miss': p50(self.latency_miss),
+        }
+
+
+async def _demo():
+    import random
+    from llm_gateway import ProviderConfig
+    from llm_standin import StandinLLMServer
+
+    port = 8809
+    standin = StandinLLMServer(port=port, tokens_per_second=60, ttft=0.35, cached_ttft=0.35)
+    server = await asyncio.start_server(standin.handle, '127.0.0.1', port)
+    gateway = LLMGateway({'standin': ProviderConfig('standin', f'http://127.0.0.1:{port}/v1', 'standin',
+                                                    max_concurrency=32, hedge_after=None)})
+
+    def build_messages(text):
+        return [{'role': 'system', 'content': 'You are a compassionate therapist.'},
+                {'role': 'user', 'content': text}]
+
+    utterances = ["I've been feeling anxious about work lately",
+                  "My manager keeps changing the deadlines",
+                  "I don't sleep well before presentations",
+                  "Sometimes I just want to stay home"]
+    # Offline pipeline: upload + transcription after the user stops talking
+    stt_delay = 0.6
+    word_time = 0.2
+
+    async def session(responder: SpeculativeResponder, turns: int):
+        for _ in range(turns):
+            words = random.choice(utterances).split()
+            # A third of the turns pause mid-sentence and then carry on
+            pause_at = random.randint(3, len(words) - 1) if random.random() < 0.33 else None
+            t = time.time()
+            for i, word in enumerate(words):
+                if i == pause_at:
+                    for _ in range(3):  # 750 ms hesitation
+                        await asyncio.sleep(0.25)
+                        responder.on_prosody({'timestamp': time.time(), 'pitch_hz': None, 'voiced_ratio': 0.0})
+                await asyncio.sleep(word_time)
+                responder.on_prosody({'timestamp': time.time(), 'voiced_ratio': 0.8,
+                                      'pitch_hz': 150 - 4 * i if i == len(words) - 1 else 160})
+                responder.on_partial(' '.join(words[:i + 1]))
+            end = time.time()
+            while time.time() - end < stt_delay:
+                await asyncio.sleep(0.05)
+                responder.poll()
+            final = ' '.join(words) + '.'
+            if random.random() < 0.15:
+                # The offline transcript corrects a word the streaming STT got wrong
+                final = final.replace(words[-1], words[-1] + 's')
+            async for _ in responder.respond(final):
+                pass
+            await asyncio.sleep(random.uniform(0.2, 0.5))
+
+    # Speculation off (threshold above 1) vs the default policy
+    for label, policy in (('baseline', SpeculationPolicy(end_of_turn=1.01)), ('speculative', SpeculationPolicy())):
+        random.seed(1)
+        responders = [SpeculativeResponder(gateway, build_messages, 'standin', policy, max_tokens=20)
+                      for _ in range(8)]
+        await asyncio.gather(*(session(r, 4) for r in responders))
+
+        totals = {}
+        for r in responders:
+            for key, value in r.counters.items():
+                totals[key] = totals.get(key, 0) + value
+        latencies = sorted(x for r in responders for x in list(r.latency_hit) + list(r.latency_miss))
+        print(f"{label}: first token {latencies[len(latencies) // 2] * 1000:.0f} ms p50 after the final "
+              f"transcript over {totals['turns']} turns; {totals['speculations']} speculations, "
+              f"{totals['committed']} committed, {totals['cancelled_partial']} cancelled by partials, "
+              f"{totals['cancelled_final']} by finals; wasted {totals['wasted_tokens']} tokens / "
+              f"{totals['wasted_seconds']:.2f}s, saved {totals['saved_seconds']:.2f}s")
+    print(f"One session: {responders[0].metrics()}")
+
+    await gateway.close()
+    server.close()
+
+if __name__ == "__main__":
+    asyncio.run(_demo())
@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""
+Demand-Driven Cortex Stream Subscriptions
+
+Cortex streams (and we decode) every stream in a session's subscription,
+whether or not anything reads it; raw 'eeg' alone is 128 JSON messages a
+second. StreamManager reference-counts consumers per stream and subscribes
+a stream when its first consumer appears. It unsubscribes once the last one
+has been gone for a grace period, so a viewer that is toggled or a page that
+reloads doesn't cause a sub/unsub round trip each time.
+
+    manager = StreamManager(subscriber)
+    manager.acquire('met')          # held for the whole session
+    subscriber.start([])            # blocks; subscribes 'met' once the session exists
+
+    with manager.lease('eeg'):      # e.g. while a raw EEG viewer is open
+        ...
+
+Consumers may acquire before the Cortex session exists; demanded streams are
+subscribed when it is created, and again if Cortex stops all streams and a
+new session is created.
+"""
+
+import threading
+import time
+from contextlib import contextmanager
+from typing import Dict, List
+
+
+class StreamManager:
+    """
+    Reference-counted subscriptions on one Cortex session.
+    """
+
+    def __init__(self, subscriber=None, grace_s: float = 5.0):
+        """
+        Initialize manager.
+
+        Args:
+            subscriber: sub_data.Subcribe, or None to attach() one later;
+                consumers can acquire streams in the meantime
+            grace_s: Seconds a stream stays subscribed after its last
+                consumer releases it
+        """
+        self.subscriber = None
+        self.grace_s = grace_s
+        self._lock = threading.Lock()
+        # Held across a state change and the sub/unsub it implies, so requests
+        # reach Cortex in the order the state changed (an unsub from an expiring
+        # grace timer can't overtake the sub of a concurrent acquire)
+        self._request_lock = threading.RLock()
+        self._counts: Dict[str, int] = {}
+        self._subscribed: Dict[str, float] = {}  # stream -> time subscribed
+        self._timers: Dict[str, threading.Timer] = {}
+        self._ready = False
+        self.stats = {'subscribes': 0, 'unsubscribes': 0, 'reuses': 0}
+        self._subscribed_seconds: Dict[str, float] = {}
+        if subscriber is not None:
+            self.attach(subscriber)
+
+    def attach(self, subscriber):
+        """
+        Manage a subscriber's session.
+
+        Args:
+            subscriber: Anything with sub(streams) and unsub(streams); session
+                events are bound when it has a Cortex client as .c
+        """
+        self.subscriber = subscriber
+        cortex = getattr(subscriber, 'c', None)
+        if cortex is not None:
+            cortex.bind(create_session_done=self._on_session_created,
+                        warn_cortex_stop_all_sub=self._on_session_lost)
+
+    def acquire(self, stream: str):
+        """Register a consumer of a stream, subscribing it if needed."""
+        with self._request_lock:
+            with self._lock:
+                self._counts[stream] = self._counts.get(stream, 0) + 1
+                timer = self._timers.pop(stream, None)
+                if timer is not None:
+                    # Re-acquired within the grace period: still subscribed
+                    timer.cancel()
+                    self.stats['reuses'] += 1
+                subscribe = self._ready and stream not in self._subscribed
+                if subscribe:
+                    self._mark_subscribed([stream])
+            if subscribe:
+                self.subscriber.sub([stream])
+
+    def release(self, stream: str):
+        """Drop a consumer; the stream is unsubscribed after the grace period."""
+        with self._lock:
+            count = self._counts.get(stream, 0)
+            if count == 0:
+                print(f"StreamManager: release of '{stream}' without acquire")
+                return
+            self._counts[stream] = count - 1
+            if count > 1 or stream not in self._subscribed:
+                return
+            if self.grace_s > 0:
+                timer = threading.Timer(self.grace_s, self._expire, args=(stream,))
+                timer.daemon = True
+                self._timers[stream] = timer
+                timer.start()
+                return
+        self._expire(stream)
+
+    @contextmanager
+    def lease(self, stream: str):
+        """Hold a stream for the duration of a with block."""
+        self.acquire(stream)
+        try:
+            yield
+        finally:
+            self.release(stream)
+
+    def _expire(self, stream: str):
+        with self._request_lock:
+            with self._lock:
+                timer = self._timers.get(stream)
+                if timer is not None and timer is not threading.current_thread():
+                    return  # superseded by a newer release
+                self._timers.pop(stream, None)
+                if self._counts.get(stream, 0) or stream not in self._subscribed:
+                    return
+                self._mark_unsubscribed([stream])
+            self.subscriber.unsub([stream])
+
+    def _mark_subscribed(self, streams: List[str]):
+        now = time.monotonic()
+        for stream in streams:
+            self._subscribed[stream] = now
+        self.stats['subscribes'] += len(streams)
+
+    def _mark_unsubscribed(self, streams: List[str], request: bool = True):
+        now = time.monotonic()
+        for stream in streams:
+            since = self._subscribed.pop(stream)
+            self._subscribed_seconds[stream] = self._subscribed_seconds.get(stream, 0.0) + now - since
+        if request:
+            self.stats['unsubscribes'] += len(streams)
+
+    def _on_session_created(self, *args, **kwargs):
+        """Subscribe everything with consumers (or still in its grace period)."""
+        with self._request_lock:
+            with self._lock:
+                self._ready = True
+                streams = [stream for stream, count in self._counts.items()
+                           if (count or stream in self._timers) and stream not in self._subscribed]
+                self._mark_subscribed(streams)
+            if streams:
+                self.subscriber.sub(streams)
+
+    def _on_session_lost(self, *args, **kwargs):
+        """Cortex stopped every stream; resubscribe when a session exists again."""
+        with self._lock:
+            self._ready = False
+            for timer in self._timers.values():
+                timer.cancel()
+            self._timers.clear()
+            self._mark_unsubscribed(list(self._subscribed), request=False)
+
+    def close(self):
+        """Cancel pending unsubscribes (the session is going away anyway)."""
+        with self._lock:
+            for timer in self._timers.values():
+                timer.cancel()
+            self._timers.clear()
+
+    def state(self) -> Dict:
+        """Consumers, subscription status and subscribed time per stream."""
+        now = time.monotonic()
+        with self._lock:
+            streams = set(self._counts) | set(self._subscribed) | set(self._subscribed_seconds)
+            return {
+                'ready': self._ready,
+                'streams': {
+                    stream: {
+                        'consumers': self._counts.get(stream, 0),
+                        'subscribed': stream in self._subscribed,
+                        'releasing': stream in self._timers,
+                        'subscribed_s': round(self._subscribed_seconds.get(stream, 0.0)
+                                              + (now - self._subscribed[stream] if stream in self._subscribed else 0.0), 1),
+                    }
+                    for stream in sorted(streams)
+                },
+                **self.stats,
+            }
+
+
+if __name__ == "__main__":
+    import json
+
+    class _PrintingSubscriber:
+        """Stands in for sub_data.Subcribe and logs the requests Cortex would get."""
+
+        def __init__(self):
+            self.start = time.monotonic()
+
+        def sub(self, streams):
+            print(f"  t={time.monotonic() - self.start:4.1f}s subscribe {streams}")
+
+        def unsub(self, streams):
+            print(f"  t={time.monotonic() - self.start:4.1f}s unsubscribe {streams}")
+
+    print("=== Stream Manager Demo (grace 1 s) ===")
+    manager = StreamManager(_PrintingSubscriber(), grace_s=1.0)
+    manager.acquire('met')
+    manager._on_session_created()  # normally bound to Cortex's create_session_done
+
+    # A raw EEG viewer opens, closes and reopens within the grace period,
+    # then closes for good
+    manager.acquire('eeg')
+    time.sleep(0.5)
+    manager.release('eeg')
+    time.sleep(0.3)
+    manager.acquire('eeg')
+    time.sleep(0.5)
+    manager.release('eeg')
+    time.sleep(1.5)
+
+    # Two consumers of band power overlap
+    with manager.lease('pow'):
+        with manager.lease('pow'):
+            time.sleep(0.2)
+    time.sleep(1.2)
+
+    print(json.dumps(manager.state(), indent=2))
@@ -204,8 +204,9 @@ class Subcribe():
     def on_create_session_done(self, *args, **kwargs):
         print('on_create_session_done')
 
-        # subribe data 
-        self.sub(self.streams)
+        # subribe data (none when a StreamManager subscribes on demand)
+        if self.streams:
+            self.sub(self.streams)
 
     def on_inform_error(self, *args, **kwargs):
         error_data = kwargs.get('error_data')
@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+"""
+Synthetic Session Generator
+
+Generates realistic multi-stream Emotiv sessions (met at 2 Hz, pow at 8 Hz,
+eeg at 128 Hz) for thousands of virtual users at once, for load testing the
+downstream pipeline. Each user wanders through the therapy scenario states
+from therapy_demo.SCENARIOS as a Markov chain with random dwell times;
+metrics follow the current state with lag and noise, and band power / raw
+EEG are derived from the metrics so all streams stay consistent.
+
+All users advance together as numpy arrays. Output goes either through
+SyntheticHeadset objects, which emit the same events with the same payloads
+as Cortex (bind new_met_data / new_pow_data / new_eeg_data exactly as on a
+live Cortex client), or through a batch sink that receives whole arrays.
+Runs unthrottled (as fast as possible) or in real time.
+"""
+
+import time
+import numpy as np
+from typing import Callable, Dict, List, Optional
+from pydispatch import Dispatcher
+
+from therapy_demo import SCENARIOS
+
+EEG_RATE = 128
+POW_RATE = 8
+MET_RATE = 2
+TICK = 1.0 / MET_RATE                      # one generator step = one met sample
+EEG_PER_TICK = EEG_RATE // MET_RATE
+POW_PER_TICK = POW_RATE // MET_RATE
+CHANNELS = ('AF3', 'T7', 'Pz', 'T8', 'AF4')
+BANDS = ('theta', 'alpha', 'betaL', 'betaH', 'gamma')
+
+# Flatten scenario steps into Markov states
+STATES = [(name, step) for name, steps in SCENARIOS.items() for step in range(len(steps))]
+STATE_TARGETS = np.array([SCENARIOS[name][step] for name, step in STATES], dtype=np.float64)
+
+
+def build_transition_matrix(p_next: float = 0.75, p_back: float = 0.15) -> np.ndarray:
+    """
+    Row-stochastic transition matrix over STATES.
+
+    Within a scenario a user mostly moves forward, sometimes relapses one
+    step and otherwise jumps to the start of some scenario. From a final step
+    the user starts any scenario.
+    """
+    n = len(STATES)
+    starts = [i for i, (_, step) in enumerate(STATES) if step == 0]
+    p = np.zeros((n, n))
+    for i, (name, step) in enumerate(STATES):
+        last = step == len(SCENARIOS[name]) - 1
+        if last:
+            p[i, starts] = 1.0 / len(starts)
+            continue
+        p[i, i + 1] += p_next
+        if step > 0:
+            p[i, i - 1] += p_back
+        jump = 1.0 - p[i].sum()
+        p[i, starts] += jump / len(starts)
+    return p / p.sum(axis=1, keepdims=True)
+
+
+class SyntheticHeadset(Dispatcher):
+    """Per-user event source with the same streaming events and payloads as Cortex."""
+
+    _events_ = ['new_met_data', 'new_pow_data', 'new_eeg_data']
+
+    def __init__(self, session_id: str):
+        self.session_id = session_id
+
+
+class SyntheticSessionGenerator:
+    """
+    Vectorized generator for many concurrent virtual users.
+
+    Usage:
+        gen = SyntheticSessionGenerator(users=2000, seed=1)
+        gen.headsets[0].bind(new_met_data=handler)     # same as Cortex
+        gen.run(duration=600, realtime=False)
+    """
+
+    def __init__(self, users: int = 100, seed: Optional[int] = None, mean_dwell: float = 30.0,
+                 lag: float = 8.0, noise: float = 0.03, streams=('met', 'pow', 'eeg'),
+                 batch_sink: Optional[Callable[[str, List[str], np.ndarray, np.ndarray], None]] = None):
+        """
+        Initialize generator.
+
+        Args:
+            users: Number of concurrent virtual users
+            seed: Random seed for reproducible load
+            mean_dwell: Mean time spent in a scenario state (seconds)
+            lag: Time constant with which metrics follow the state target (seconds)
+            noise: Metric noise per sqrt(second)
+            streams: Streams to generate
+            batch_sink: Optional sink called as sink(stream, session_ids, times, values)
+                with values shaped (users, samples, width); bypasses per-sample events
+        """
+        self.users = users
+        self.rng = np.random.default_rng(seed)
+        self.mean_dwell = mean_dwell
+        self.alpha = 1.0 - np.exp(-TICK / lag)
+        self.noise = noise * np.sqrt(TICK)
+        self.streams = set(streams)
+        self.batch_sink = batch_sink
+
+        self.transitions = np.cumsum(build_transition_matrix(), axis=1)
+        self.session_ids = [f"synthetic-{i:05d}" for i in range(users)]
+        self.headsets = [SyntheticHeadset(sid) for sid in self.session_ids]
+
+        # Per-user state
+        starts = np.array([i for i, (_, step) in enumerate(STATES) if step == 0])
+        self.state = self.rng.choice(starts, users)
+        self.dwell = self.rng.exponential(mean_dwell, users)
+        self.bias = self.rng.normal(0, 0.05, (users, STATE_TARGETS.shape[1]))
+        self.metrics = np.clip(STATE_TARGETS[self.state] + self.bias, 0, 1)
+        self.long_excitement = self.metrics[:, 1].copy()
+
+        self.channel_gain = self.rng.lognormal(0, 0.2, (users, 1, len(CHANNELS), 1))
+        self.eeg_dc = self.rng.normal(4200, 80, (users, 1, len(CHANNELS)))
+        eeg_phase = self.rng.uniform(0, 2 * np.pi, (users, len(CHANNELS), 3))
+        self.eeg_cos = np.cos(eeg_phase)
+        self.eeg_sin = np.sin(eeg_phase)
+        self.sample = 0
+        self.stats = {'ticks': 0, 'transitions': 0, 'met': 0, 'pow': 0, 'eeg': 0}
+
+    def _advance_states(self):
+        self.dwell -= TICK
+        moving = np.flatnonzero(self.dwell <= 0)
+        if len(moving):
+            u = self.rng.random(len(moving))
+            self.state[moving] = (u[:, None] > self.transitions[self.state[moving]]).sum(axis=1)
+            self.dwell[moving] = self.rng.exponential(self.mean_dwell, len(moving))
+            self.stats['transitions'] += len(moving)
+
+        target = np.clip(STATE_TARGETS[self.state] + self.bias, 0, 1)
+        self.metrics += (target - self.metrics) * self.alpha + self.rng.normal(0, self.noise, self.metrics.shape)
+        np.clip(self.metrics, 0, 1, out=self.metrics)
+        self.long_excitement += (self.metrics[:, 1] - self.long_excitement) * 0.01
+
+    def _met(self) -> np.ndarray:
+        """(users, 1, 13) in Cortex met order; isActive flags are 1.0."""
+        eng, exc, stress, rel, interest, attention = self.metrics.T
+        ones = np.ones(self.users)
+        return np.stack([ones, eng, ones, exc, self.long_excitement, ones, stress,
+                         ones, rel, ones, interest, ones, attention], axis=1)[:, None, :]
+
+    def _band_levels(self) -> np.ndarray:
+        """(users, bands) mean band power implied by the metrics."""
+        eng, exc, stress, rel, _, attention = self.metrics.T
+        return np.stack([
+            4.0 * (1.2 - attention),      # theta: drowsy / unfocused
+            3.0 * (0.5 + rel),            # alpha: relaxed
+            1.5 * (0.5 + eng),            # low beta: engaged
+            0.8 * (0.5 + stress),         # high beta: stressed
+            0.3 * (0.5 + exc),            # gamma: aroused
+        ], axis=1)
+
+    def _pow(self, levels: np.ndarray) -> np.ndarray:
+        """(users, 4, 25) band power, channel-major like Cortex (AF3/theta, AF3/alpha, ...)."""
+        noise = self.rng.lognormal(0, 0.25, (self.users, POW_PER_TICK, len(CHANNELS), len(BANDS)))
+        values = levels[:, None, None, :] * self.channel_gain * noise
+        return values.reshape(self.users, POW_PER_TICK, -1)
+
+    def _eeg(self, levels: np.ndarray) -> np.ndarray:
+        """(users, 64, 9) rows: COUNTER, INTERPOLATED, 5 channels, RAW_CQ, MARKER_HARDWARE."""
+        t = (self.sample + np.arange(EEG_PER_TICK)) / EEG_RATE
+        freqs = np.array([6.0, 10.0, 20.0])                     # theta, alpha, beta
+        amps = np.sqrt(levels[:, [0, 1, 3]]) * 6.0              # microvolts
+        # sin(wt + phase) = sin(wt)cos(phase) + cos(wt)sin(phase): the per-sample
+        # trig is shared by all users and per-user phases fold into one matmul
+        wt = 2 * np.pi * freqs * t[:, None]                     # (64, 3)
+        basis = np.concatenate([np.sin(wt), np.cos(wt)], axis=1)            # (64, 6)
+        weight = amps[:, None, :] * self.channel_gain[:, 0]                 # (U, C, 3)
+        weight = np.concatenate([weight * self.eeg_cos, weight * self.eeg_sin], axis=2)
+        signal = (weight @ basis.T).transpose(0, 2, 1)                      # (U, 64, C)
+        channels = self.eeg_dc + signal + self.rng.normal(0, 4.0, signal.shape)
+
+        rows = np.zeros((self.users, EEG_PER_TICK, 9))
+        rows[:, :, 0] = (self.sample + np.arange(EEG_PER_TICK)) % EEG_RATE
+        rows[:, :, 2:7] = channels
+        return rows
+
+    def step(self, start_time: float):
+        """Generate and emit one 0.5 s tick for all users."""
+        self._advance_states()
+        levels = self._band_levels()
+        batches = {}
+        if 'met' in self.streams:
+            batches['met'] = (np.array([start_time]), self._met())
+        if 'pow' in self.streams:
+            batches['pow'] = (start_time + np.arange(POW_PER_TICK) / POW_RATE, self._pow(levels))
+        if 'eeg' in self.streams:
+            batches['eeg'] = (start_time + np.arange(EEG_PER_TICK) / EEG_RATE, self._eeg(levels))
+
+        for stream, (times, values) in batches.items():
+            self.stats[stream] += values.shape[0] * values.shape[1]
+            if self.batch_sink is not None:
+                self.batch_sink(stream, self.session_ids, times, values)
+            else:
+                self._emit(stream, times, values)
+
+        self.sample += EEG_PER_TICK
+        self.stats['ticks'] += 1
+
+    def _emit(self, stream: str, times: np.ndarray, values: np.ndarray):
+        event = f"new_{stream}_data"
+        times = times.tolist()
+        for headset, rows in zip(self.headsets, values.tolist()):
+            for t, row in zip(times, rows):
+                if stream == 'met':
+                    row = [bool(v) if i in (0, 2, 5, 7, 9, 11) else v for i, v in enumerate(row)]
+                headset.emit(event, data={stream: row, 'time': t})
+
+    def run(self, duration: float, realtime: bool = False, start_time: Optional[float] = None) -> Dict:
+        """
+        Generate `duration` seconds of data.
+
+        Args:
+            duration: Simulated seconds
+            realtime: Pace ticks to the wall clock instead of running flat out
+            start_time: Timestamp of the first sample (default: now)
+
+        Returns:
+            Counters and achieved throughput
+        """
+        start_time = time.time() if start_time is None else start_time
+        wall_start = time.monotonic()
+        ticks = int(duration / TICK)
+
+        for i in range(ticks):
+            if realtime:
+                delay = wall_start + i * TICK - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+            self.step(start_time + i * TICK)
+
+        elapsed = time.monotonic() - wall_start
+        samples = self.stats['met'] + self.stats['pow'] + self.stats['eeg']
+        return {**self.stats, 'elapsed': round(elapsed, 3),
+                'samples_per_second': round(samples / elapsed) if elapsed else None,
+                'realtime_factor': round(duration / elapsed, 1) if elapsed else None}
+
+    def state_names(self) -> List[str]:
+        """Current scenario state of every user, e.g. 'anxiety_crisis/2'."""
+        return [f"{STATES[s][0]}/{STATES[s][1]}" for s in self.state]
+
+
+if __name__ == "__main__":
+    import argparse
+    from collections import Counter
+    from emotion_analyzer import EmotionAnalyzer
+
+    parser = argparse.ArgumentParser(description='Synthetic multi-stream session generator')
+    parser.add_argument('--users', type=int, default=1000)
+    parser.add_argument('--duration', type=float, default=60.0, help='Simulated seconds')
+    parser.add_argument('--realtime', action='store_true')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    # Batch path: raw generation throughput, all three streams
+    gen = SyntheticSessionGenerator(users=args.users, seed=args.seed, batch_sink=lambda *a: None)
+    result = gen.run(args.duration, realtime=args.realtime)
+    print(f"Batch sink, {args.users} users x {args.duration:.0f}s: {result}")
+
+    # Event path: per-sample Cortex-style events into per-session analyzers
+    users = min(args.users, 200)
+    gen = SyntheticSessionGenerator(users=users, seed=args.seed, streams=('met',))
+    analyzers = {}
+    emotions = Counter()
+
+    def make_handler(session_id):
+        analyzer = analyzers[session_id] = EmotionAnalyzer()
+
+        def on_met(*args, **kwargs):
+            met = kwargs['data']['met']
+            metrics = {'engagement': met[1], 'excitement': met[3], 'stress': met[6],
+                       'relaxation': met[8], 'interest': met[10], 'attention': met[12]}
+            emotions[analyzer.analyze_emotion(metrics, kwargs['data']['time'])['emotion']] += 1
+        return on_met
+
+    for headset in gen.headsets:
+        headset.bind(new_met_data=make_handler(headset.session_id))
+
+    result = gen.run(args.duration * 5)
+    print(f"Event path, {users} users x {args.duration * 5:.0f}s met: {result}")
+    print(f"Emotion mix: {dict(emotions.most_common(8))}")
@@ -5,11 +5,24 @@ Simple WebSocket client to test emotion streaming.
 
 import asyncio
 import json
+import argparse
 import websockets
+from urllib.parse import urlencode
 
-async def test_emotion_websocket():
-    """Test connection to emotion WebSocket server."""
-    uri = "ws://localhost:8765"
+async def test_emotion_websocket(fields: str = None, transitions: bool = False):
+    """
+    Test connection to emotion WebSocket server.
+    
+    Args:
+        fields: Optional comma-separated fields to subscribe to (e.g. "emotion_id,timestamp")
+        transitions: Only receive events where the emotion changes
+    """
+    query = {}
+    if fields:
+        query['fields'] = fields
+    if transitions:
+        query['transitions'] = 1
+    uri = "ws://localhost:8765" + (f"/?{urlencode(query)}" if query else "")
     
     try:
         print(f"Connecting to {uri}...")
@@ -22,6 +35,10 @@ async def test_emotion_websocket():
                     message = await websocket.recv()
                     emotion_data = json.loads(message)
                     
+                    if fields or transitions:
+                        print(message)
+                        continue
+                    
                     # Pretty print emotion event
                     timestamp = emotion_data.get('timestamp', 0)
                     emotion = emotion_data.get('emotion', 'unknown')
@@ -50,4 +67,9 @@ async def test_emotion_websocket():
         print(f"Error: {e}")
 
 if __name__ == "__main__":
-    asyncio.run(test_emotion_websocket())
\ No newline at end of file
+    parser = argparse.ArgumentParser(description='Emotion WebSocket test client')
+    parser.add_argument('--fields', help='Comma-separated fields, e.g. emotion_id,timestamp')
+    parser.add_argument('--transitions', action='store_true', help='Only emotion changes')
+    args = parser.parse_args()
+    
+    asyncio.run(test_emotion_websocket(args.fields, args.transitions))
\ No newline at end of file
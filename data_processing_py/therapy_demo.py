@@ -11,6 +11,36 @@ import time
 import numpy as np
 from emotion_analyzer import EmotionAnalyzer
 
+# Scripted emotional progressions, one metric vector per step
+SCENARIOS = {
+    "anxiety_crisis": [
+        # [engagement, excitement, stress, relaxation, interest, attention]
+        [0.3, 0.2, 0.4, 0.7, 0.3, 0.4],  # Initial calm
+        [0.4, 0.5, 0.7, 0.5, 0.4, 0.6],  # Rising anxiety
+        [0.6, 0.8, 0.9, 0.2, 0.5, 0.8],  # Peak anxiety
+        [0.5, 0.6, 0.8, 0.3, 0.4, 0.7],  # Sustained high
+        [0.4, 0.4, 0.6, 0.5, 0.4, 0.6],  # Beginning to calm
+        [0.3, 0.3, 0.4, 0.7, 0.3, 0.5],  # Return to baseline
+    ],
+    "depression_episode": [
+        [0.5, 0.4, 0.5, 0.6, 0.5, 0.6],  # Normal baseline
+        [0.3, 0.2, 0.7, 0.3, 0.2, 0.3],  # Dropping mood
+        [0.2, 0.1, 0.8, 0.2, 0.1, 0.2],  # Deep depression
+        [0.1, 0.1, 0.9, 0.1, 0.1, 0.1],  # Severe episode
+        [0.2, 0.2, 0.8, 0.2, 0.2, 0.2],  # Still low
+        [0.3, 0.3, 0.6, 0.4, 0.3, 0.4],  # Slight improvement
+    ],
+    "anger_management": [
+        [0.6, 0.4, 0.3, 0.7, 0.5, 0.6],  # Calm baseline
+        [0.7, 0.6, 0.5, 0.6, 0.6, 0.7],  # Rising tension
+        [0.8, 0.9, 0.8, 0.2, 0.7, 0.9],  # Anger peak
+        [0.9, 0.9, 0.9, 0.1, 0.8, 0.9],  # Rage
+        [0.7, 0.7, 0.7, 0.3, 0.6, 0.7],  # De-escalating
+        [0.5, 0.4, 0.4, 0.6, 0.5, 0.5],  # Return to calm
+    ]
+}
+
+
 class TherapySession:
     """Simulates a therapy session with emotional progression."""
     
@@ -18,38 +48,16 @@ class TherapySession:
         self.analyzer = EmotionAnalyzer()
         self.session_data = []
         
-    def simulate_session(self, scenario: str = "anxiety_crisis"):
-        """Simulate a therapy session with realistic emotional progression."""
-        
-        scenarios = {
-            "anxiety_crisis": [
-                # [engagement, excitement, stress, relaxation, interest, attention]
-                [0.3, 0.2, 0.4, 0.7, 0.3, 0.4],  # Initial calm
-                [0.4, 0.5, 0.7, 0.5, 0.4, 0.6],  # Rising anxiety
-                [0.6, 0.8, 0.9, 0.2, 0.5, 0.8],  # Peak anxiety
-                [0.5, 0.6, 0.8, 0.3, 0.4, 0.7],  # Sustained high
-                [0.4, 0.4, 0.6, 0.5, 0.4, 0.6],  # Beginning to calm
-                [0.3, 0.3, 0.4, 0.7, 0.3, 0.5],  # Return to baseline
-            ],
-            "depression_episode": [
-                [0.5, 0.4, 0.5, 0.6, 0.5, 0.6],  # Normal baseline
-                [0.3, 0.2, 0.7, 0.3, 0.2, 0.3],  # Dropping mood
-                [0.2, 0.1, 0.8, 0.2, 0.1, 0.2],  # Deep depression
-                [0.1, 0.1, 0.9, 0.1, 0.1, 0.1],  # Severe episode
-                [0.2, 0.2, 0.8, 0.2, 0.2, 0.2],  # Still low
-                [0.3, 0.3, 0.6, 0.4, 0.3, 0.4],  # Slight improvement
-            ],
-            "anger_management": [
-                [0.6, 0.4, 0.3, 0.7, 0.5, 0.6],  # Calm baseline
-                [0.7, 0.6, 0.5, 0.6, 0.6, 0.7],  # Rising tension
-                [0.8, 0.9, 0.8, 0.2, 0.7, 0.9],  # Anger peak
-                [0.9, 0.9, 0.9, 0.1, 0.8, 0.9],  # Rage
-                [0.7, 0.7, 0.7, 0.3, 0.6, 0.7],  # De-escalating
-                [0.5, 0.4, 0.4, 0.6, 0.5, 0.5],  # Return to calm
-            ]
-        }
+    def simulate_session(self, scenario: str = "anxiety_crisis", step_delay: float = 0.5):
+        """
+        Simulate a therapy session with realistic emotional progression.
         
-        data_sequence = scenarios.get(scenario, scenarios["anxiety_crisis"])
+        Args:
+            scenario: Key of SCENARIOS
+            step_delay: Pause between printed steps (0 for no pause); use
+                synthetic_sessions.py for load generation
+        """
+        data_sequence = SCENARIOS.get(scenario, SCENARIOS["anxiety_crisis"])
         start_time = time.time()
         
         print(f"=== Therapy Session: {scenario.replace('_', ' ').title()} ===")
@@ -84,7 +92,8 @@ class TherapySession:
             print(f"    Stress: {metrics[2]:.2f}, Relaxation: {metrics[3]:.2f}")
             print()
             
-            time.sleep(0.5)  # Brief pause for readability
+            if step_delay > 0:
+                time.sleep(step_delay)  # Brief pause for readability
     
     def generate_therapy_report(self):
         """Generate comprehensive therapy session report."""
@@ -148,9 +157,7 @@ def run_therapy_demo():
     print()
     
     # Run different scenarios
-    scenarios = ["anxiety_crisis", "depression_episode", "anger_management"]
-    
-    for scenario in scenarios:
+    for scenario in SCENARIOS:
         session.session_data.clear()  # Reset for each scenario
         session.simulate_session(scenario)
         
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""
+Per-User Baselines
+
+Keeps a running mean and variance per performance metric and per band-power
+channel for each user (Welford updates), persists them in a small fixed-size
+binary file per user, and normalizes live values against them in constant
+time.
+
+A metric value is mapped so that the user's own resting level lands at the
+centre of the emotion prototype scale:
+
+    normalized = TARGET_MEAN + (value - user_mean) / user_std * TARGET_STD
+
+Every baseline starts from a population prior worth PRIOR_COUNT samples
+(mean TARGET_MEAN, std TARGET_STD), under which the mapping is the identity.
+A new user therefore gets exactly the old clamp-only behaviour from the
+first sample, with no calibration or warm-up, and drifts towards their own
+baseline as samples accumulate across sessions.
+"""
+
+import os
+import re
+import math
+import time
+import struct
+import threading
+from typing import Dict, List
+
+METRIC_FEATURES = ('engagement', 'excitement', 'stress', 'relaxation', 'interest', 'attention', 'focus')
+CHANNELS = ('AF3', 'T7', 'Pz', 'T8', 'AF4')
+BAND_NAMES = ('theta', 'alpha', 'betaL', 'betaH', 'gamma')
+# Same order as the Cortex 'pow' stream labels
+BAND_FEATURES = tuple(f"{channel}/{band}" for channel in CHANNELS for band in BAND_NAMES)
+FEATURES = METRIC_FEATURES + BAND_FEATURES
+
+TARGET_MEAN = 0.5
+TARGET_STD = 0.15
+PRIOR_COUNT = 20
+
+# File layout: magic, feature count, then count/mean/m2 arrays (little-endian float64)
+_MAGIC = b'UBL1'
+_HEADER = struct.Struct('<4sH')
+
+
+class UserBaseline:
+    """
+    Running per-feature statistics for one user.
+
+    Metric features are normalized onto the 0-1 prototype scale; band
+    features (log10 power) are normalized to z-scores.
+    """
+
+    def __init__(self, user_id: str, max_count: int = 20000, min_std: float = 0.02):
+        """
+        Initialize baseline at the population prior.
+
+        Args:
+            user_id: User the baseline belongs to
+            max_count: Cap on the effective sample count; beyond it older
+                samples decay so the baseline follows slow drift
+            min_std: Floor on the standard deviation (avoids blowing up
+                near-constant signals)
+        """
+        self.user_id = user_id
+        self.max_count = max_count
+        self.min_std = min_std
+        self.index = {name: i for i, name in enumerate(FEATURES)}
+
+        n_metrics = len(METRIC_FEATURES)
+        n_bands = len(BAND_FEATURES)
+        self.count = [float(PRIOR_COUNT)] * n_metrics + [0.0] * n_bands
+        self.mean = [TARGET_MEAN] * n_metrics + [0.0] * n_bands
+        self.m2 = [TARGET_STD ** 2 * (PRIOR_COUNT - 1)] * n_metrics + [0.0] * n_bands
+
+        # normalized = value * scale + offset, refreshed on every update
+        self.scale = [1.0] * len(FEATURES)
+        self.offset = [0.0] * len(FEATURES)
+        for i in range(len(FEATURES)):
+            self._refresh(i)
+
+        self._lock = threading.Lock()
+        self.updated_at = 0.0
+
+    def _refresh(self, i: int):
+        n = self.count[i]
+        if n < 2:
+            # No band baseline yet: z = 0 (metrics always carry the prior)
+            self.scale[i], self.offset[i] = 0.0, 0.0
+            return
+        std = max(math.sqrt(self.m2[i] / (n - 1)), self.min_std)
+        if i < len(METRIC_FEATURES):
+            self.scale[i] = TARGET_STD / std
+            self.offset[i] = TARGET_MEAN - self.mean[i] * self.scale[i]
+        else:
+            self.scale[i] = 1.0 / std
+            self.offset[i] = -self.mean[i] / std
+
+    def update(self, name: str, value: float):
+        """Fold one sample into a feature's statistics (O(1)). Unknown names are ignored."""
+        i = self.index.get(name)
+        if i is None:
+            return
+        if i >= len(METRIC_FEATURES):
+            value = math.log10(max(value, 1e-6))
+        with self._lock:
+            n = self.count[i]
+            if n >= self.max_count:
+                # Decay: forget one sample's worth before adding the new one
+                self.m2[i] *= (self.max_count - 1) / self.max_count
+                n = self.max_count - 1
+            n += 1
+            delta = value - self.mean[i]
+            self.mean[i] += delta / n
+            self.m2[i] += delta * (value - self.mean[i])
+            self.count[i] = n
+            self._refresh(i)
+        self.updated_at = time.time()
+
+    def update_metrics(self, metrics: Dict[str, float]):
+        """Fold in a dict of metric values (only pass metrics that are active)."""
+        for name, value in metrics.items():
+            self.update(name, float(value))
+
+    def update_bands(self, pow_values: List[float]):
+        """Fold in one Cortex 'pow' sample (25 values, BAND_FEATURES order)."""
+        for name, value in zip(BAND_FEATURES, pow_values):
+            self.update(name, float(value))
+
+    def normalize(self, name: str, value: float) -> float:
+        """Metric value on the prototype scale, clamped to [0, 1]; unknown names are only clamped."""
+        i = self.index.get(name)
+        if i is not None:
+            value = value * self.scale[i] + self.offset[i]
+        return max(0.0, min(1.0, value))
+
+    def normalize_bands(self, pow_values: List[float]) -> Dict[str, float]:
+        """z-scores of log band power against this user's baseline."""
+        base = len(METRIC_FEATURES)
+        return {
+            name: round(math.log10(max(value, 1e-6)) * self.scale[base + k] + self.offset[base + k], 3)
+            for k, (name, value) in enumerate(zip(BAND_FEATURES, pow_values))
+        }
+
+    def stats(self) -> Dict[str, Dict[str, float]]:
+        """Mean, std and effective sample count per feature."""
+        return {
+            name: {
+                'mean': round(self.mean[i], 4),
+                'std': round(math.sqrt(self.m2[i] / (self.count[i] - 1)), 4) if self.count[i] > 1 else None,
+                'count': self.count[i]
+            }
+            for name, i in self.index.items()
+        }
+
+    def to_bytes(self) -> bytes:
+        n = len(FEATURES)
+        with self._lock:
+            values = self.count + self.mean + self.m2
+        return _HEADER.pack(_MAGIC, n) + struct.pack(f'<{3 * n}d', *values)
+
+    @classmethod
+    def from_bytes(cls, user_id: str, data: bytes, **kwargs) -> 'UserBaseline':
+        baseline = cls(user_id, **kwargs)
+        magic, n = _HEADER.unpack_from(data)
+        if magic != _MAGIC or n != len(FEATURES) or len(data) != _HEADER.size + 24 * n:
+            raise ValueError(f"Incompatible baseline file for {user_id}")
+        values = struct.unpack_from(f'<{3 * n}d', data, _HEADER.size)
+        baseline.count = list(values[:n])
+        baseline.mean = list(values[n:2 * n])
+        baseline.m2 = list(values[2 * n:])
+        for i in range(n):
+            baseline._refresh(i)
+        return baseline
+
+
+class BaselineStore:
+    """
+    One baseline file per user in a directory.
+
+    Usage:
+        store = BaselineStore("baselines")
+        baseline = store.load("user-42")       # prior if the user is new
+        analyzer = EmotionAnalyzer(baseline=baseline)
+        ...
+        store.save(baseline)
+    """
+
+    def __init__(self, directory: str = "baselines"):
+        self.directory = directory
+        os.makedirs(directory, exist_ok=True)
+
+    def path(self, user_id: str) -> str:
+        safe = re.sub(r'[^A-Za-z0-9_.-]', '_', user_id)
+        return os.path.join(self.directory, f"{safe}.bin")
+
+    def load(self, user_id: str, **kwargs) -> UserBaseline:
+        """Load a user's baseline; a new or unreadable file yields the prior."""
+        try:
+            with open(self.path(user_id), 'rb') as f:
+                return UserBaseline.from_bytes(user_id, f.read(), **kwargs)
+        except FileNotFoundError:
+            return UserBaseline(user_id, **kwargs)
+        except (ValueError, struct.error) as e:
+            print(f"Error loading baseline for {user_id}, starting from prior: {e}")
+            return UserBaseline(user_id, **kwargs)
+
+    def save(self, baseline: UserBaseline):
+        """Write atomically so a crash never leaves a torn file."""
+        path = self.path(baseline.user_id)
+        tmp = f"{path}.tmp"
+        with open(tmp, 'wb') as f:
+            f.write(baseline.to_bytes())
+        os.replace(tmp, path)
+
+
+if __name__ == "__main__":
+    import random
+    import tempfile
+    from emotion_analyzer import EmotionAnalyzer
+
+    store = BaselineStore(tempfile.mkdtemp())
+
+    # A user whose resting stress sits high and relaxation low
+    def resting_sample():
+        return {
+            'engagement': random.gauss(0.5, 0.08), 'excitement': random.gauss(0.45, 0.08),
+            'stress': random.gauss(0.72, 0.05), 'relaxation': random.gauss(0.3, 0.05),
+            'interest': random.gauss(0.5, 0.08)
+        }
+
+    baseline = store.load("demo-user")
+    for _ in range(2000):
+        baseline.update_metrics(resting_sample())
+    baseline.update_bands([5.2, 4.7, 3.2, 1.2, 0.3] * 5)
+    store.save(baseline)
+    print(f"Saved {os.path.getsize(store.path('demo-user'))} bytes")
+
+    t0 = time.perf_counter()
+    for _ in range(1000):
+        loaded = store.load("demo-user")
+    print(f"Load: {(time.perf_counter() - t0) * 1000:.1f} us/user")
+
+    t0 = time.perf_counter()
+    for _ in range(100000):
+        loaded.normalize('stress', 0.7)
+    print(f"Normalize: {(time.perf_counter() - t0) * 10:.3f} us/value")
+
+    plain = EmotionAnalyzer()
+    personal = EmotionAnalyzer(baseline=loaded)
+    counts = {'plain': {}, 'baseline': {}}
+    for _ in range(500):
+        sample = resting_sample()
+        for key, analyzer in (('plain', plain), ('baseline', personal)):
+            emotion = analyzer.analyze_emotion(sample, time.time())['emotion']
+            counts[key][emotion] = counts[key].get(emotion, 0) + 1
+    for key, c in counts.items():
+        top = sorted(c.items(), key=lambda kv: -kv[1])[:3]
+        print(f"Resting state, {key:>8}: {top}")
@@ -15,6 +15,8 @@ from datetime import datetime, timedelta
 from typing import Dict, List, Optional, Tuple
 import json
 
+from downsample import lttb
+
 def create_emotion_timeline(events: List[Dict], save_path: str = None) -> plt.Figure:
     """
     Create timeline visualization of emotion events.
@@ -183,13 +185,16 @@ def create_emotion_heatmap(events: List[Dict], save_path: str = None) -> plt.Fig
     
     return fig
 
-def create_metrics_dashboard(events: List[Dict], save_path: str = None) -> plt.Figure:
+def create_metrics_dashboard(events: List[Dict], save_path: str = None,
+                             max_points: Optional[int] = 2000) -> plt.Figure:
     """
     Create comprehensive metrics dashboard.
     
     Args:
         events: List of emotion events
         save_path: Optional path to save the figure
+        max_points: Downsample each metric line (LTTB) to at most this many
+            points; None plots every event
         
     Returns:
         Matplotlib figure
@@ -219,13 +224,17 @@ def create_metrics_dashboard(events: List[Dict], save_path: str = None) -> plt.F
     
     for i, (metric_name, values) in enumerate(metrics.items()):
         ax = axes[i//2, i%2] if i < 5 else axes[2, 0]
-        ax.plot(relative_times, values, color=colors[metric_name], linewidth=2, marker='o', markersize=3)
+        line_times, values = np.asarray(relative_times, dtype=float), np.asarray(values, dtype=float)
+        if max_points and len(values) > max_points:
+            keep = lttb(line_times, values, max_points)
+            line_times, values = line_times[keep], values[keep]
+        ax.plot(line_times, values, color=colors[metric_name], linewidth=2, marker='o', markersize=3)
         ax.set_title(f'{metric_name.title()} Over Time', fontweight='bold')
         ax.set_xlabel('Time (seconds)')
         ax.set_ylabel('Intensity')
         ax.set_ylim(0, 1.1)
         ax.grid(True, alpha=0.3)
-        ax.fill_between(relative_times, 0, values, alpha=0.3, color=colors[metric_name])
+        ax.fill_between(line_times, 0, values, alpha=0.3, color=colors[metric_name])
     
     # Plot 6: Emotion correlation matrix
     if len(events) > 1:
@@ -0,0 +1,190 @@
+"use client"
+
+import { muxClient, MuxClient } from "../manager/mux"
+
+// Same estimator as data_processing_py/clock_sync.py: NTP-style exchanges over
+// the mux control channel, the lowest-delay sample of each group, and a line
+// fitted through those for offset and drift. All times are in seconds.
+
+const WINDOW = 128
+const GROUP = 8
+// Quick pings right after (re)connecting, then one every INTERVAL_MS
+const BURST = 8
+const BURST_INTERVAL_MS = 100
+const INTERVAL_MS = 2000
+const PING_TIMEOUT_MS = 10000
+
+interface ClockSample {
+  local: number
+  // backend - browser
+  offset: number
+  delay: number
+}
+
+interface ClockFit {
+  ref: number
+  offset: number
+  drift: number
+  uncertainty: number
+}
+
+export interface ClockState {
+  synced: boolean
+  samples: number
+  offsetMs: number
+  driftPpm: number
+  uncertaintyMs: number
+}
+
+/** Browser wall clock in seconds, monotonic for the life of the page */
+export const localNow = () => (performance.timeOrigin + performance.now()) / 1000
+
+export class ClockSync {
+  private _samples: ClockSample[] = []
+  private _fit: ClockFit | null = null
+  private _timer: ReturnType<typeof setTimeout> | null = null
+  private _pending = new Map<number, number>()
+  private _lastExchange: number[] | null = null
+  private _nextId = 1
+  private _sent = 0
+
+  constructor(private _mux: MuxClient) {
+    _mux.on("status", this._onStatus)
+    _mux.on("control", this._onControl)
+  }
+
+  /** Backend time now */
+  now() {
+    return this.toBackend(localNow())
+  }
+
+  toBackend(localTime: number) {
+    return localTime + this._offsetAt(localTime)
+  }
+
+  toLocal(backendTime: number) {
+    return backendTime - this._offsetAt(backendTime)
+  }
+
+  /** Milliseconds from a backend timestamp (e.g. an event's synced_timestamp) until now */
+  latencyMs(backendTime: number) {
+    return (this.now() - backendTime) * 1000
+  }
+
+  state(): ClockState {
+    const fit = this._estimate()
+    return {
+      synced: fit !== null,
+      samples: this._samples.length,
+      offsetMs: fit ? this._offsetAt(localNow()) * 1000 : 0,
+      driftPpm: fit ? fit.drift * 1e6 : 0,
+      uncertaintyMs: fit ? fit.uncertainty * 1000 : 0,
+    }
+  }
+
+  private _onStatus = (connected: boolean) => {
+    if (this._timer) {
+      clearTimeout(this._timer)
+      this._timer = null
+    }
+    this._pending.clear()
+    this._lastExchange = null
+    if (connected) {
+      this._sent = 0
+      this._schedule(0)
+    }
+  }
+
+  private _schedule(delay: number) {
+    this._timer = setTimeout(() => this._ping(), delay)
+  }
+
+  private _ping() {
+    const t0 = localNow()
+    for (const [id, sent] of this._pending) {
+      if ((t0 - sent) * 1000 > PING_TIMEOUT_MS) {
+        this._pending.delete(id)
+      }
+    }
+
+    const id = this._nextId++
+    this._pending.set(id, t0)
+    // The previous exchange rides along so the backend can estimate our clock too
+    this._mux.sendJSON("control", { type: "ping", id, t0, sample: this._lastExchange })
+    this._sent += 1
+    this._schedule(this._sent < BURST ? BURST_INTERVAL_MS : INTERVAL_MS)
+  }
+
+  private _onControl = (message: any) => {
+    if (message.type !== "pong") {
+      return
+    }
+    const t3 = localNow()
+    const t0 = this._pending.get(message.id)
+    if (t0 === undefined) {
+      return
+    }
+    this._pending.delete(message.id)
+
+    const { t1, t2 } = message
+    this._lastExchange = [t0, t1, t2, t3]
+    this._samples.push({
+      local: (t0 + t3) / 2,
+      offset: (t1 - t0 + (t2 - t3)) / 2,
+      delay: Math.max(0, t3 - t0 - (t2 - t1)),
+    })
+    if (this._samples.length > WINDOW) {
+      this._samples.shift()
+    }
+    this._fit = null
+  }
+
+  private _offsetAt(localTime: number) {
+    const fit = this._estimate()
+    return fit ? fit.offset + fit.drift * (localTime - fit.ref) : 0
+  }
+
+  private _estimate(): ClockFit | null {
+    if (this._fit || !this._samples.length) {
+      return this._fit
+    }
+
+    // Groups aligned to the newest sample; a partial oldest group only counts
+    // while there is nothing better
+    const best: ClockSample[] = []
+    for (let end = this._samples.length; end > 0; end -= GROUP) {
+      const group = this._samples.slice(Math.max(0, end - GROUP), end)
+      best.unshift(group.reduce((a, b) => (b.delay < a.delay ? b : a)))
+    }
+    if (best.length > 2 && this._samples.length % GROUP) {
+      best.shift()
+    }
+
+    const ref = best[best.length - 1].local
+    let offset = best[best.length - 1].offset
+    let drift = 0
+    if (best.length >= 4) {
+      const n = best.length
+      const meanX = best.reduce((sum, s) => sum + s.local - ref, 0) / n
+      const meanY = best.reduce((sum, s) => sum + s.offset, 0) / n
+      let sxx = 0
+      let sxy = 0
+      for (const s of best) {
+        sxx += (s.local - ref - meanX) ** 2
+        sxy += (s.local - ref - meanX) * (s.offset - meanY)
+      }
+      drift = sxx ? sxy / sxx : 0
+      offset = meanY - drift * meanX
+    }
+
+    this._fit = {
+      ref,
+      offset,
+      drift,
+      uncertainty: Math.min(...best.map((s) => s.delay)) / 2,
+    }
+    return this._fit
+  }
+}
+
+export const clockSync = new ClockSync(muxClient)
@@ -1,8 +1,8 @@
 "use client"
 
 import { IMicrophoneAudioTrack } from "agora-rtc-sdk-ng"
-import { normalizeFrequencies } from "./utils"
-import { useState, useEffect, useMemo, useRef } from "react"
+import { normalizeDb } from "./utils"
+import { useEffect, useMemo, useRef } from "react"
 import type { AppDispatch, AppStore, RootState } from "../store"
 import { useDispatch, useSelector, useStore } from "react-redux"
 
@@ -10,17 +10,43 @@ export const useAppDispatch = useDispatch.withTypes<AppDispatch>()
 export const useAppSelector = useSelector.withTypes<RootState>()
 export const useAppStore = useStore.withTypes<AppStore>()
 
+export interface MultibandVolume {
+  // Per-band level in [0, 1]; the same array is rewritten every frame.
+  bands: Float32Array
+  subscribe: (listener: (bands: Float32Array) => void) => () => void
+}
+
 export const useMultibandTrackVolume = (
   track?: IMicrophoneAudioTrack | MediaStreamTrack,
   bands: number = 5,
   loPass: number = 100,
   hiPass: number = 600,
-) => {
-  const [frequencyBands, setFrequencyBands] = useState<Float32Array[]>([])
+): MultibandVolume => {
+  // Stable across renders so consumers can subscribe once and paint
+  // imperatively instead of re-rendering on every analyser frame.
+  const { volume, notify } = useMemo(() => {
+    const listeners = new Set<(bands: Float32Array) => void>()
+    const volume: MultibandVolume = {
+      bands: new Float32Array(bands),
+      subscribe: (listener) => {
+        listeners.add(listener)
+        listener(volume.bands)
+        return () => {
+          listeners.delete(listener)
+        }
+      },
+    }
+    const notify = () => listeners.forEach((listener) => listener(volume.bands))
+    return { volume, notify }
+  }, [bands])
 
   useEffect(() => {
+    const levels = volume.bands
+
     if (!track) {
-      return setFrequencyBands(new Array(bands).fill(new Float32Array(0)))
+      levels.fill(0)
+      notify()
+      return
     }
 
     const ctx = new AudioContext()
@@ -35,36 +61,40 @@ export const useMultibandTrackVolume = (
 
     const bufferLength = analyser.frequencyBinCount
     const dataArray = new Float32Array(bufferLength)
+    const lo = Math.min(loPass, bufferLength)
+    const hi = Math.min(hiPass, bufferLength)
+    const chunkSize = Math.ceil((hi - lo) / bands)
 
+    let frame = 0
     const updateVolume = () => {
       analyser.getFloatFrequencyData(dataArray)
-      let frequencies: Float32Array = new Float32Array(dataArray.length)
-      for (let i = 0; i < dataArray.length; i++) {
-        frequencies[i] = dataArray[i]
-      }
-      frequencies = frequencies.slice(loPass, hiPass)
-
-      const normalizedFrequencies = normalizeFrequencies(frequencies)
-      const chunkSize = Math.ceil(normalizedFrequencies.length / bands)
-      const chunks: Float32Array[] = []
-      for (let i = 0; i < bands; i++) {
-        chunks.push(
-          normalizedFrequencies.slice(i * chunkSize, (i + 1) * chunkSize),
-        )
+
+      // Reduce straight from the analyser buffer: each band level is the
+      // root of the mean normalized dB value over its slice of bins.
+      for (let b = 0; b < bands; b++) {
+        const start = lo + b * chunkSize
+        const end = Math.min(start + chunkSize, hi)
+        let sum = 0
+        for (let i = start; i < end; i++) {
+          sum += normalizeDb(dataArray[i])
+        }
+        levels[b] = sum > 0 ? Math.sqrt(sum / (end - start)) : 0
       }
 
-      setFrequencyBands(chunks)
+      notify()
+      frame = requestAnimationFrame(updateVolume)
     }
 
-    const interval = setInterval(updateVolume, 10)
+    frame = requestAnimationFrame(updateVolume)
 
     return () => {
+      cancelAnimationFrame(frame)
       source.disconnect()
-      clearInterval(interval)
+      ctx.close()
     }
-  }, [track, loPass, hiPass, bands])
+  }, [track, loPass, hiPass, bands, volume, notify])
 
-  return frequencyBands
+  return volume
 }
 
 export const useAutoScroll = (ref: React.RefObject<HTMLElement | null>) => {
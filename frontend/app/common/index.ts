@@ -4,3 +4,5 @@ export * from "./utils"
 export * from "./storage"
 export * from "./request"
 export * from "./mock"
+export * from "./clock"
+export * from "./pcm"
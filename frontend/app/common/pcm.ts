@@ -0,0 +1,92 @@
+"use client"
+
+import { localNow } from "./clock"
+
+// Microphone PCM for server-side analysis (data_processing_py/prosody.py):
+// 16 kHz mono int16, batched into CHUNK_MS messages, each prefixed with the
+// capture time of its first sample as a little-endian float64 (seconds,
+// browser clock; the gateway maps it onto the backend clock).
+
+export const PCM_SAMPLE_RATE = 16000
+const CHUNK_MS = 100
+const HEADER_BYTES = 8
+
+// Runs on the audio thread: forwards each 128-sample render quantum with its context time
+const WORKLET_SOURCE = `
+class PcmTap extends AudioWorkletProcessor {
+  process(inputs) {
+    const channel = inputs[0] && inputs[0][0]
+    if (channel) {
+      this.port.postMessage({ time: currentTime, samples: channel.slice() })
+    }
+    return true
+  }
+}
+registerProcessor("pcm-tap", PcmTap)
+`
+
+/**
+ * Tap a source node and emit 16 kHz PCM chunks. Returns a function that stops the tap.
+ */
+export async function startPcmTap(
+  context: AudioContext,
+  source: AudioNode,
+  onChunk: (chunk: ArrayBuffer) => void,
+): Promise<() => void> {
+  const url = URL.createObjectURL(new Blob([WORKLET_SOURCE], { type: "application/javascript" }))
+  try {
+    await context.audioWorklet.addModule(url)
+  } finally {
+    URL.revokeObjectURL(url)
+  }
+  const node = new AudioWorkletNode(context, "pcm-tap")
+
+  const ratio = context.sampleRate / PCM_SAMPLE_RATE
+  const chunkSamples = (PCM_SAMPLE_RATE * CHUNK_MS) / 1000
+  let pcm = new Int16Array(chunkSamples)
+  let filled = 0
+  let chunkStart = 0
+  // Fractional input position carried across render quanta
+  let position = 0
+
+  node.port.onmessage = ({ data }: MessageEvent<{ time: number; samples: Float32Array }>) => {
+    const { time, samples } = data
+    // Context time -> browser wall clock
+    const stamp = context.getOutputTimestamp()
+    const wallTime =
+      stamp.contextTime !== undefined && stamp.performanceTime !== undefined
+        ? (performance.timeOrigin + stamp.performanceTime) / 1000 - (stamp.contextTime - time)
+        : localNow() - samples.length / context.sampleRate
+
+    // Box-filter decimation: average the input samples behind each output sample
+    while (position < samples.length) {
+      const from = Math.floor(position)
+      const to = Math.min(samples.length, Math.max(from + 1, Math.floor(position + ratio)))
+      let sum = 0
+      for (let i = from; i < to; i++) {
+        sum += samples[i]
+      }
+      if (filled === 0) {
+        chunkStart = wallTime + position / context.sampleRate
+      }
+      pcm[filled++] = Math.max(-32768, Math.min(32767, Math.round((sum / (to - from)) * 32767)))
+      position += ratio
+
+      if (filled === chunkSamples) {
+        const message = new ArrayBuffer(HEADER_BYTES + pcm.byteLength)
+        new DataView(message).setFloat64(0, chunkStart, true)
+        new Int16Array(message, HEADER_BYTES).set(pcm)
+        onChunk(message)
+        pcm = new Int16Array(chunkSamples)
+        filled = 0
+      }
+    }
+    position -= samples.length
+  }
+
+  source.connect(node)
+  return () => {
+    node.port.onmessage = null
+    source.disconnect(node)
+  }
+}
@@ -1,6 +1,9 @@
+import { useEffect, useRef } from "react"
+import type { MultibandVolume } from "@/common/hooks"
+
 export interface AudioVisualizerProps {
   type: "agent" | "user"
-  frequencies: Float32Array[]
+  volume: MultibandVolume
   gap: number
   barWidth: number
   minBarHeight: number
@@ -10,7 +13,7 @@ export interface AudioVisualizerProps {
 
 export default function AudioVisualizer(props: AudioVisualizerProps) {
   const {
-    frequencies,
+    volume,
     gap,
     barWidth,
     minBarHeight,
@@ -19,23 +22,31 @@ export default function AudioVisualizer(props: AudioVisualizerProps) {
     type,
   } = props
 
-  const summedFrequencies = frequencies.map((bandFrequencies) => {
-    const sum = bandFrequencies.reduce((a, b) => a + b, 0)
-    if (sum <= 0) {
-      return 0
-    }
-    return Math.sqrt(sum / bandFrequencies.length)
-  })
+  const barsRef = useRef<(HTMLSpanElement | null)[]>([])
+
+  // Band levels change every animation frame; write bar heights directly
+  // so React only renders when the bar count or styling props change.
+  useEffect(() => {
+    return volume.subscribe((bands) => {
+      const bars = barsRef.current
+      for (let i = 0; i < bands.length; i++) {
+        const bar = bars[i]
+        if (bar) {
+          bar.style.height =
+            minBarHeight + bands[i] * (maxBarHeight - minBarHeight) + "px"
+        }
+      }
+    })
+  }, [volume, minBarHeight, maxBarHeight])
 
   return (
     <div
       className={`flex items-center justify-center`}
       style={{ gap: `${gap}px` }}
     >
-      {summedFrequencies.map((frequency, index) => {
+      {Array.from(volume.bands, (_, index) => {
         const style = {
-          height:
-            minBarHeight + frequency * (maxBarHeight - minBarHeight) + "px",
+          height: minBarHeight + "px",
           borderRadius: borderRadius + "px",
           width: barWidth + "px",
           transition:
@@ -45,7 +56,15 @@ export default function AudioVisualizer(props: AudioVisualizerProps) {
           boxShadow: type === "agent" ? "0 0 10px #EAECF0" : "none",
         }
 
-        return <span key={index} style={style} />
+        return (
+          <span
+            key={index}
+            ref={(el) => {
+              barsRef.current[index] = el
+            }}
+            style={style}
+          />
+        )
       })}
     </div>
   )
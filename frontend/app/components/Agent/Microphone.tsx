@@ -62,7 +62,7 @@ export default function MicrophoneBlock(props: {
           barWidth={4}
           minBarHeight={2}
           maxBarHeight={50}
-          frequencies={subscribedVolumes}
+          volume={subscribedVolumes}
           borderRadius={2}
           gap={4}
         />
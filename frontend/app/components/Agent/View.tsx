@@ -26,7 +26,7 @@ export default function AgentView(props: AgentViewProps) {
       <div className="mt-8 h-14 w-full">
         <AudioVisualizer
           type="agent"
-          frequencies={subscribedVolumes}
+          volume={subscribedVolumes}
           barWidth={6}
           minBarHeight={6}
           maxBarHeight={56}
@@ -0,0 +1,150 @@
+"use client"
+
+import { useEffect, useRef, useState } from "react"
+import { muxClient } from "../../manager/mux"
+import { EEGRenderer, EEGRendererOptions, TRACE_FRACTION } from "./renderer"
+
+// Block layout from data_processing_py/live_emotion.py pack_eeg_block
+const BLOCK_VERSION = 1
+const BLOCK_HEADER_BYTES = 16
+const CHANNEL_NAMES = ["AF3", "T7", "Pz", "T8", "AF4"]
+
+export interface EEGViewerProps extends Partial<EEGRendererOptions> {
+  height?: number
+}
+
+/**
+ * Live raw EEG traces and spectrogram, rendered with WebGL2.
+ *
+ * Needs the emotion server started with --raw-eeg; blocks arrive on the
+ * mux eeg channel once enabled.
+ */
+export default function EEGViewer({ height = 280, ...options }: EEGViewerProps) {
+  const canvasRef = useRef<HTMLCanvasElement | null>(null)
+  const rendererRef = useRef<EEGRenderer | null>(null)
+  const [error, setError] = useState<string | null>(null)
+  const [channels, setChannels] = useState(CHANNEL_NAMES.length)
+
+  const seconds = options.seconds ?? 10
+  const scaleUv = options.scaleUv ?? 100
+  const spectrogramChannel = options.spectrogramChannel ?? -1
+  const maxFrequency = options.maxFrequency ?? 45
+  const dbMin = options.dbRange?.[0] ?? -10
+  const dbMax = options.dbRange?.[1] ?? 30
+
+  useEffect(() => {
+    const canvas = canvasRef.current
+    if (!canvas) {
+      return
+    }
+    let renderer: EEGRenderer
+    try {
+      renderer = new EEGRenderer(canvas, {
+        seconds,
+        scaleUv,
+        spectrogramChannel,
+        maxFrequency,
+        dbRange: [dbMin, dbMax],
+      })
+    } catch (e) {
+      setError((e as Error).message)
+      return
+    }
+    rendererRef.current = renderer
+
+    // Match the backing store to the displayed size so traces stay one device pixel wide
+    const resize = () => {
+      const ratio = window.devicePixelRatio || 1
+      canvas.width = Math.round(canvas.clientWidth * ratio)
+      canvas.height = Math.round(canvas.clientHeight * ratio)
+    }
+    resize()
+    const observer = new ResizeObserver(resize)
+    observer.observe(canvas)
+
+    let frame = requestAnimationFrame(function loop(now) {
+      renderer.draw(now)
+      frame = requestAnimationFrame(loop)
+    })
+
+    let shownChannels = 0
+    const handleBlock = (buffer: ArrayBuffer) => {
+      if (buffer.byteLength < BLOCK_HEADER_BYTES) {
+        return
+      }
+      const view = new DataView(buffer)
+      if (view.getUint8(0) !== BLOCK_VERSION) {
+        return
+      }
+      const count = view.getUint8(1)
+      const frames = view.getUint16(2, true)
+      const sampleRate = view.getFloat32(12, true)
+      if (buffer.byteLength < BLOCK_HEADER_BYTES + frames * count * 4) {
+        return
+      }
+      if (count !== shownChannels) {
+        shownChannels = count
+        setChannels(count)
+      }
+      renderer.push(new Float32Array(buffer, BLOCK_HEADER_BYTES, frames * count), count, sampleRate)
+    }
+
+    // A new mux session (or first connect) starts with EEG off; the gateway
+    // replays the request itself when only the emotion server restarts
+    const enable = (connected: boolean) => {
+      if (connected) {
+        renderer.reset()
+        muxClient.sendJSON("emotion", { type: "eeg", enabled: true })
+      }
+    }
+
+    muxClient.on("eeg", handleBlock)
+    muxClient.on("status", enable)
+    muxClient.acquire()
+    enable(muxClient.connected)
+
+    return () => {
+      muxClient.sendJSON("emotion", { type: "eeg", enabled: false })
+      muxClient.off("eeg", handleBlock)
+      muxClient.off("status", enable)
+      muxClient.release()
+      cancelAnimationFrame(frame)
+      observer.disconnect()
+      renderer.dispose()
+      rendererRef.current = null
+    }
+  }, [])
+
+  // Display options apply on the next frame without rebuilding GPU state
+  useEffect(() => {
+    const renderer = rendererRef.current
+    if (renderer) {
+      renderer.options = { seconds, scaleUv, spectrogramChannel, maxFrequency, dbRange: [dbMin, dbMax] }
+    }
+  }, [seconds, scaleUv, spectrogramChannel, maxFrequency, dbMin, dbMax])
+
+  if (error) {
+    return <p className="text-center text-xs text-indigo-200">EEG viewer unavailable: {error}</p>
+  }
+
+  return (
+    <div className="relative w-full overflow-hidden rounded-xl" style={{ height }}>
+      <canvas ref={canvasRef} className="block h-full w-full" />
+      {/* Static labels; the canvas redraws every frame, the DOM does not */}
+      <div className="pointer-events-none absolute inset-x-0 top-0" style={{ height: `${TRACE_FRACTION * 100}%` }}>
+        {CHANNEL_NAMES.slice(0, channels).map((name, index) => (
+          <span
+            key={name}
+            className="absolute left-1 text-[10px] text-white/60"
+            style={{ top: `${((index + 0.5) / channels) * 100}%`, transform: "translateY(-50%)" }}
+          >
+            {name}
+          </span>
+        ))}
+      </div>
+      <span className="pointer-events-none absolute bottom-1 left-1 text-[10px] text-white/60">
+        0–{maxFrequency} Hz
+      </span>
+    </div>
+  )
+}
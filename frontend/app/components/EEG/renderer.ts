@@ -0,0 +1,484 @@
+"use client"
+
+// WebGL2 renderer for raw EEG: per-channel traces and a spectrogram.
+//
+// Samples live on the GPU in a ring texture (one row per channel) written
+// with texSubImage2D as blocks arrive; spectrogram columns are computed on
+// the CPU per hop and written one column at a time into a second ring
+// texture. Scrolling only moves the head uniforms, so a frame costs two
+// draw calls regardless of how much history is shown.
+
+// Samples kept per channel (64 s at 128 Hz)
+const CAPACITY = 8192
+const MAX_CHANNELS = 8
+// Samples a vertex shader scans for one pixel column's min/max
+const MAX_PER_COLUMN = 64
+const FFT_SIZE = 128
+// Samples between spectrogram columns (16 columns/s at 128 Hz)
+const HOP = 8
+// Bins 1..FFT_SIZE/2 (1 Hz each at 128 Hz)
+const BINS = FFT_SIZE / 2
+const SPEC_CAPACITY = CAPACITY / HOP
+// Display lags the newest sample by this much so block arrival jitter doesn't stall the scroll
+const PLAYOUT_DELAY_S = 0.25
+// Share of the canvas height used by traces; the spectrogram fills the rest
+export const TRACE_FRACTION = 0.62
+
+const CHANNEL_COLORS = new Float32Array([
+  0.55, 0.75, 1.0,
+  0.6, 0.95, 0.7,
+  1.0, 0.85, 0.45,
+  1.0, 0.6, 0.55,
+  0.85, 0.65, 1.0,
+  0.5, 0.95, 0.95,
+  1.0, 0.7, 0.9,
+  0.85, 0.85, 0.85,
+])
+
+const TRACE_VERTEX = `#version 300 es
+precision highp float;
+precision highp int;
+uniform highp sampler2D u_samples;
+uniform int u_capacity;
+uniform int u_head;
+uniform float u_frac;
+uniform int u_filled;
+uniform float u_window;
+uniform int u_columns;
+uniform int u_channels;
+uniform float u_offsets[${MAX_CHANNELS}];
+uniform vec3 u_colors[${MAX_CHANNELS}];
+uniform float u_scale;
+flat out vec3 v_color;
+
+void main() {
+  int channel = gl_InstanceID;
+  int column = gl_VertexID / 2;
+  float perColumn = u_window / float(u_columns);
+  // Sample range behind this pixel column, ending at the (fractional) display head
+  float start = float(u_head) + u_frac - u_window + float(column) * perColumn;
+  int first = int(floor(start));
+  int count = clamp(int(ceil(start + perColumn)) - first, 1, ${MAX_PER_COLUMN});
+  int oldest = u_head - u_filled;
+  float lo = 1e30;
+  float hi = -1e30;
+  for (int i = 0; i < count; i++) {
+    int s = first + i;
+    if (s < oldest || s >= u_head) {
+      continue;
+    }
+    float v = texelFetch(u_samples, ivec2(s % u_capacity, channel), 0).r;
+    lo = min(lo, v);
+    hi = max(hi, v);
+  }
+  float offset = u_offsets[channel];
+  // Alternate min and max so the line strip draws each column's envelope
+  float value = lo > hi ? offset : ((gl_VertexID & 1) == 1 ? hi : lo);
+  float band = 2.0 / float(u_channels);
+  float centre = 1.0 - band * (float(channel) + 0.5);
+  float y = centre + clamp((value - offset) / u_scale, -1.0, 1.0) * band * 0.45;
+  float x = (float(column) + 0.5) / float(u_columns) * 2.0 - 1.0;
+  gl_Position = vec4(x, y, 0.0, 1.0);
+  v_color = u_colors[channel];
+}
+`
+
+const TRACE_FRAGMENT = `#version 300 es
+precision mediump float;
+flat in vec3 v_color;
+out vec4 color;
+void main() {
+  color = vec4(v_color, 1.0);
+}
+`
+
+const SPEC_VERTEX = `#version 300 es
+out vec2 v_uv;
+void main() {
+  // Full-viewport triangle
+  vec2 p = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;
+  v_uv = p * 0.5 + 0.5;
+  gl_Position = vec4(p, 0.0, 1.0);
+}
+`
+
+const SPEC_FRAGMENT = `#version 300 es
+precision highp float;
+precision highp int;
+uniform sampler2D u_spec;
+uniform float u_head;
+uniform float u_visible;
+uniform float u_oldest;
+uniform float u_newest;
+uniform int u_capacity;
+uniform float u_maxBin;
+in vec2 v_uv;
+out vec4 color;
+
+// Inferno, polynomial fit
+vec3 colormap(float t) {
+  const vec3 c0 = vec3(0.0002, 0.0016, -0.0195);
+  const vec3 c1 = vec3(0.1065, 0.5640, 3.9327);
+  const vec3 c2 = vec3(11.6025, -3.9729, -15.9424);
+  const vec3 c3 = vec3(-41.7040, 17.4364, 44.3541);
+  const vec3 c4 = vec3(77.1629, -33.4023, -81.8073);
+  const vec3 c5 = vec3(-71.3194, 32.6261, 73.2095);
+  const vec3 c6 = vec3(25.1311, -12.2426, -23.0703);
+  return clamp(c0 + t * (c1 + t * (c2 + t * (c3 + t * (c4 + t * (c5 + t * c6))))), 0.0, 1.0);
+}
+
+void main() {
+  float column = floor(u_head - u_visible + v_uv.x * u_visible);
+  if (column < u_oldest || column >= u_newest) {
+    color = vec4(0.0, 0.0, 0.0, 1.0);
+    return;
+  }
+  int bin = min(int(v_uv.y * u_maxBin), ${BINS - 1});
+  float level = texelFetch(u_spec, ivec2(int(column) % u_capacity, bin), 0).r;
+  color = vec4(colormap(level), 1.0);
+}
+`
+
+export interface EEGRendererOptions {
+  // Seconds of history across the width
+  seconds: number
+  // Microvolts from a trace's centre line to the edge of its band
+  scaleUv: number
+  // Channel shown in the spectrogram; -1 averages all channels
+  spectrogramChannel: number
+  // Highest frequency shown in the spectrogram (Hz)
+  maxFrequency: number
+  // Spectrogram colour range, dB re 1 µV²
+  dbRange: [number, number]
+}
+
+function compile(gl: WebGL2RenderingContext, vertex: string, fragment: string): WebGLProgram {
+  const program = gl.createProgram()!
+  for (const [type, source] of [
+    [gl.VERTEX_SHADER, vertex],
+    [gl.FRAGMENT_SHADER, fragment],
+  ] as const) {
+    const shader = gl.createShader(type)!
+    gl.shaderSource(shader, source)
+    gl.compileShader(shader)
+    if (!gl.getShaderParameter(shader, gl.COMPILE_STATUS)) {
+      throw new Error(`EEG shader: ${gl.getShaderInfoLog(shader)}`)
+    }
+    gl.attachShader(program, shader)
+  }
+  gl.linkProgram(program)
+  if (!gl.getProgramParameter(program, gl.LINK_STATUS)) {
+    throw new Error(`EEG program: ${gl.getProgramInfoLog(program)}`)
+  }
+  return program
+}
+
+function uniforms(gl: WebGL2RenderingContext, program: WebGLProgram, names: string[]) {
+  const locations: Record<string, WebGLUniformLocation | null> = {}
+  for (const name of names) {
+    locations[name] = gl.getUniformLocation(program, name)
+  }
+  return locations
+}
+
+/** In-place radix-2 FFT of FFT_SIZE points. */
+class FFT {
+  private cos = new Float32Array(FFT_SIZE / 2)
+  private sin = new Float32Array(FFT_SIZE / 2)
+  private reversed = new Uint16Array(FFT_SIZE)
+
+  constructor() {
+    const bits = Math.log2(FFT_SIZE)
+    for (let i = 0; i < FFT_SIZE / 2; i++) {
+      this.cos[i] = Math.cos((2 * Math.PI * i) / FFT_SIZE)
+      this.sin[i] = -Math.sin((2 * Math.PI * i) / FFT_SIZE)
+    }
+    for (let i = 0; i < FFT_SIZE; i++) {
+      let r = 0
+      for (let b = 0; b < bits; b++) {
+        r |= ((i >> b) & 1) << (bits - 1 - b)
+      }
+      this.reversed[i] = r
+    }
+  }
+
+  transform(re: Float32Array, im: Float32Array) {
+    for (let i = 0; i < FFT_SIZE; i++) {
+      const j = this.reversed[i]
+      if (j > i) {
+        const r = re[i]
+        re[i] = re[j]
+        re[j] = r
+        const m = im[i]
+        im[i] = im[j]
+        im[j] = m
+      }
+    }
+    for (let size = 2; size <= FFT_SIZE; size *= 2) {
+      const half = size / 2
+      const step = FFT_SIZE / size
+      for (let start = 0; start < FFT_SIZE; start += size) {
+        for (let k = 0; k < half; k++) {
+          const a = start + k
+          const b = a + half
+          const wr = this.cos[k * step]
+          const wi = this.sin[k * step]
+          const tr = re[b] * wr - im[b] * wi
+          const ti = re[b] * wi + im[b] * wr
+          re[b] = re[a] - tr
+          im[b] = im[a] - ti
+          re[a] += tr
+          im[a] += ti
+        }
+      }
+    }
+  }
+}
+
+export class EEGRenderer {
+  options: EEGRendererOptions
+  private gl: WebGL2RenderingContext
+  private traceProgram: WebGLProgram
+  private specProgram: WebGLProgram
+  private traceUniforms: Record<string, WebGLUniformLocation | null>
+  private specUniforms: Record<string, WebGLUniformLocation | null>
+  private samples: WebGLTexture
+  private spectrum: WebGLTexture
+  private vao: WebGLVertexArrayObject
+
+  private channels = 0
+  private sampleRate = 128
+  // Samples received per channel
+  private received = 0
+  // Fractional display position in samples, advanced by wall time between blocks
+  private display = 0
+  private lastFrame = 0
+  private offsets = new Float32Array(MAX_CHANNELS)
+  private offsetsPrimed = false
+  // CPU copy of the spectrogram input (mixed or selected channel)
+  private history = new Float32Array(CAPACITY)
+  private columns = 0
+  private fft = new FFT()
+  private window = new Float32Array(FFT_SIZE)
+  private windowPower = 0
+  private re = new Float32Array(FFT_SIZE)
+  private im = new Float32Array(FFT_SIZE)
+  private column = new Uint8Array(BINS)
+  private upload = new Float32Array(CAPACITY)
+
+  constructor(canvas: HTMLCanvasElement, options: EEGRendererOptions) {
+    const gl = canvas.getContext("webgl2", { antialias: false, alpha: false, desynchronized: true })
+    if (!gl) {
+      throw new Error("WebGL2 is not available")
+    }
+    this.gl = gl
+    this.options = options
+
+    this.traceProgram = compile(gl, TRACE_VERTEX, TRACE_FRAGMENT)
+    this.specProgram = compile(gl, SPEC_VERTEX, SPEC_FRAGMENT)
+    this.traceUniforms = uniforms(gl, this.traceProgram, [
+      "u_samples", "u_capacity", "u_head", "u_frac", "u_filled", "u_window",
+      "u_columns", "u_channels", "u_offsets", "u_colors", "u_scale",
+    ])
+    this.specUniforms = uniforms(gl, this.specProgram, [
+      "u_spec", "u_head", "u_visible", "u_oldest", "u_newest", "u_capacity", "u_maxBin",
+    ])
+    // Both programs build vertices from gl_VertexID; WebGL still wants a bound VAO
+    this.vao = gl.createVertexArray()!
+
+    gl.pixelStorei(gl.UNPACK_ALIGNMENT, 1)
+    this.samples = this.createTexture(gl.R32F, CAPACITY, MAX_CHANNELS, gl.RED, gl.FLOAT)
+    this.spectrum = this.createTexture(gl.R8, SPEC_CAPACITY, BINS, gl.RED, gl.UNSIGNED_BYTE)
+
+    for (let i = 0; i < FFT_SIZE; i++) {
+      this.window[i] = 0.5 - 0.5 * Math.cos((2 * Math.PI * i) / (FFT_SIZE - 1))
+      this.windowPower += this.window[i] * this.window[i]
+    }
+  }
+
+  private createTexture(internal: number, width: number, height: number, format: number, type: number) {
+    const gl = this.gl
+    const texture = gl.createTexture()!
+    gl.bindTexture(gl.TEXTURE_2D, texture)
+    gl.texStorage2D(gl.TEXTURE_2D, 1, internal, width, height)
+    gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.NEAREST)
+    gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MAG_FILTER, gl.NEAREST)
+    gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE)
+    gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.CLAMP_TO_EDGE)
+    return texture
+  }
+
+  /**
+   * Append samples, frame by frame (frames x channels, microvolts).
+   */
+  push(values: Float32Array, stride: number, sampleRate: number) {
+    const gl = this.gl
+    const channels = Math.min(stride, MAX_CHANNELS)
+    const frames = stride ? Math.floor(values.length / stride) : 0
+    if (!frames) {
+      return
+    }
+    if (channels !== this.channels || sampleRate !== this.sampleRate) {
+      this.channels = channels
+      this.sampleRate = sampleRate
+      this.offsetsPrimed = false
+    }
+
+    // Slow running mean per channel centres each trace on its DC level
+    const alpha = 1 - Math.exp(-frames / (sampleRate * 2))
+    for (let c = 0; c < channels; c++) {
+      let sum = 0
+      for (let f = 0; f < frames; f++) {
+        sum += values[f * stride + c]
+      }
+      const mean = sum / frames
+      this.offsets[c] = this.offsetsPrimed ? this.offsets[c] + alpha * (mean - this.offsets[c]) : mean
+    }
+    this.offsetsPrimed = true
+
+    // One texSubImage2D per channel row, two where the block wraps the ring
+    gl.bindTexture(gl.TEXTURE_2D, this.samples)
+    const start = this.received % CAPACITY
+    const first = Math.min(frames, CAPACITY - start)
+    for (let c = 0; c < channels; c++) {
+      for (let f = 0; f < frames; f++) {
+        this.upload[f] = values[f * stride + c]
+      }
+      gl.texSubImage2D(gl.TEXTURE_2D, 0, start, c, first, 1, gl.RED, gl.FLOAT, this.upload, 0)
+      if (first < frames) {
+        gl.texSubImage2D(gl.TEXTURE_2D, 0, 0, c, frames - first, 1, gl.RED, gl.FLOAT, this.upload, first)
+      }
+    }
+
+    const selected = this.options.spectrogramChannel
+    for (let f = 0; f < frames; f++) {
+      let value = 0
+      if (selected >= 0 && selected < channels) {
+        value = values[f * stride + selected]
+      } else {
+        for (let c = 0; c < channels; c++) {
+          value += values[f * stride + c]
+        }
+        value /= channels
+      }
+      this.history[(this.received + f) % CAPACITY] = value
+    }
+    this.received += frames
+    this.updateSpectrogram()
+  }
+
+  private updateSpectrogram() {
+    const gl = this.gl
+    const [dbMin, dbMax] = this.options.dbRange
+    gl.bindTexture(gl.TEXTURE_2D, this.spectrum)
+    // Column j covers the FFT_SIZE samples ending at sample j * HOP
+    while ((this.columns + 1) * HOP <= this.received) {
+      const end = (this.columns + 1) * HOP
+      if (end >= FFT_SIZE) {
+        let mean = 0
+        for (let i = 0; i < FFT_SIZE; i++) {
+          mean += this.history[(end - FFT_SIZE + i) % CAPACITY]
+        }
+        mean /= FFT_SIZE
+        for (let i = 0; i < FFT_SIZE; i++) {
+          this.re[i] = (this.history[(end - FFT_SIZE + i) % CAPACITY] - mean) * this.window[i]
+          this.im[i] = 0
+        }
+        this.fft.transform(this.re, this.im)
+        for (let bin = 0; bin < BINS; bin++) {
+          const power = (this.re[bin + 1] ** 2 + this.im[bin + 1] ** 2) / this.windowPower
+          const db = 10 * Math.log10(power + 1e-12)
+          this.column[bin] = Math.max(0, Math.min(255, Math.round(((db - dbMin) / (dbMax - dbMin)) * 255)))
+        }
+      } else {
+        this.column.fill(0)
+      }
+      gl.texSubImage2D(gl.TEXTURE_2D, 0, this.columns % SPEC_CAPACITY, 0, 1, BINS, gl.RED, gl.UNSIGNED_BYTE, this.column)
+      this.columns += 1
+    }
+  }
+
+  /** Forget all samples (e.g. after a reconnect). */
+  reset() {
+    this.received = 0
+    this.display = 0
+    this.columns = 0
+    this.offsetsPrimed = false
+  }
+
+  /** Draw one frame; call from requestAnimationFrame. */
+  draw(now: number) {
+    const gl = this.gl
+    const canvas = gl.canvas as HTMLCanvasElement
+    const elapsed = this.lastFrame ? Math.min(0.1, (now - this.lastFrame) / 1000) : 0
+    this.lastFrame = now
+
+    // Advance at the sample rate, never past the newest sample, and catch up
+    // rather than drift when blocks arrive late or in bursts
+    const target = this.received - PLAYOUT_DELAY_S * this.sampleRate
+    this.display = Math.min(this.received, this.display + elapsed * this.sampleRate)
+    if (Math.abs(this.display - target) > this.sampleRate) {
+      this.display = target
+    } else {
+      this.display += (target - this.display) * Math.min(1, elapsed)
+    }
+    this.display = Math.max(0, this.display)
+
+    const width = canvas.width
+    const height = canvas.height
+    const traceHeight = Math.round(height * TRACE_FRACTION)
+    const windowSamples = this.options.seconds * this.sampleRate
+    const columns = Math.max(1, Math.min(width, 4096))
+
+    gl.viewport(0, 0, width, height)
+    gl.clearColor(0.04, 0.04, 0.08, 1)
+    gl.clear(gl.COLOR_BUFFER_BIT)
+    gl.bindVertexArray(this.vao)
+    gl.activeTexture(gl.TEXTURE0)
+
+    if (this.channels) {
+      const head = Math.floor(this.display)
+      const u = this.traceUniforms
+      gl.useProgram(this.traceProgram)
+      gl.viewport(0, height - traceHeight, width, traceHeight)
+      gl.bindTexture(gl.TEXTURE_2D, this.samples)
+      gl.uniform1i(u.u_samples, 0)
+      gl.uniform1i(u.u_capacity, CAPACITY)
+      gl.uniform1i(u.u_head, head)
+      gl.uniform1f(u.u_frac, this.display - head)
+      // Samples older than received - CAPACITY have been overwritten
+      gl.uniform1i(u.u_filled, Math.max(0, head - Math.max(0, this.received - CAPACITY)))
+      gl.uniform1f(u.u_window, Math.min(windowSamples, CAPACITY / 2))
+      gl.uniform1i(u.u_columns, columns)
+      gl.uniform1i(u.u_channels, this.channels)
+      gl.uniform1fv(u.u_offsets, this.offsets)
+      gl.uniform3fv(u.u_colors, CHANNEL_COLORS)
+      gl.uniform1f(u.u_scale, this.options.scaleUv)
+      gl.drawArraysInstanced(gl.LINE_STRIP, 0, columns * 2, this.channels)
+    }
+
+    const s = this.specUniforms
+    const specHead = this.display / HOP
+    gl.useProgram(this.specProgram)
+    gl.viewport(0, 0, width, height - traceHeight)
+    gl.bindTexture(gl.TEXTURE_2D, this.spectrum)
+    gl.uniform1i(s.u_spec, 0)
+    gl.uniform1f(s.u_head, specHead)
+    gl.uniform1f(s.u_visible, Math.min(windowSamples, CAPACITY / 2) / HOP)
+    // Earlier columns had less than a full FFT window of input
+    gl.uniform1f(s.u_oldest, Math.max(FFT_SIZE / HOP - 1, this.columns - SPEC_CAPACITY))
+    gl.uniform1f(s.u_newest, this.columns)
+    gl.uniform1i(s.u_capacity, SPEC_CAPACITY)
+    gl.uniform1f(s.u_maxBin, Math.min(BINS, (this.options.maxFrequency * FFT_SIZE) / this.sampleRate))
+    gl.drawArrays(gl.TRIANGLES, 0, 3)
+  }
+
+  dispose() {
+    const gl = this.gl
+    gl.deleteTexture(this.samples)
+    gl.deleteTexture(this.spectrum)
+    gl.deleteProgram(this.traceProgram)
+    gl.deleteProgram(this.specProgram)
+    gl.deleteVertexArray(this.vao)
+  }
+}
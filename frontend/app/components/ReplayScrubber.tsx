@@ -0,0 +1,153 @@
+'use client'
+
+import { useState, useEffect, useRef, useCallback } from 'react'
+
+interface ReplayState {
+  position: number
+  duration: number
+  paused: boolean
+  speed: number
+  ended: boolean
+}
+
+interface ReplayEvent {
+  emotion: string
+  confidence: number
+  replay_offset: number
+}
+
+const SPEEDS = [0.5, 1, 2, 4, 8, 16]
+
+function formatOffset(seconds: number) {
+  const m = Math.floor(seconds / 60)
+  const s = Math.floor(seconds % 60)
+  return `${m}:${s.toString().padStart(2, '0')}`
+}
+
+export default function ReplayScrubber({ url = 'ws://localhost:8766' }: { url?: string }) {
+  const [state, setState] = useState<ReplayState | null>(null)
+  const [position, setPosition] = useState(0)
+  const [current, setCurrent] = useState<ReplayEvent | null>(null)
+  const [isConnected, setIsConnected] = useState(false)
+
+  const wsRef = useRef<WebSocket | null>(null)
+  // Server state plus the local time it arrived, to advance the cursor between messages
+  const clockRef = useRef({ position: 0, at: 0, speed: 1, paused: true, duration: 0 })
+  const draggingRef = useRef(false)
+  const pendingSeekRef = useRef<number | null>(null)
+  const seekFrameRef = useRef<number | null>(null)
+
+  const send = useCallback((message: object) => {
+    if (wsRef.current?.readyState === WebSocket.OPEN) {
+      wsRef.current.send(JSON.stringify(message))
+    }
+  }, [])
+
+  useEffect(() => {
+    const ws = new WebSocket(url)
+    wsRef.current = ws
+
+    ws.onopen = () => setIsConnected(true)
+    ws.onclose = () => setIsConnected(false)
+
+    ws.onmessage = (event) => {
+      const data = JSON.parse(event.data)
+      if (data.type === 'replay_state') {
+        clockRef.current = { ...data, at: performance.now() }
+        setState(data)
+      } else if (data.emotion) {
+        setCurrent(data)
+        // Resync the cursor to the stream while playing
+        if (!draggingRef.current && !clockRef.current.paused) {
+          clockRef.current = { ...clockRef.current, position: data.replay_offset, at: performance.now() }
+        }
+      }
+    }
+
+    return () => ws.close()
+  }, [url])
+
+  // Advance the cursor locally so it moves smoothly without a message per frame
+  useEffect(() => {
+    let frame: number
+    const tick = () => {
+      const clock = clockRef.current
+      if (!draggingRef.current) {
+        const elapsed = clock.paused ? 0 : ((performance.now() - clock.at) / 1000) * clock.speed
+        setPosition(Math.min(clock.duration, clock.position + elapsed))
+      }
+      frame = requestAnimationFrame(tick)
+    }
+    frame = requestAnimationFrame(tick)
+    return () => cancelAnimationFrame(frame)
+  }, [])
+
+  // Coalesce drag input to at most one seek per animation frame
+  const scrubTo = (offset: number) => {
+    setPosition(offset)
+    pendingSeekRef.current = offset
+    if (seekFrameRef.current === null) {
+      seekFrameRef.current = requestAnimationFrame(() => {
+        seekFrameRef.current = null
+        if (pendingSeekRef.current !== null) {
+          send({ action: 'seek', offset: pendingSeekRef.current })
+          pendingSeekRef.current = null
+        }
+      })
+    }
+  }
+
+  const togglePlayback = () => {
+    send({ action: state?.paused ? 'resume' : 'pause' })
+  }
+
+  if (!isConnected || !state) {
+    return (
+      <div className="glass-effect rounded-lg p-4 text-sm text-gray-400">
+        Replay server not connected ({url})
+      </div>
+    )
+  }
+
+  return (
+    <div className="glass-effect rounded-lg p-4 w-full max-w-2xl space-y-3">
+      <div className="flex items-center justify-between text-white">
+        <span className="text-lg capitalize">{current?.emotion ?? '—'}</span>
+        <span className="text-sm text-gray-300">
+          {current ? `${Math.round(current.confidence * 100)}% confidence` : ''}
+        </span>
+      </div>
+
+      <input
+        type="range"
+        className="w-full"
+        min={0}
+        max={state.duration}
+        step={0.1}
+        value={position}
+        onPointerDown={() => { draggingRef.current = true }}
+        onPointerUp={() => { draggingRef.current = false }}
+        onChange={(e) => scrubTo(parseFloat(e.target.value))}
+      />
+
+      <div className="flex items-center justify-between text-sm text-gray-300">
+        <button
+          className="px-3 py-1 rounded bg-white/10 hover:bg-white/20 text-white"
+          onClick={togglePlayback}
+        >
+          {state.paused ? 'Play' : 'Pause'}
+        </button>
+        <span>{formatOffset(position)} / {formatOffset(state.duration)}</span>
+        <select
+          className="bg-transparent text-white"
+          value={state.speed}
+          onChange={(e) => send({ action: 'speed', speed: parseFloat(e.target.value) })}
+        >
+          {SPEEDS.map((speed) => (
+            <option key={speed} value={speed} className="text-black">{speed}x</option>
+          ))}
+        </select>
+      </div>
+    </div>
+  )
+}
@@ -1,14 +1,17 @@
 "use client";
 
-import React, { useEffect, useState, useRef } from "react";
+import React, { useEffect, useState } from "react";
 import { motion } from "framer-motion";
 import { Provider } from "react-redux";
 import { store } from "../store";
 import { useAppDispatch, useAppSelector } from "../common/hooks";
 import { rtcManager } from "../manager";
+import { muxClient } from "../manager/mux";
+import { clockSync } from "../common/clock";
 import { AudioVisualizer } from "./Agent/AudioVisualizer";
 import { Camera } from "./Agent/Camera";
 import { Microphone } from "./Agent/Microphone";
+import EEGViewer from "./EEG/EEGViewer";
 import { setRtcConnected, setEmotionData } from "../store/reducers/global";
 
 interface EmotionData {
@@ -19,6 +22,8 @@ interface EmotionData {
   relaxation: number;
   emotional_state: string;
   timestamp: string;
+  // Headset sample time on the backend clock (see common/clock.ts)
+  synced_timestamp?: number;
 }
 
 const TenVoiceChatInner: React.FC = () => {
@@ -26,7 +31,8 @@ const TenVoiceChatInner: React.FC = () => {
   const { rtcConnected, emotionData } = useAppSelector((state) => state.global);
   const [isListening, setIsListening] = useState(false);
   const [isConnecting, setIsConnecting] = useState(false);
-  const websocketRef = useRef<WebSocket | null>(null);
+  const [eegLatency, setEegLatency] = useState<number | null>(null);
+  const [showEeg, setShowEeg] = useState(false);
 
   // Initialize RTC connection
   useEffect(() => {
@@ -54,48 +60,26 @@ const TenVoiceChatInner: React.FC = () => {
     };
   }, [dispatch]);
 
-  // Connect to EEG emotion WebSocket
+  // EEG emotion events arrive on the shared multiplexed connection
   useEffect(() => {
-    const connectEmotionSocket = () => {
-      try {
-        const ws = new WebSocket("ws://localhost:8765");
-        websocketRef.current = ws;
-
-        ws.onopen = () => {
-          console.log("Connected to emotion WebSocket");
-        };
-
-        ws.onmessage = (event) => {
-          try {
-            const emotionData: EmotionData = JSON.parse(event.data);
-            dispatch(setEmotionData(emotionData));
-          } catch (error) {
-            console.error("Error parsing emotion data:", error);
-          }
-        };
-
-        ws.onclose = () => {
-          console.log("Emotion WebSocket disconnected");
-          // Reconnect after 5 seconds
-          setTimeout(connectEmotionSocket, 5000);
-        };
-
-        ws.onerror = (error) => {
-          console.error("Emotion WebSocket error:", error);
-        };
-      } catch (error) {
-        console.error("Failed to connect to emotion WebSocket:", error);
-        // Retry after 5 seconds
-        setTimeout(connectEmotionSocket, 5000);
+    const handleEmotion = (emotionData: EmotionData) => {
+      // Voice prosody events share the channel; only EEG events update the store
+      if ((emotionData as any).type === "prosody") {
+        return;
+      }
+      dispatch(setEmotionData(emotionData));
+      // Sample-arrival-to-screen latency, valid across devices once the clocks are synced
+      if (emotionData.synced_timestamp && clockSync.state().synced) {
+        setEegLatency(Math.round(clockSync.latencyMs(emotionData.synced_timestamp)));
       }
     };
 
-    connectEmotionSocket();
+    muxClient.on("emotion", handleEmotion);
+    muxClient.acquire();
 
     return () => {
-      if (websocketRef.current) {
-        websocketRef.current.close();
-      }
+      muxClient.off("emotion", handleEmotion);
+      muxClient.release();
     };
   }, [dispatch]);
 
@@ -163,6 +147,9 @@ const TenVoiceChatInner: React.FC = () => {
           </div>
         )}
 
+        {/* Raw EEG */}
+        {showEeg && <EEGViewer />}
+
         {/* Audio Visualizer */}
         <div className="flex justify-center">
           <AudioVisualizer />
@@ -190,6 +177,19 @@ const TenVoiceChatInner: React.FC = () => {
           )}
         </div>
 
+        {eegLatency !== null && (
+          <p className="text-center text-xs text-indigo-200">EEG to screen: {eegLatency} ms</p>
+        )}
+
+        <div className="text-center">
+          <button
+            onClick={() => setShowEeg(!showEeg)}
+            className="text-xs text-indigo-200 underline"
+          >
+            {showEeg ? "Hide raw EEG" : "Show raw EEG"}
+          </button>
+        </div>
+
         {/* Instructions */}
         <div className="bg-white/5 backdrop-blur-md rounded-xl p-4">
           <h3 className="text-white font-semibold mb-2">How it works:</h3>
@@ -2,6 +2,11 @@
 
 import { useState, useEffect, useRef, useCallback } from 'react'
 import VoiceBlob from './VoiceBlob'
+import { muxClient } from '../manager/mux'
+import { startPcmTap } from '../common/pcm'
+
+// MediaRecorder timeslice: microphone audio is uploaded in chunks of this length
+const AUDIO_CHUNK_MS = 250
 
 export default function VoiceChat() {
   const [isListening, setIsListening] = useState(false)
@@ -12,83 +17,57 @@ export default function VoiceChat() {
   const [aiResponse, setAiResponse] = useState('')
   const [status, setStatus] = useState('Click to start talking')
 
-  const wsRef = useRef<WebSocket | null>(null)
   const mediaRecorderRef = useRef<MediaRecorder | null>(null)
   const audioContextRef = useRef<AudioContext | null>(null)
   const analyserRef = useRef<AnalyserNode | null>(null)
-  const audioChunksRef = useRef<Blob[]>([])
+  const stopPcmTapRef = useRef<(() => void) | null>(null)
+  // Keeps microphone chunks (and the final 'end') in order while blobs are read
+  const uploadChainRef = useRef<Promise<void>>(Promise.resolve())
 
-  const connectWebSocket = useCallback(() => {
-    try {
-      wsRef.current = new WebSocket('ws://localhost:8000/ws/chat')
-      
-      wsRef.current.onopen = () => {
-        setIsConnected(true)
-        setStatus('Connected - Click to start talking')
-      }
-      
-      wsRef.current.onmessage = (event) => {
-        const data = JSON.parse(event.data)
+  const handleControl = useCallback((data: any) => {
+    switch (data.type) {
+      case 'welcome':
+        setStatus('Connected to CSM AI Therapist')
+        break
+        
+      case 'error':
+        console.error('Server error:', data.message)
+        setStatus('Error: ' + data.message)
+        break
+        
+      case 'eeg_received':
+        console.log('EEG data processed')
+        break
+    }
+  }, [])
+
+  const handleTranscript = useCallback((data: any) => {
+    switch (data.type) {
+      case 'transcription':
+        setTranscript(data.text)
+        setStatus('Processing your message...')
+        break
         
-        switch (data.type) {
-          case 'welcome':
-            setStatus('Connected to CSM AI Therapist')
-            break
-            
-          case 'transcription':
-            setTranscript(data.text)
-            setStatus('Processing your message...')
-            break
-            
-          case 'audio_response':
-            setAiResponse(data.text)
-            playAudioResponse(data.audio)
-            break
-            
-          case 'text_response':
-            setAiResponse(data.text)
-            setStatus('Response ready (audio unavailable)')
-            break
-            
-          case 'error':
-            console.error('Server error:', data.message)
-            setStatus('Error: ' + data.message)
-            break
-            
-          case 'eeg_received':
-            console.log('EEG data processed')
-            break
+      case 'response':
+        setAiResponse(data.text)
+        if (!data.audio) {
+          setStatus('Response ready (audio unavailable)')
         }
-      }
-      
-      wsRef.current.onclose = () => {
-        setIsConnected(false)
-        setStatus('Disconnected - Click to reconnect')
-      }
-      
-      wsRef.current.onerror = (error) => {
-        console.error('WebSocket error:', error)
-        setStatus('Connection error - Click to retry')
-      }
-      
-    } catch (error) {
-      console.error('Failed to connect:', error)
-      setStatus('Connection failed - Click to retry')
+        break
     }
   }, [])
 
-  const playAudioResponse = async (audioBase64: string) => {
+  const handleStatus = useCallback((connected: boolean) => {
+    setIsConnected(connected)
+    setStatus(connected ? 'Connected - Click to start talking' : 'Disconnected - Reconnecting...')
+  }, [])
+
+  const playAudioResponse = useCallback(async (audioData: ArrayBuffer) => {
     try {
       setIsSpeaking(true)
       setStatus('AI is speaking...')
       
-      const audioData = atob(audioBase64)
-      const audioArray = new Uint8Array(audioData.length)
-      for (let i = 0; i < audioData.length; i++) {
-        audioArray[i] = audioData.charCodeAt(i)
-      }
-      
-      const audioBlob = new Blob([audioArray], { type: 'audio/wav' })
+      const audioBlob = new Blob([audioData], { type: 'audio/wav' })
       const audioUrl = URL.createObjectURL(audioBlob)
       const audio = new Audio(audioUrl)
       
@@ -104,7 +83,7 @@ export default function VoiceChat() {
       setIsSpeaking(false)
       setStatus('Audio playback failed')
     }
-  }
+  }, [])
 
   const setupAudioAnalysis = async (stream: MediaStream) => {
     audioContextRef.current = new AudioContext()
@@ -113,6 +92,15 @@ export default function VoiceChat() {
     const source = audioContextRef.current.createMediaStreamSource(stream)
     source.connect(analyserRef.current)
     
+    // Raw PCM alongside the opus upload, for voice prosody on the gateway
+    try {
+      stopPcmTapRef.current = await startPcmTap(audioContextRef.current, source, (chunk) => {
+        muxClient.send('voice', chunk)
+      })
+    } catch (error) {
+      console.warn('PCM tap unavailable, voice prosody disabled:', error)
+    }
+    
     analyserRef.current.fftSize = 256
     const dataArray = new Uint8Array(analyserRef.current.frequencyBinCount)
     
@@ -144,21 +132,26 @@ export default function VoiceChat() {
         mimeType: 'audio/webm;codecs=opus'
       })
       
-      audioChunksRef.current = []
+      // Stream chunks while the user speaks instead of uploading one blob at the end
+      muxClient.sendJSON('audio_up', { type: 'start' })
       
       mediaRecorderRef.current.ondataavailable = (event) => {
         if (event.data.size > 0) {
-          audioChunksRef.current.push(event.data)
+          const chunk = event.data
+          uploadChainRef.current = uploadChainRef.current.then(async () => {
+            muxClient.send('audio_up', await chunk.arrayBuffer())
+          })
         }
       }
       
       mediaRecorderRef.current.onstop = () => {
-        const audioBlob = new Blob(audioChunksRef.current, { type: 'audio/webm' })
-        sendAudioToServer(audioBlob)
+        uploadChainRef.current = uploadChainRef.current.then(() => {
+          muxClient.sendJSON('audio_up', { type: 'end' })
+        })
         stream.getTracks().forEach(track => track.stop())
       }
       
-      mediaRecorderRef.current.start()
+      mediaRecorderRef.current.start(AUDIO_CHUNK_MS)
       setIsListening(true)
       setStatus('Listening... Click to stop')
       
@@ -175,37 +168,17 @@ export default function VoiceChat() {
       setVolume(0)
       setStatus('Processing...')
       
+      stopPcmTapRef.current?.()
+      stopPcmTapRef.current = null
       if (audioContextRef.current) {
         audioContextRef.current.close()
       }
     }
   }
 
-  const sendAudioToServer = async (audioBlob: Blob) => {
-    if (!wsRef.current || wsRef.current.readyState !== WebSocket.OPEN) {
-      setStatus('Not connected to server')
-      return
-    }
-
-    try {
-      const reader = new FileReader()
-      reader.onload = () => {
-        const base64Audio = (reader.result as string).split(',')[1]
-        wsRef.current?.send(JSON.stringify({
-          type: 'audio',
-          audio: base64Audio
-        }))
-      }
-      reader.readAsDataURL(audioBlob)
-    } catch (error) {
-      console.error('Failed to send audio:', error)
-      setStatus('Failed to send audio')
-    }
-  }
-
   const handleBlobClick = () => {
     if (!isConnected) {
-      connectWebSocket()
+      setStatus('Not connected to server - Reconnecting...')
     } else if (isListening) {
       stopRecording()
     } else if (!isSpeaking) {
@@ -214,17 +187,27 @@ export default function VoiceChat() {
   }
 
   useEffect(() => {
-    connectWebSocket()
+    muxClient.on('status', handleStatus)
+    muxClient.on('control', handleControl)
+    muxClient.on('transcript', handleTranscript)
+    muxClient.on('audioDown', playAudioResponse)
+    muxClient.acquire()
+    // 'status' only fires on changes; another component may have connected already
+    if (muxClient.connected) {
+      handleStatus(true)
+    }
     
     return () => {
-      if (wsRef.current) {
-        wsRef.current.close()
-      }
+      muxClient.off('status', handleStatus)
+      muxClient.off('control', handleControl)
+      muxClient.off('transcript', handleTranscript)
+      muxClient.off('audioDown', playAudioResponse)
+      muxClient.release()
       if (audioContextRef.current) {
         audioContextRef.current.close()
       }
     }
-  }, [connectWebSocket])
+  }, [handleStatus, handleControl, handleTranscript, playAudioResponse])
 
   return (
     <div className="flex flex-col items-center space-y-8">
@@ -1,2 +1,3 @@
 export * from "./rtc"
 export * from "./rtm"
+export * from "./mux"
@@ -0,0 +1,2 @@
+export * from "./mux"
+export * from "./types"
@@ -0,0 +1,279 @@
+"use client"
+
+import { AGEventEmitter } from "../events"
+import {
+  FLAG_FIN,
+  FLAG_TEXT,
+  MAX_FRAGMENT,
+  MUX_CHANNELS,
+  MuxChannelName,
+  MuxChannelSpec,
+  MuxEvents,
+} from "./types"
+
+const DEFAULT_URL = process.env.NEXT_PUBLIC_MUX_WS_URL || "ws://localhost:8770"
+// Stop handing frames to the socket above this much unsent data, so priorities
+// are applied here instead of in the browser's send buffer
+const HIGH_WATER = 64 * 1024
+const MAX_RETRY_DELAY = 8000
+
+interface ChannelState {
+  spec: MuxChannelSpec
+  queue: { data: Uint8Array; text: boolean }[]
+  offset: number
+  credit: number | null
+  partial: Uint8Array[]
+  consumed: number
+}
+
+/**
+ * One WebSocket per tab carrying control, audio, transcript and emotion
+ * channels with per-channel priority and credit-based flow control.
+ *
+ * Components call acquire() on mount and release() on unmount; the
+ * connection (and its single reconnect loop) lives while anyone uses it.
+ */
+export class MuxClient extends AGEventEmitter<MuxEvents> {
+  url: string
+  connected = false
+  private _ws: WebSocket | null = null
+  private _users = 0
+  private _retryDelay = 500
+  private _retryTimer: ReturnType<typeof setTimeout> | null = null
+  private _pumpTimer: ReturnType<typeof setTimeout> | null = null
+  private _channels = new Map<number, ChannelState>()
+  private _byPriority: ChannelState[] = []
+  private _encoder = new TextEncoder()
+  private _decoder = new TextDecoder("utf-8")
+
+  constructor(url: string = DEFAULT_URL) {
+    super()
+    this.url = url
+    for (const spec of Object.values(MUX_CHANNELS)) {
+      this._channels.set(spec.id, {
+        spec,
+        queue: [],
+        offset: 0,
+        credit: spec.window,
+        partial: [],
+        consumed: 0,
+      })
+    }
+    this._byPriority = Array.from(this._channels.values()).sort(
+      (a, b) => a.spec.priority - b.spec.priority,
+    )
+  }
+
+  acquire() {
+    this._users += 1
+    if (this._users === 1 && !this._ws) {
+      this._connect()
+    }
+  }
+
+  release() {
+    this._users = Math.max(0, this._users - 1)
+    if (this._users > 0) {
+      return
+    }
+    if (this._retryTimer) {
+      clearTimeout(this._retryTimer)
+      this._retryTimer = null
+    }
+    const ws = this._ws
+    this._ws = null
+    ws?.close()
+    this._setConnected(false)
+  }
+
+  /** Queue a message; never blocks. Strings are sent as text, buffers as binary. */
+  send(channel: MuxChannelName, payload: string | ArrayBuffer | Uint8Array) {
+    const state = this._channels.get(MUX_CHANNELS[channel].id)!
+    const text = typeof payload === "string"
+    const data =
+      typeof payload === "string"
+        ? this._encoder.encode(payload)
+        : payload instanceof Uint8Array
+          ? payload
+          : new Uint8Array(payload)
+    state.queue.push({ data, text })
+
+    // Latest-only channels drop the oldest messages that have not started sending
+    const limit = state.spec.maxQueued
+    if (limit !== undefined) {
+      const first = state.offset ? 1 : 0
+      while (state.queue.length - first > limit) {
+        state.queue.splice(first, 1)
+      }
+    }
+    this._pump()
+  }
+
+  sendJSON(channel: MuxChannelName, message: object) {
+    this.send(channel, JSON.stringify(message))
+  }
+
+  private _connect() {
+    const ws = new WebSocket(this.url)
+    ws.binaryType = "arraybuffer"
+    this._ws = ws
+
+    ws.onopen = () => {
+      this._retryDelay = 500
+      this._resetFlowControl()
+      this._setConnected(true)
+      this._pump()
+    }
+
+    ws.onmessage = (event) => {
+      if (event.data instanceof ArrayBuffer) {
+        this._handleFrame(new Uint8Array(event.data))
+      }
+    }
+
+    ws.onclose = () => {
+      if (this._ws !== ws) {
+        return
+      }
+      this._ws = null
+      this._setConnected(false)
+      if (this._users > 0) {
+        this._retryTimer = setTimeout(() => {
+          this._retryTimer = null
+          this._connect()
+        }, this._retryDelay)
+        this._retryDelay = Math.min(this._retryDelay * 2, MAX_RETRY_DELAY)
+      }
+    }
+
+    ws.onerror = (error) => {
+      console.error("[mux] WebSocket error:", error)
+    }
+  }
+
+  private _setConnected(connected: boolean) {
+    if (this.connected !== connected) {
+      this.connected = connected
+      this.emit("status", connected)
+    }
+  }
+
+  // A new connection starts with full windows and no half-sent or half-received messages
+  private _resetFlowControl() {
+    for (const state of this._channels.values()) {
+      state.credit = state.spec.window
+      state.offset = 0
+      state.partial = []
+      state.consumed = 0
+    }
+  }
+
+  private _nextFrame(): Uint8Array | null {
+    for (const state of this._byPriority) {
+      if (!state.queue.length || (state.credit !== null && state.credit <= 0)) {
+        continue
+      }
+      const { data, text } = state.queue[0]
+      let size = Math.min(MAX_FRAGMENT, data.length - state.offset)
+      if (state.credit !== null) {
+        size = Math.min(size, state.credit)
+        state.credit -= size
+      }
+      const frame = new Uint8Array(size + 2)
+      frame.set(data.subarray(state.offset, state.offset + size), 2)
+      state.offset += size
+      let flags = text ? FLAG_TEXT : 0
+      if (state.offset >= data.length) {
+        flags |= FLAG_FIN
+        state.queue.shift()
+        state.offset = 0
+      }
+      frame[0] = state.spec.id
+      frame[1] = flags
+      return frame
+    }
+    return null
+  }
+
+  private _pump() {
+    const ws = this._ws
+    if (!ws || ws.readyState !== WebSocket.OPEN) {
+      return
+    }
+    while (ws.bufferedAmount < HIGH_WATER) {
+      const frame = this._nextFrame()
+      if (!frame) {
+        return
+      }
+      ws.send(frame)
+    }
+    // Socket buffer is full: pick the next frame once it drains
+    if (this._pumpTimer === null) {
+      this._pumpTimer = setTimeout(() => {
+        this._pumpTimer = null
+        this._pump()
+      }, 10)
+    }
+  }
+
+  private _handleFrame(frame: Uint8Array) {
+    const state = this._channels.get(frame[0])
+    if (!state || frame.length < 2) {
+      return
+    }
+    const flags = frame[1]
+    state.partial.push(frame.subarray(2))
+
+    if (flags & FLAG_FIN) {
+      const size = state.partial.reduce((total, part) => total + part.length, 0)
+      const data = new Uint8Array(size)
+      let offset = 0
+      for (const part of state.partial) {
+        data.set(part, offset)
+        offset += part.length
+      }
+      state.partial = []
+      this._deliver(state, data, flags)
+    }
+
+    // Return credit once a quarter of the window has been received and handled
+    state.consumed += frame.length - 2
+    if (state.spec.window !== null && state.consumed >= state.spec.window / 4) {
+      this.sendJSON("control", { type: "credit", channel: state.spec.id, bytes: state.consumed })
+      state.consumed = 0
+    }
+  }
+
+  private _deliver(state: ChannelState, data: Uint8Array, flags: number) {
+    if (!(flags & FLAG_TEXT)) {
+      if (state.spec.name === "audio_down") {
+        this.emit("audioDown", data.buffer)
+      } else if (state.spec.name === "eeg") {
+        this.emit("eeg", data.buffer)
+      }
+      return
+    }
+
+    let message: any
+    try {
+      message = JSON.parse(this._decoder.decode(data))
+    } catch (error) {
+      console.error(`[mux] Invalid JSON on ${state.spec.name}:`, error)
+      return
+    }
+
+    if (state.spec.name === "control" && message.type === "credit") {
+      const target = this._channels.get(message.channel)
+      if (target && target.credit !== null) {
+        target.credit += message.bytes
+        this._pump()
+      }
+      return
+    }
+    if (state.spec.name === "control" || state.spec.name === "transcript" || state.spec.name === "emotion") {
+      this.emit(state.spec.name, message)
+    }
+  }
+}
+
+export const muxClient = new MuxClient()
@@ -0,0 +1,47 @@
+// Wire format shared with data_processing_py/mux_gateway.py:
+// [channel id: u8][flags: u8][payload fragment], one binary WebSocket message per frame
+
+export const FLAG_FIN = 0x01
+export const FLAG_TEXT = 0x02
+export const MAX_FRAGMENT = 16 * 1024
+
+export type MuxChannelName =
+  | "control"
+  | "audio_up"
+  | "audio_down"
+  | "transcript"
+  | "emotion"
+  | "voice"
+  | "eeg"
+
+export interface MuxChannelSpec {
+  id: number
+  name: MuxChannelName
+  // Lower is sent first
+  priority: number
+  // Initial credit in bytes (null = not flow controlled)
+  window: number | null
+  // Keep at most this many queued messages, dropping the oldest
+  maxQueued?: number
+}
+
+export const MUX_CHANNELS: Record<MuxChannelName, MuxChannelSpec> = {
+  control: { id: 0, name: "control", priority: 0, window: null },
+  audio_up: { id: 1, name: "audio_up", priority: 1, window: 512 * 1024 },
+  audio_down: { id: 2, name: "audio_down", priority: 1, window: 512 * 1024 },
+  transcript: { id: 3, name: "transcript", priority: 2, window: 64 * 1024 },
+  emotion: { id: 4, name: "emotion", priority: 3, window: 32 * 1024, maxQueued: 8 },
+  // 16 kHz PCM for prosody analysis, upload only
+  voice: { id: 5, name: "voice", priority: 1, window: 256 * 1024 },
+  // Raw EEG blocks for the viewer, download only; enable with {"type": "eeg"} on emotion
+  eeg: { id: 6, name: "eeg", priority: 4, window: 64 * 1024, maxQueued: 64 },
+}
+
+export interface MuxEvents {
+  status: (connected: boolean) => void
+  control: (message: any) => void
+  transcript: (message: any) => void
+  emotion: (message: any) => void
+  audioDown: (audio: ArrayBuffer) => void
+  eeg: (block: ArrayBuffer) => void
+}
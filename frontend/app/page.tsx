@@ -3,6 +3,10 @@
 import { useState, useEffect, useRef } from 'react'
 import VoiceBlob from './components/VoiceBlob'
 import VoiceChat from './components/VoiceChat'
+import ReplayScrubber from './components/ReplayScrubber'
+
+// Set to a replay server (python replay_demo.py --mode server) to review a recorded session
+const REPLAY_WS_URL = process.env.NEXT_PUBLIC_REPLAY_WS_URL
 
 export default function Home() {
   return (
@@ -14,6 +18,12 @@ export default function Home() {
         </div>
         
         <VoiceChat />
+        
+        {REPLAY_WS_URL && (
+          <div className="mt-8 flex justify-center">
+            <ReplayScrubber url={REPLAY_WS_URL} />
+          </div>
+        )}
       </div>
     </main>
   )